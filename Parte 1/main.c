@@ -44,11 +44,26 @@ BREVE DESCRICAO:
 
 */
 
+#define _GNU_SOURCE // pthread_setaffinity_np e CPU_SET, no pool de threads
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <stdint.h>
+#include <limits.h>
+#include <ctype.h>
 #include <pthread.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define USA_SIMD 1
+#include <immintrin.h>
+#endif
 
 #define A 0 // representa uma base Adenina
 #define T 1 // representa uma base Timina
@@ -56,9 +71,9 @@ BREVE DESCRICAO:
 #define C 3 // representa uma base Citosina
 #define X 4 // representa um gap
 
-#define sair 11
+#define sair 12
 
-#define maxSeq 1000 // tamanho maximo de bases em uma sequencia genomica
+#define maxSeq 10000000 // tamanho maximo de bases em uma sequencia genomica
 #define MAXTHREADS 20
 
 /* mapaBases mapeia indices em caracteres que representam as bases, sendo 0='A',
@@ -68,18 +83,41 @@ char mapaBases[5]={'A','T','G','C','-'};
 
 /* seqMaior e seqMenor representam as duas sequencias de bases de entrada, a
    serem comparadas, inicializadas conforme segue. Elas conterao os indices aos
-   inves dos proprios caracteres. seqMenor deve ser menor ou igual a seqMaior. */
+   inves dos proprios caracteres. seqMenor deve ser menor ou igual a seqMaior.
+   As sequencias sao guardadas compactadas (SeqCompacta, abaixo), com o tamanho
+   real das sequencias. */
+
+/* Sequencia compactada: cada base ocupa 2 bits (A=0, T=1, G=2, C=3), 32 bases
+   por palavra de 64 bits, e uma mascara separada, de 1 bit por posicao, marca as
+   posicoes sem base (os gaps de um alinhamento), que baseEm devolve como X. Sao
+   3 bits por posicao em vez dos 32 de um int. Posicoes vizinhas compartilham
+   palavras, entao duas threads nao devem escrever na mesma sequencia; os lacos
+   de calculo leem as bases ja desempacotadas, um byte por base. */
+
+typedef struct {
+  uint64_t *bases;    /* 2 bits por base, 32 bases por palavra */
+  uint64_t *mascara;  /* 1 bit por posicao, 1 = sem base (gap) */
+  size_t cap;         /* posicoes alocadas */
+} SeqCompacta;
+
+#define PALAVRAS_BASES(n)   (((size_t)(n)+31)/32)
+#define PALAVRAS_MASCARA(n) (((size_t)(n)+63)/64)
 
-int  seqMaior[maxSeq]={A,A,C,T,T,A},
-     seqMenor[maxSeq]={A,C,T,T,G,A};
+int  seqMaiorInicial[6]={A,A,C,T,T,A},
+     seqMenorInicial[6]={A,C,T,T,G,A};
+
+SeqCompacta seqMaior={NULL,NULL,0},
+            seqMenor={NULL,NULL,0};
 
 /* alinhaGMaior representa a sequencia maior ja alinhada, assim como alinhaGMenor,
    ambas obtidas no traceback. As duas juntas, pareadas, formam o alinhamento
    global. Tal alinhamento global pode ser obtido de duas formas: a partir do
-   primeiro maior escore ou a partir do ultimo maior escore */
+   primeiro maior escore ou a partir do ultimo maior escore. Ambos tem espaco
+   para tamSeqMaior+tamSeqMenor posicoes, o maior alinhamento possivel, e marcam
+   os gaps na mascara da sequencia compactada. */
 
-int  alinhaGMaior[maxSeq],
-     alinhaGMenor[maxSeq];
+SeqCompacta alinhaGMaior={NULL,NULL,0},
+            alinhaGMenor={NULL,NULL,0};
 
 /* matrizEscores representa a matriz de escores que sera preenchida pelo metodo.
    A matriz, ao final de seu preenchimento, permitira obter o melhor alinhamento
@@ -87,9 +125,85 @@ int  alinhaGMaior[maxSeq],
    denominada TraceBack. Uma linha e uma coluna extras sao adicionadas na matriz
    para inicializar as pontuacoes/escores. Trata-se da linha 0 e coluna 0. A
    matriz de escores tera tamSeqMenor+1 linhas e tamSeqMaior+1 colunas.
-   Considera-se a primeira dimensao da matriz como linhas e a segunda como colunas.*/
+   Considera-se a primeira dimensao da matriz como linhas e a segunda como colunas.
+
+   A matriz eh alocada sob demanda em uma unica area contigua, alinhada em 64
+   bytes, em que cada linha ocupa passoLinha inteiros (tamSeqMaior+1 arredondado
+   para um multiplo de 16). matrizEscores aponta para o inicio de cada linha,
+   mantendo o acesso matrizEscores[lin][col]. Se a matriz vier de um arquivo
+   binario mapeado (opcao -r), as linhas apontam para o mapeamento. No modo de
+   tarefas (opcao -j), a area eh mantida entre um par e outro e so cresce. */
+
+#define ALINHAMENTO_LINHA 16 // inteiros por linha de cache de 64 bytes
+
+int **matrizEscores=NULL,   /* ponteiros para as linhas da matriz */
+    *blocoEscores=NULL;     /* area alocada, sem o ajuste de alinhamento */
+char *mapaMatriz=NULL;      /* arquivo binario mapeado como matriz (opcao -r) */
+size_t tamMapaMatriz=0;
+size_t capEscores=0;        /* bytes uteis de blocoEscores */
+int reaproveitaArea=0;      /* 1 = liberaMatrizEscores mantem blocoEscores */
+int passoLinha=0,           /* distancia, em inteiros, entre duas linhas */
+    linMatriz=0,            /* linhas da matriz alocada */
+    colMatriz=0;            /* colunas da matriz alocada */
+
+/* matrizDirecoes guarda, para cada celula [lin,col] com lin,col >= 1, de quais
+   vizinhos o escore da celula pode ter vindo: DIR_DIAG (pareamento das bases),
+   DIR_ESQ (celula da esquerda, gap na seqMenor) e DIR_CIMA (celula de cima, gap
+   na seqMaior). Mais de um bit ligado indica empate, isto eh, caminhos otimos
+   alternativos. Sao 4 bits por celula, duas celulas por byte, passoDirecoes
+   bytes por linha. No modo de direcoes (opcao -d), o preenchimento grava essa
+   matriz e descarta a matriz de escores, 8 vezes maior, e o traceback segue
+   apenas os bits.
+
+   Com gaps afins (opcao -g), o escore de uma celula nao basta para saber se um
+   gap que chega nela foi aberto ali ou vem sendo estendido, entao cada celula
+   ocupa um byte, com quatro bits a mais: DIR_ESQ_ESTENDE, o gap horizontal que
+   termina na celula pode ser a extensao do gap da celula da esquerda, e
+   DIR_ESQ_ABRE, ele pode ter sido aberto ali, a partir do escore da celula da
+   esquerda; DIR_CIMA_ESTENDE e DIR_CIMA_ABRE, o mesmo para o gap vertical e a
+   celula de cima. Os dois bits de um gap ligados indicam empate entre estender
+   e abrir. Nesse caso a matriz de direcoes eh gravada tambem no modo da matriz
+   de escores, no lugar das duas matrizes extras de gaps do algoritmo de
+   Gotoh. */
+
+#define DIR_DIAG 1
+#define DIR_ESQ  2
+#define DIR_CIMA 4
+#define DIR_ESQ_ESTENDE  8
+#define DIR_CIMA_ESTENDE 16
+#define DIR_ESQ_ABRE     32
+#define DIR_CIMA_ABRE    64
+
+#define MODO_MATRIZ   0 /* matriz de escores completa */
+#define MODO_DIRECOES 1 /* so a matriz de direcoes (opcao -d) */
+#define MODO_ESCORE   2 /* so os maiores escores e suas celulas (opcao -e) */
+#define MODO_CONTROLE 3 /* so as linhas de controle, recalculando as faixas
+                           entre elas no traceback (opcao -c) */
+#define MODO_COMPACTA 4 /* matriz de escores em diferencas de poucos bits
+                           (opcao -z) */
+
+int modoPreenchimento=MODO_MATRIZ;
+int gravaMatriz=1;          /* grava matriz_escores.bin no modo da matriz; 0 no
+                               modo de tarefas (opcao -j) */
+int mostraDetalhes=1;       /* mostra os passos do traceback e os alinhamentos
+                               na tela; 0 no modo nao interativo (-i e -j) */
+unsigned char *matrizDirecoes=NULL;  /* tamSeqMenor linhas de passoDirecoes bytes */
+size_t passoDirecoes=0;
+size_t orcamentoControle=0; /* memoria do modo de linhas de controle, em bytes */
+int *linhasControle=NULL;   /* linhas 0, passoControle, 2*passoControle, ...
+                               de larguraControle inteiros */
+int passoControle=0;        /* linhas entre duas linhas de controle */
+size_t larguraControle=0;
+
+typedef struct {
+  int32_t *ancoras;   /* um escore por bloco de celulas */
+  uint64_t *deltas;   /* bitsDelta palavras por linha de cada bloco */
+  int blocosCol;      /* blocos em cada linha de blocos */
+  int bitsDelta;      /* bits por diferenca: 2, 4, 8 ou 16 */
+  int menorDelta;     /* diferenca guardada como 0 */
+} MatrizCompacta;
 
-int matrizEscores[maxSeq+1][maxSeq+1];
+MatrizCompacta compacta={NULL, NULL, 0, 0, 0}; /* modo da matriz compacta */
 
 int tamSeqMaior=6,  /* tamanho da sequencia maior, inicializado como 6 */
     tamSeqMenor=6,  /* tamanho da sequencia menor, inicializado como 6 */
@@ -103,6 +217,9 @@ int tamSeqMaior=6,  /* tamanho da sequencia maior, inicializado como 6 */
     escoreLin,       /* escore da linha anterior da matriz de escores */
     escoreCol,       /* escore da coluna anterior da matriz de escores */
    numthreads;
+int penalAbre=0;    /* penalidade de abertura de gap (opcao -g), descontada uma
+                       vez por gap, alem de penalGap por posicao; 0 = gaps
+                       lineares */
 /*  matrizPesos contem os pesos do pareamento de bases. Estruturada e inicializada
     conforme segue, onde cada linha ou coluna se refere a uma das bases A, T, G
     ou C. Considera-se a primeira dimensao da matriz como linhas e a segunda como
@@ -128,688 +245,6151 @@ int indRef=-1,  // indice da sequencia maior a partir do qual extrai a sequencia
     linUMaior, colUMaior, UMaior; // suporte para deteccao do ultimo maior escore
 
 
-/* leitura de arquivo que contem as sequências */
-void leSequenciasDeArquivo(char* fileName) {
-    FILE *file = fopen(fileName, "r");
-    if (file == NULL) {
-        printf("Erro ao abrir o arquivo %s.\n", fileName);
-        exit(1);
-    }
+/* arredonda um ponteiro para o proximo endereco multiplo de 64 bytes */
+char *alinhaPonteiro(void *p)
+{
+  return (char*)p+(64-((size_t)p%64))%64;
+}
 
-    char buffer[maxSeq + 2]; // Buffer para leitura incluindo o newline e null terminator
+/* tempo decorrido, em segundos, de um relogio monotonico */
+double tempoAtual(void)
+{ struct timespec t;
 
-    // Leitura da sequência maior
-    if (fgets(buffer, sizeof(buffer), file) != NULL) {
-        tamSeqMaior = strlen(buffer);
-        if (buffer[tamSeqMaior - 1] == '\n') {
-            buffer[tamSeqMaior - 1] = '\0';
-            tamSeqMaior--;
-        }
-        for (int i = 0; i < tamSeqMaior; i++) {
-            switch (buffer[i]) {
-                case 'A': seqMaior[i] = A; break;
-                case 'T': seqMaior[i] = T; break;
-                case 'G': seqMaior[i] = G; break;
-                case 'C': seqMaior[i] = C; break;
-                default:
-                    printf("Caractere inválido na sequência maior: %c\n", buffer[i]);
-                    fclose(file);
-                    exit(1);
-            }
-        }
-    } else {
-        printf("Erro ao ler a sequência maior do arquivo %s.\n", fileName);
-        fclose(file);
-        exit(1);
-    }
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec+t.tv_nsec*1e-9;
+}
 
-    // Leitura da sequência menor
-    if (fgets(buffer, sizeof(buffer), file) != NULL) {
-        tamSeqMenor = strlen(buffer);
-        if (buffer[tamSeqMenor - 1] == '\n') {
-            buffer[tamSeqMenor - 1] = '\0';
-            tamSeqMenor--;
-        }
-        for (int i = 0; i < tamSeqMenor; i++) {
-            switch (buffer[i]) {
-                case 'A': seqMenor[i] = A; break;
-                case 'T': seqMenor[i] = T; break;
-                case 'G': seqMenor[i] = G; break;
-                case 'C': seqMenor[i] = C; break;
-                default:
-                    printf("Caractere inválido na sequência menor: %c\n", buffer[i]);
-                    fclose(file);
-                    exit(1);
-            }
-        }
-    } else {
-        printf("Erro ao ler a sequência menor do arquivo %s.\n", fileName);
-        fclose(file);
-        exit(1);
-    }
+/* escore da celula [k,0] ou [0,k] da borda da matriz: um gap de k posicoes */
+int escoreBorda(int k)
+{
+  return (k==0) ? 0 : -(penalAbre+k*penalGap);
+}
 
-    fclose(file);
+/* libera a matriz de direcoes */
+void liberaMatrizDirecoes(void)
+{
+  free(matrizDirecoes);
+  matrizDirecoes=NULL;
+  passoDirecoes=0;
 }
 
-/* leitura do tamanho da sequencia maior */
-int leTamMaior(void)
+/* Gravacao da matriz binaria em segundo plano. Durante o preenchimento no modo
+   da matriz, uma thread de gravacao (escritorMatriz) copia para o arquivo as
+   linhas que ja sao finais, enquanto os blocos seguintes ainda sao calculados,
+   e termina o arquivo depois, em paralelo com o traceback. Ela so le a matriz,
+   que nao pode ser liberada nem preenchida de novo antes de aguardaEscritor. */
+typedef struct {
+  pthread_t thread;
+  int ativo;                 /* ha uma gravacao em andamento */
+  int linhasProntas;         /* linhas 0..linhasProntas-1 da matriz sao finais */
+  int preenchida;            /* preenchimento concluido, maiores conhecidos */
+  int PMaior, linPMaior, colPMaior, UMaior, linUMaior, colUMaior;
+  int ok;                    /* resultado da gravacao */
+  double inicio, fim, fimPreenchimento;
+  char nome[1024];
+  pthread_mutex_t mutex;     /* protege linhasProntas, preenchida e os maiores */
+  pthread_cond_t mudou;
+} EscritorMatriz;
+
+EscritorMatriz escritor;
+
+/* avisa a thread de gravacao de que as linhas 0..linhas-1 estao prontas */
+void liberaLinhasEscritor(int linhas)
 {
-  printf("\nLeitura do Tamanho da Sequencia Maior:");
-  do
-  { printf("\nDigite 0 < valor < %d = ", maxSeq);
-    scanf("%d", &tamSeqMaior);
-  } while ((tamSeqMaior<1)||(tamSeqMaior>maxSeq));
+  if (!escritor.ativo)
+    return;
+  pthread_mutex_lock(&escritor.mutex);
+  if (linhas>escritor.linhasProntas)
+    escritor.linhasProntas=linhas;
+  pthread_cond_signal(&escritor.mudou);
+  pthread_mutex_unlock(&escritor.mutex);
 }
 
-/* leitura do tamanho da sequencia menor */
-int leTamMenor(void)
+/* espera a gravacao em segundo plano terminar e informa o resultado */
+void aguardaEscritor(void)
 {
-  printf("\nLeitura do Tamanho da Sequencia Menor:");
-  do
-  {  printf("\nDigite 0 < valor <= %d = ", tamSeqMaior);
-     scanf("%d", &tamSeqMenor);
-  } while ((tamSeqMenor<1)||(tamSeqMenor>tamSeqMaior));
+  if (!escritor.ativo)
+    return;
+  pthread_join(escritor.thread, NULL);
+  pthread_cond_destroy(&escritor.mudou);
+  pthread_mutex_destroy(&escritor.mutex);
+  escritor.ativo=0;
+  if (!escritor.ok)
+    printf("\nErro ao gravar o arquivo %s\n", escritor.nome);
+  else
+    printf("\nMatriz de escores salva no arquivo '%s' (%.3f s de gravacao, %.3f s alem do preenchimento)\n",
+           escritor.nome, escritor.fim-escritor.inicio,
+           (escritor.fim>escritor.fimPreenchimento) ? escritor.fim-escritor.fimPreenchimento : 0.0);
 }
 
-/* leitura do valor da penalidade de gap */
-int lePenalidade(void)
-{   int penal;
+/* libera a matriz de escores, por exemplo quando as sequencias sao redefinidas
+   e a matriz anterior deixa de corresponder a elas, e a de direcoes, as
+   linhas de controle e a matriz compacta junto */
+void liberaMatrizEscores(void)
+{
+  aguardaEscritor();
+  liberaMatrizDirecoes();
+  free(linhasControle);
+  linhasControle=NULL;
+  free(compacta.ancoras);
+  free(compacta.deltas);
+  compacta.ancoras=NULL;
+  compacta.deltas=NULL;
+  free(matrizEscores);
+  if (!reaproveitaArea)
+  {
+    free(blocoEscores);
+    blocoEscores=NULL;
+    capEscores=0;
+  }
+  if (mapaMatriz!=NULL)
+    munmap(mapaMatriz, tamMapaMatriz);
+  mapaMatriz=NULL;
+  tamMapaMatriz=0;
+  matrizEscores=NULL;
+  linMatriz=0;
+  colMatriz=0;
+}
 
-  printf("\nLeitura da Penalidade de Gap:");
-  do
+/* aloca a matriz de direcoes, com 4 bits por celula ou, com gaps afins, um
+   byte. Retorna 0 se nao houver memoria suficiente. */
+int alocaMatrizDirecoes(void)
+{
+  passoDirecoes=(penalAbre>0) ? (size_t)tamSeqMaior : ((size_t)tamSeqMaior+1)/2;
+  matrizDirecoes=malloc((size_t)tamSeqMenor*passoDirecoes+1);
+  if (matrizDirecoes==NULL)
   {
-    printf("\nDigite valor >= 0 = ");
-    scanf("%d", &penal);
-  } while (penal<0);
+    printf("\nMemoria insuficiente para a matriz de direcoes %d x %d\n", tamSeqMenor, tamSeqMaior);
+    liberaMatrizDirecoes();
+    return 0;
+  }
+  return 1;
+}
 
-  return penal;
+/* aloca a matriz de escores com tamSeqMenor+1 linhas e tamSeqMaior+1 colunas.
+   Se a matriz atual ja tem essas dimensoes, ela eh reaproveitada, assim como
+   uma area mantida por reaproveitaArea que ja tenha o tamanho necessario.
+   Retorna 0 se nao houver memoria suficiente. */
+int alocaMatrizEscores(void)
+{ size_t total;
+  char *inicio;
+  int lin;
+
+  aguardaEscritor(); // a matriz sera preenchida de novo
+  if ((matrizEscores!=NULL)&&(linMatriz==tamSeqMenor+1)&&(colMatriz==tamSeqMaior+1))
+    return 1;
+
+  liberaMatrizEscores();
+  passoLinha=((tamSeqMaior+1+ALINHAMENTO_LINHA-1)/ALINHAMENTO_LINHA)*ALINHAMENTO_LINHA;
+  total=(size_t)(tamSeqMenor+1)*passoLinha*sizeof(int);
+
+  if (total>capEscores)
+  {
+    free(blocoEscores);
+    blocoEscores=malloc(total+64);
+    capEscores=(blocoEscores!=NULL) ? total : 0;
+  }
+  matrizEscores=malloc((size_t)(tamSeqMenor+1)*sizeof(int*));
+  if ((blocoEscores==NULL)||(matrizEscores==NULL))
+  {
+    printf("\nMemoria insuficiente para a matriz de escores %d x %d\n", tamSeqMenor+1, tamSeqMaior+1);
+    liberaMatrizEscores();
+    return 0;
+  }
+
+  /* ajusta o inicio da area para o proximo endereco multiplo de 64 */
+  inicio=alinhaPonteiro(blocoEscores);
+  for (lin=0; lin<=tamSeqMenor; lin++)
+    matrizEscores[lin]=(int*)inicio+(size_t)lin*passoLinha;
+
+  linMatriz=tamSeqMenor+1;
+  colMatriz=tamSeqMaior+1;
+  return 1;
 }
 
-/* leitura da matriz de pesos */
-void leMatrizPesos()
-{ int i,j;
+/* base da posicao i de uma sequencia compactada, ou X se a posicao nao tem base */
+static inline int baseEm(const SeqCompacta *s, size_t i)
+{
+  if ((s->mascara[i>>6]>>(i&63))&1)
+    return X;
+  return (int)((s->bases[i>>5]>>(2*(i&31)))&3);
+}
 
-  printf("\nLeitura da Matriz de Pesos:\n");
-  for (i=0; i<4; i++)
+/* grava na posicao i a base b, ou X para uma posicao sem base */
+static inline void defineBase(SeqCompacta *s, size_t i, int b)
+{ uint64_t bit=(uint64_t)1<<(i&63);
+  int desl=2*(int)(i&31);
+
+  s->bases[i>>5]&=~((uint64_t)3<<desl);
+  if (b==X)
+    s->mascara[i>>6]|=bit;
+  else
   {
-    for (j=0; j<4; j++)
+    s->mascara[i>>6]&=~bit;
+    s->bases[i>>5]|=(uint64_t)b<<desl;
+  }
+}
+
+/* (re)dimensiona uma sequencia compactada para n posicoes, preservando as que
+   ja existiam; as novas ficam com a base A. Retorna 0 se nao houver memoria. */
+int redimensionaCompacta(SeqCompacta *s, size_t n)
+{ size_t antBases=PALAVRAS_BASES(s->cap), antMascara=PALAVRAS_MASCARA(s->cap);
+  size_t novBases=PALAVRAS_BASES(n>0?n:1), novMascara=PALAVRAS_MASCARA(n>0?n:1);
+  uint64_t *bases, *mascara;
+
+  if (s->bases==NULL)
+    antBases=antMascara=0;
+  bases=realloc(s->bases, novBases*sizeof(uint64_t));
+  if (bases==NULL)
+    return 0;
+  s->bases=bases;
+  mascara=realloc(s->mascara, novMascara*sizeof(uint64_t));
+  if (mascara==NULL)
+    return 0;
+  s->mascara=mascara;
+  if (novBases>antBases)
+    memset(s->bases+antBases, 0, (novBases-antBases)*sizeof(uint64_t));
+  if (novMascara>antMascara)
+    memset(s->mascara+antMascara, 0, (novMascara-antMascara)*sizeof(uint64_t));
+  s->cap=n;
+  return 1;
+}
+
+/* desempacota n posicoes a partir de inicio, um byte por posicao (X nos gaps):
+   eh a forma usada pelos lacos de calculo, que percorrem as bases em sequencia */
+void desempacotaBases(const SeqCompacta *s, size_t inicio, int n, unsigned char *dest)
+{ size_t i=inicio, fim=inicio+n;
+  uint64_t bases, mascara;
+  int k, lim;
+
+  while (i<fim)
+  {
+    bases=s->bases[i>>5]>>(2*(i&31));
+    mascara=s->mascara[i>>6]>>(i&63);
+    lim=32-(int)(i&31); /* o resto da palavra de bases cabe na de mascara */
+    if ((size_t)lim>fim-i)
+      lim=(int)(fim-i);
+    for (k=0; k<lim; k++)
     {
-      printf("Digite valor %c x %c = ", mapaBases[i], mapaBases[j]);
-      scanf("%d",&(matrizPesos[i][j]));
+      *dest++=(mascara&1) ? X : (unsigned char)(bases&3);
+      bases>>=2;
+      mascara>>=1;
     }
-    printf("\n");
+    i+=lim;
   }
 }
 
-/* mostra da matriz de pesos */
-void mostraMatrizPesos(void)
-{ int i,j;
+/* empacota n posicoes (um byte por posicao, X nos gaps) a partir de inicio */
+void empacotaBases(SeqCompacta *s, size_t inicio, const unsigned char *orig, int n)
+{ int k;
 
-  printf("\nMatriz de Pesos Atual:");
-  printf("\n%4c%4c%4c%4c%4c\n",' ','A','T','G','C');
-  for (i=0; i<4; i++)
+  for (k=0; k<n; k++)
+    defineBase(s, inicio+k, orig[k]);
+}
+
+/* (re)aloca uma sequencia para tam bases. Como a matriz de escores anterior
+   deixa de valer para as novas sequencias, ela eh liberada. */
+void alocaSequencia(SeqCompacta *seq, int tam)
+{
+  liberaMatrizEscores();
+  if (!redimensionaCompacta(seq, (size_t)tam))
   {
-    printf("%4c",mapaBases[i]);
-    for (j=0; j<4; j++)
-      printf("%4d",matrizPesos[i][j]);
-    printf("\n");
+    printf("\nMemoria insuficiente para uma sequencia de %d bases\n", tam);
+    exit(1);
   }
 }
 
+/* aloca as sequencias do alinhamento global com espaco para o pior caso,
+   tamSeqMaior+tamSeqMenor posicoes */
+void alocaAlinhamento(void)
+{
+  if (!redimensionaCompacta(&alinhaGMaior, (size_t)tamSeqMaior+tamSeqMenor)||
+      !redimensionaCompacta(&alinhaGMenor, (size_t)tamSeqMaior+tamSeqMenor))
+  {
+    printf("\nMemoria insuficiente para o alinhamento\n");
+    exit(1);
+  }
+}
 
-/* leitura da porcentagem maxima (grau) de mutacao aleatoria. Essa porcentagem eh
-   usada na geracao aleatoria da seqMenor. A seqMenor eh obtida a partir da seqMaior, para se parecer com ela, se diferenciando
-   por um certo grau de alteracoes em suas bases, fornecida pelo usuario. Esse
-   metodo evita a gera��o aleatoria de sequencias totalmente diferentes. A
-   quantidade de trocas realizadas eh no maximo a porcentagem aqui informada. */
+/* Alinhamento em operacoes de edicao, como no CIGAR estendido do SAM/BAM: cada
+   operacao ocupa um uint32_t, com o comprimento nos 28 bits altos e o codigo
+   nos 4 baixos (os mesmos do BAM). OP_IGUAL (=) e OP_TROCA (X) pareiam uma
+   base de cada sequencia, OP_INSERE (I) consome so uma base da seqMenor e
+   OP_REMOVE (D) so uma da seqMaior, que faz o papel de referencia. Como o
+   traceback anda do fim para o inicio, as operacoes sao escritas de tras para
+   frente a partir do fim de ops, que tem espaco para o pior caso (uma operacao
+   por coluna): o alinhamento fica em ops[ini..cap-1] ja na ordem certa, sem
+   passo de inversao, e ocupa uma palavra por trecho sem edicao, nao por
+   coluna. */
+
+#define OP_INSERE 1
+#define OP_REMOVE 2
+#define OP_IGUAL  7
+#define OP_TROCA  8
 
-int leGrauMutacao(void)
-{ int prob;
+typedef struct {
+  uint32_t *ops;
+  int cap, ini;   /* operacoes alocadas e a primeira usada (cap = vazio) */
+} Cigar;
 
-  printf("\nLeitura da Porcentagem Maxima de Mutacao Aleatoria:\n");
-  do
-  { printf("\nDigite 0 <= valor <= 100 = ");
-    scanf("%d", &prob);
-  } while ((prob<0)||(prob>100));
+/* garante espaco para n operacoes e esvazia o alinhamento. Retorna 0 se nao
+   houver memoria. */
+int redimensionaCigar(Cigar *c, int n)
+{ uint32_t *ops;
 
-  return prob;
+  if (n>c->cap)
+  {
+    ops=realloc(c->ops, (size_t)n*sizeof(uint32_t));
+    if (ops==NULL)
+      return 0;
+    c->ops=ops;
+    c->cap=n;
+  }
+  c->ini=c->cap;
+  return 1;
 }
 
-/* leitura manual das sequencias de entrada seqMaior e seqMenor */
-void leSequencias(void)
-{ int i, erro;
-  char seqMaiorAux[maxSeq], seqMenorAux[maxSeq];
+/* acrescenta n colunas da operacao op antes das ja escritas, estendendo a
+   primeira operacao se ela for a mesma */
+static inline void acrescentaOps(Cigar *c, int op, int n)
+{
+  if ((c->ini<c->cap)&&((int)(c->ops[c->ini]&0xF)==op))
+    c->ops[c->ini]+=(uint32_t)n<<4;
+  else
+    c->ops[--c->ini]=((uint32_t)n<<4)|op;
+}
 
-  indRef=-1;
-  nTrocas=-1;
-  printf("\nLeitura das Sequencias:\n");
+/* expande as operacoes em duas sequencias alinhadas, coluna a coluna, da
+   esquerda para a direita. Retorna o tamanho do alinhamento. */
+int expandeCigar(const Cigar *c, SeqCompacta *gMaior, SeqCompacta *gMenor)
+{ int i, n, op, lin=0, col=0, pos=0;
 
-  /* lendo a sequencia maior */
-  do
+  for (i=c->ini; i<c->cap; i++)
   {
-    printf("\nPara a Sequencia Maior,");
-    printf("\nDigite apenas caracteres 'A', 'T', 'G' e 'C'");
-    do
-    { printf("\n> ");
-      fgets(seqMaiorAux,maxSeq,stdin);
-      tamSeqMaior=strlen(seqMaiorAux)-1; /* remove o enter */
-    } while (tamSeqMaior<1);
-    printf("\ntamSeqMaior = %d\n",tamSeqMaior);
-    i=0;
-    erro=0;
-    do
+    op=c->ops[i]&0xF;
+    for (n=c->ops[i]>>4; n>0; n--, pos++)
     {
-      switch (seqMaiorAux[i])
-      {
-        case 'A': seqMaior[i]=A;
-                  break;
-        case 'T': seqMaior[i]=T;
-                  break;
-        case 'G': seqMaior[i]=G;
-                  break;
-        case 'C': seqMaior[i]=C;
-                  break;
-        default: erro=1;  /* nao eh permitido qquer outro caractere */
-      }
-      i++;
-    } while ((erro==0)&&(i<tamSeqMaior));
-  }while (erro==1);
+      defineBase(gMaior, pos, (op==OP_INSERE) ? X : baseEm(&seqMaior, col++));
+      defineBase(gMenor, pos, (op==OP_REMOVE) ? X : baseEm(&seqMenor, lin++));
+    }
+  }
+  return pos;
+}
 
-  /* lendo a sequencia menor */
-  do
-  {
-    printf("\nPara a Sequencia Menor, ");
-    printf("\nDigite apenas caracteres 'A', 'T', 'G' e 'C'");
-    do
-    { printf("\n> ");
-      fgets(seqMenorAux,maxSeq,stdin);
-      tamSeqMenor=strlen(seqMenorAux)-1; /* remove o enter */
-    } while ((tamSeqMenor<1)||(tamSeqMenor>tamSeqMaior));
-    printf("\ntamSeqMenor = %d\n",tamSeqMenor);
+/* converte um alinhamento em colunas (de Hirschberg ou da banda) em operacoes.
+   Retorna 0 se nao houver memoria. */
+int cigarDeColunas(Cigar *c, const SeqCompacta *gMaior, const SeqCompacta *gMenor, int tam)
+{ int pos, bMaior, bMenor;
 
-    i=0;
-    erro=0;
-    do
-    {
-      switch (seqMenorAux[i])
-      {
-        case 'A': seqMenor[i]=A;
-                  break;
-        case 'T': seqMenor[i]=T;
-                  break;
-        case 'G': seqMenor[i]=G;
-                  break;
-        case 'C': seqMenor[i]=C;
-                  break;
-        default: erro=1;
-      }
-      i++;
-    } while ((erro==0)&&(i<tamSeqMenor));
-  }while (erro==1);
+  if (!redimensionaCigar(c, tam))
+    return 0;
+  for (pos=tam-1; pos>=0; pos--)
+  {
+    bMaior=baseEm(gMaior, pos);
+    bMenor=baseEm(gMenor, pos);
+    if (bMaior==X)
+      acrescentaOps(c, OP_INSERE, 1);
+    else if (bMenor==X)
+      acrescentaOps(c, OP_REMOVE, 1);
+    else
+      acrescentaOps(c, (bMaior==bMenor) ? OP_IGUAL : OP_TROCA, 1);
+  }
+  return 1;
 }
 
+/* le uma linha de tamanho arbitrario, aumentando o buffer conforme necessario.
+   Retorna o tamanho lido, sem o '\n' (e sem '\r'), ou -1 no fim do arquivo */
+int leLinha(FILE *arq, char **buffer, size_t *cap)
+{ size_t tam=0;
 
-/* geracao das sequencias aleatorias, conforme tamanho. Gera-se numeros aleatorios
-   de 0 a 3 representando as bases 'A', 'T', 'G' e 'C'. Gera-se primeiramente a
-   maior sequencia e desta extrai a menor sequencia. A menor sequencia eh obtida
-   da maior por meio de algumas trocas de bases (mutacoes), de acordo com o grau
-   de mutacao informado. A ideia eh gerar sequencias parecidas, mas com certo grau
-   de diferenca. */
-
-void geraSequencias(void)
-{   int i, dif, probAux;
-    char base;
+  if (*buffer==NULL)
+  {
+    *cap=1024;
+    *buffer=malloc(*cap);
+  }
+  while (fgets(*buffer+tam, (int)(*cap-tam), arq)!=NULL)
+  {
+    tam+=strlen(*buffer+tam);
+    if ((tam>0)&&((*buffer)[tam-1]=='\n'))
+      break;
+    if (tam+1<*cap)
+      break; /* fim do arquivo sem '\n' */
+    *cap*=2;
+    *buffer=realloc(*buffer, *cap);
+  }
+  if (tam==0)
+    return -1;
+  while ((tam>0)&&(((*buffer)[tam-1]=='\n')||((*buffer)[tam-1]=='\r')))
+    tam--;
+  (*buffer)[tam]='\0';
+  return (int)tam;
+}
 
-    printf("\nGeracao Aleatoria das Sequencias:\n");
+/* Leitura de sequencias de arquivo. O arquivo eh mapeado em memoria (mmap) e
+   percorrido registro a registro, sem copiar as linhas para um buffer: cada
+   registro aponta para o seu trecho no mapeamento, e as bases sao codificadas
+   dali direto para a sequencia compactada. O formato eh reconhecido pelo
+   primeiro caractere do arquivo:
 
-    /* gerando a sequencia maior */
-    for (i=0; i<tamSeqMaior; i++)
-      {
-        base=rand()%4; /* produz valores de 0 a 3 */
-        seqMaior[i]= base;
-      }
+     '>'    FASTA: o cabecalho na linha do '>' e as bases em uma ou mais
+            linhas, ate o proximo '>';
+     '@'    FASTQ: o cabecalho na linha do '@', as bases em uma ou mais linhas
+            ate a linha do '+' e as qualidades, com o mesmo numero de
+            caracteres das bases, que sao ignoradas;
+     outro  uma sequencia por linha, o formato original do programa; linhas
+            vazias sao ignoradas.
 
-    dif=tamSeqMaior-tamSeqMenor; /* diferenca entre os tamanhos das sequencias */
+   Letras minusculas valem como maiusculas. Registros consecutivos formam os
+   pares, na ordem do arquivo. Se o arquivo nao puder ser mapeado (um pipe, por
+   exemplo), ele eh lido inteiro para a memoria. */
 
-    indRef=0;
-    if (dif>0)
-      indRef=rand()%dif; /* produz um indice aleatorio para indexar a sequencia maior,
-                         para a partir dele extrair a primeira versao da sequencia
-                         menor */
+#define FORMATO_LINHAS 0
+#define FORMATO_FASTA  1
+#define FORMATO_FASTQ  2
 
-    /* gerando a sequencia menor a partir da maior. Copia trecho da sequencia
-       maior, a partir de um indice aleatorio que nao ultrapasse os limites do
-       vetor maior */
-    for (i=0; i<tamSeqMenor; i++)
-        seqMenor[i]=seqMaior[indRef+i];
+typedef struct {
+  const char *nomeArquivo;
+  char *dados;          /* conteudo do arquivo */
+  size_t tam, pos;      /* tamanho do arquivo e inicio do proximo registro */
+  int formato;
+  int mapeado;          /* 1 = dados vem do mmap, 0 = lidos para a memoria */
+  size_t registros;     /* registros ja lidos */
+} LeitorSeq;
 
-    /* causa mutacoes aleatorias na sequencia menor para gerar "gaps",
-       sobre cada base, de acordo com o grau (porcentagem) informado.
-       A mutacao causa a troca da base original por outra base aleatoria
-       necessariamente diferente. Gera-se uma probabilidade aleatoria
-       ateh 100 e se ela estiver dentro do grau informado, a mutacao
-       ocorre na base, caso contrario, mantem a base copiada. */
+typedef struct {
+  const char *nome;     /* primeira palavra do cabecalho ("" sem cabecalho) */
+  int tamNome;
+  const char *trecho;   /* bases no arquivo, ainda com as quebras de linha */
+  size_t tamTrecho;     /* bytes do trecho */
+  size_t numBases;      /* bases do trecho, sem as quebras de linha */
+  size_t indice;        /* posicao do registro no arquivo, a partir de 1 */
+} RegistroSeq;
+
+/* 1 + indice da base de cada caractere, 0 para os invalidos */
+const unsigned char valorBase[256]={['A']=A+1, ['T']=T+1, ['G']=G+1, ['C']=C+1,
+                                    ['a']=A+1, ['t']=T+1, ['g']=G+1, ['c']=C+1};
+
+#define BYTES_PARTE_LEITURA (4<<20) // trecho minimo por thread na codificacao
+#define CODIGOS_LEITURA     4096    // bases traduzidas por vez, antes de empacotar
+
+/* abre e mapeia o arquivo de sequencias. Retorna 0 em caso de erro. */
+int abreLeitor(LeitorSeq *l, const char *nomeArquivo)
+{ struct stat info;
+  size_t cap;
+  ssize_t lidos;
+  int fd;
+
+  memset(l, 0, sizeof(LeitorSeq));
+  l->nomeArquivo=nomeArquivo;
+  fd=open(nomeArquivo, O_RDONLY);
+  if ((fd<0)||(fstat(fd, &info)!=0))
+  {
+    printf("Erro ao abrir o arquivo %s.\n", nomeArquivo);
+    if (fd>=0)
+      close(fd);
+    return 0;
+  }
 
-    i=0;
-    nTrocas=0;
-    while ((i<tamSeqMenor)&&(nTrocas<((grauMuta*tamSeqMenor)/100)))
+  if (S_ISREG(info.st_mode)&&(info.st_size>0))
+  {
+    l->dados=mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (l->dados!=MAP_FAILED)
     {
-      probAux=rand()%100+1;
-
-      if (probAux<=grauMuta)
+      l->tam=(size_t)info.st_size;
+      l->mapeado=1;
+      madvise(l->dados, l->tam, MADV_SEQUENTIAL);
+    }
+    else
+      l->dados=NULL;
+  }
+  if (!l->mapeado)
+  {
+    cap=S_ISREG(info.st_mode) ? (size_t)info.st_size+1 : (size_t)1<<20;
+    l->dados=malloc(cap);
+    while ((l->dados!=NULL)&&((lidos=read(fd, l->dados+l->tam, cap-l->tam))>0))
+    {
+      l->tam+=(size_t)lidos;
+      if (l->tam==cap)
       {
-        seqMenor[i]=(seqMenor[i]+(rand()%3)+1)%4;
-        nTrocas++;
+        cap*=2;
+        l->dados=realloc(l->dados, cap);
       }
-      i++;
     }
+    if (l->dados==NULL)
+    {
+      printf("\nMemoria insuficiente para o arquivo %s\n", nomeArquivo);
+      close(fd);
+      return 0;
+    }
+  }
+  close(fd);
+
+  while ((l->pos<l->tam)&&isspace((unsigned char)l->dados[l->pos]))
+    l->pos++;
+  if ((l->pos<l->tam)&&(l->dados[l->pos]=='>'))
+    l->formato=FORMATO_FASTA;
+  else if ((l->pos<l->tam)&&(l->dados[l->pos]=='@'))
+    l->formato=FORMATO_FASTQ;
+  else
+    l->formato=FORMATO_LINHAS;
+  return 1;
+}
 
-    printf("\nSequencias Geradas: Dif = %d, IndRef = %d, NTrocas = %d\n ",dif, indRef, nTrocas);
+/* desfaz o mapeamento (ou libera a copia) do arquivo */
+void fechaLeitor(LeitorSeq *l)
+{
+  if (l->mapeado)
+    munmap(l->dados, l->tam);
+  else
+    free(l->dados);
+  l->dados=NULL;
+  l->tam=l->pos=0;
 }
 
-/* mostra das sequencias seqMaior e seqMenor */
-void mostraSequencias(void)
-{   int i;
+/* posicao do '\n' que termina a linha iniciada em p, ou o fim do arquivo */
+static size_t fimLinha(const LeitorSeq *l, size_t p)
+{ const char *q=memchr(l->dados+p, '\n', l->tam-p);
 
-  printf("\nSequencias Atuais:\n");
-  printf("\nSequencia Maior, Tam = %d\n", tamSeqMaior);
-  for (i=0; i<tamSeqMaior; i++)
-    printf("%c",mapaBases[seqMaior[i]]);
-  printf("\n");
+  return (q!=NULL) ? (size_t)(q-l->dados) : l->tam;
+}
 
-  for (i=0; i<tamSeqMaior; i++)
-    if (i!=indRef)
-      printf(" ");
-    else printf("^");
-  printf("\nIndice de Referencia = %d\n", indRef);
+/* caracteres uteis da linha [p,fim), sem o '\r' final */
+static size_t tamLinha(const LeitorSeq *l, size_t p, size_t fim)
+{
+  return ((fim>p)&&(l->dados[fim-1]=='\r')) ? fim-p-1 : fim-p;
+}
+
+/* localiza o proximo registro do arquivo, sem copia-lo. Retorna 1 se houver
+   registro, 0 no fim do arquivo e -1 se o registro estiver mal formado. */
+int proximoRegistro(LeitorSeq *l, RegistroSeq *r)
+{ const char *d=l->dados;
+  size_t p=l->pos, fim, qualidades;
+  char marca=(l->formato==FORMATO_FASTA) ? '>' : '@';
+
+  while ((p<l->tam)&&isspace((unsigned char)d[p]))
+    p++;
+  if (p>=l->tam)
+  {
+    l->pos=p;
+    return 0;
+  }
+  r->indice=++l->registros;
+  r->nome="";
+  r->tamNome=0;
+
+  if (l->formato!=FORMATO_LINHAS)
+  {
+    if (d[p]!=marca)
+    {
+      printf("Registro %zu do arquivo %s nao comeca com '%c'.\n", r->indice, l->nomeArquivo, marca);
+      return -1;
+    }
+    fim=fimLinha(l, p);
+    r->nome=d+p+1;
+    while ((r->nome+r->tamNome<d+fim)&&!isspace((unsigned char)r->nome[r->tamNome]))
+      r->tamNome++;
+    p=(fim<l->tam) ? fim+1 : fim;
+  }
+
+  // Linhas de bases: uma so no formato de linhas, ate o proximo '>' ou '+' nos demais
+  r->trecho=d+p;
+  r->numBases=0;
+  do
+  {
+    fim=fimLinha(l, p);
+    r->numBases+=tamLinha(l, p, fim);
+    p=(fim<l->tam) ? fim+1 : fim;
+  } while ((l->formato!=FORMATO_LINHAS)&&(p<l->tam)&&(d[p]!=((l->formato==FORMATO_FASTA) ? '>' : '+')));
+  r->tamTrecho=(size_t)(d+p-r->trecho);
+
+  if (l->formato==FORMATO_FASTQ)
+  {
+    if ((p>=l->tam)||(d[p]!='+'))
+    {
+      printf("Registro %zu do arquivo %s sem a linha '+'.\n", r->indice, l->nomeArquivo);
+      return -1;
+    }
+    p=fimLinha(l, p)+1;
+    for (qualidades=0; (qualidades<r->numBases)&&(p<l->tam); p=fim+1)
+    {
+      fim=fimLinha(l, p);
+      qualidades+=tamLinha(l, p, fim);
+    }
+    if (qualidades!=r->numBases)
+    {
+      printf("Registro %zu do arquivo %s com %zu qualidades para %zu bases.\n", r->indice,
+             l->nomeArquivo, qualidades, r->numBases);
+      return -1;
+    }
+  }
+  if (r->numBases==0)
+  {
+    printf("Registro %zu do arquivo %s sem bases.\n", r->indice, l->nomeArquivo);
+    return -1;
+  }
+  l->pos=(p<l->tam) ? p : l->tam;
+  return 1;
+}
+
+/* localiza o proximo par de registros, com o mais longo em maior. Retorna 1 se
+   houver par, 0 no fim do arquivo e -1 se um registro estiver mal formado. */
+int proximoPar(LeitorSeq *l, RegistroSeq *maior, RegistroSeq *menor)
+{ RegistroSeq aux;
+  int lido;
+
+  if ((lido=proximoRegistro(l, maior))<=0)
+    return lido;
+  if ((lido=proximoRegistro(l, menor))<=0)
+  {
+    if (lido==0)
+      printf("A ultima sequencia do arquivo %s nao tem par e foi ignorada.\n", l->nomeArquivo);
+    return lido;
+  }
+  if (menor->numBases>maior->numBases)
+  {
+    aux=*maior;
+    *maior=*menor;
+    *menor=aux;
+  }
+  return 1;
+}
+
+/* traduz n caracteres em indices de base. Retorna 0 e aponta o caractere em
+   invalido se algum nao for base. */
+static int traduzBases(const char *orig, size_t n, unsigned char *dest, const char **invalido)
+{ size_t i;
+
+  for (i=0; i<n; i++)
+  {
+    if (valorBase[(unsigned char)orig[i]]==0)
+    {
+      *invalido=orig+i;
+      return 0;
+    }
+    dest[i]=valorBase[(unsigned char)orig[i]]-1;
+  }
+  return 1;
+}
+
+/* 32 indices de base em uma palavra de bases compactada */
+static uint64_t empacota32(const unsigned char *cod)
+{ uint64_t palavra=0;
+  int k;
+
+  for (k=31; k>=0; k--)
+    palavra=(palavra<<2)|cod[k];
+  return palavra;
+}
+
+/* quebras de linha ('\n' e '\r') de n bytes */
+static size_t contaQuebras(const char *p, size_t n)
+{ size_t i, quebras=0;
+
+  for (i=0; i<n; i++)
+    quebras+=(p[i]=='\n')|(p[i]=='\r');
+  return quebras;
+}
+
+#ifdef USA_SIMD
+
+/* versoes SSE4.1 das tres funcoes acima. A traducao usa o nibble baixo do
+   caractere, que distingue A, C, G e T em maiusculas e minusculas, como indice
+   de uma tabela de 16 bytes, e confere os 16 caracteres com o bit de minuscula
+   ligado; com algum invalido, o laco escalar refaz o resto e aponta o
+   caractere. O empacotamento junta pares de bases com maddubs (b0+4*b1), pares
+   de pares com madd e leva o byte baixo de cada grupo de 4 bases para a
+   palavra. */
+__attribute__((target("sse4.1")))
+static int traduzBasesSse(const char *orig, size_t n, unsigned char *dest, const char **invalido)
+{ const __m128i tab=_mm_setr_epi8(-1, A, -1, C, T, -1, -1, G, -1, -1, -1, -1, -1, -1, -1, -1);
+  __m128i v, u, ok;
+  size_t i;
+
+  for (i=0; i+16<=n; i+=16)
+  {
+    v=_mm_loadu_si128((const __m128i*)(orig+i));
+    u=_mm_or_si128(v, _mm_set1_epi8(0x20));
+    ok=_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(u, _mm_set1_epi8('a')), _mm_cmpeq_epi8(u, _mm_set1_epi8('t'))),
+                    _mm_or_si128(_mm_cmpeq_epi8(u, _mm_set1_epi8('g')), _mm_cmpeq_epi8(u, _mm_set1_epi8('c'))));
+    if (_mm_movemask_epi8(ok)!=0xFFFF)
+      break;
+    _mm_storeu_si128((__m128i*)(dest+i), _mm_shuffle_epi8(tab, _mm_and_si128(v, _mm_set1_epi8(0x0F))));
+  }
+  return traduzBases(orig+i, n-i, dest+i, invalido);
+}
+
+__attribute__((target("sse4.1")))
+static uint64_t empacota32Sse(const unsigned char *cod)
+{ const __m128i pares=_mm_set1_epi16(0x0401), quartetos=_mm_set1_epi32(0x00100001);
+  __m128i a, b;
+  uint64_t palavra;
+
+  a=_mm_madd_epi16(_mm_maddubs_epi16(_mm_loadu_si128((const __m128i*)cod), pares), quartetos);
+  b=_mm_madd_epi16(_mm_maddubs_epi16(_mm_loadu_si128((const __m128i*)(cod+16)), pares), quartetos);
+  a=_mm_packus_epi16(_mm_packs_epi32(a, b), _mm_setzero_si128());
+  _mm_storel_epi64((__m128i*)&palavra, a);
+  return palavra;
+}
+
+__attribute__((target("sse4.1")))
+static size_t contaQuebrasSse(const char *p, size_t n)
+{ __m128i v;
+  size_t i, quebras=0;
+
+  for (i=0; i+16<=n; i+=16)
+  {
+    v=_mm_loadu_si128((const __m128i*)(p+i));
+    v=_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+    quebras+=__builtin_popcount(_mm_movemask_epi8(v));
+  }
+  return quebras+contaQuebras(p+i, n-i);
+}
+
+#endif
+
+int leituraSimd=-1; /* 1 = traducao e empacotamento com SSE4.1, -1 = nao verificado */
+
+/* grava n indices de base a partir da posicao pos de s: as posicoes ate a
+   proxima palavra inteira uma a uma, depois palavras de 32 bases e, se final,
+   tambem o resto. Devolve em n quantos indices sobraram no inicio de cod. */
+static size_t gravaCodigos(SeqCompacta *s, size_t pos, unsigned char *cod, size_t *n, int final)
+{ size_t i=0;
+
+  while ((i<*n)&&((pos&31)!=0))
+    defineBase(s, pos++, cod[i++]);
+  for (; i+32<=*n; i+=32, pos+=32)
+  {
+#ifdef USA_SIMD
+    s->bases[pos>>5]=leituraSimd ? empacota32Sse(cod+i) : empacota32(cod+i);
+#else
+    s->bases[pos>>5]=empacota32(cod+i);
+#endif
+    s->mascara[pos>>6]&=~((uint64_t)0xFFFFFFFF<<(pos&63));
+  }
+  if (final)
+    while (i<*n)
+      defineBase(s, pos++, cod[i++]);
+  memmove(cod, cod+i, *n-i);
+  *n-=i;
+  return pos;
+}
+
+/* codifica as bases de [ini,ini+tam), pulando as quebras de linha, a partir da
+   posicao pos de s. Retorna 0 e aponta o caractere em invalido se algum nao
+   for base. */
+static int codificaTrecho(const char *ini, size_t tam, SeqCompacta *s, size_t pos, const char **invalido)
+{ unsigned char cod[CODIGOS_LEITURA];
+  const char *p=ini, *fim=ini+tam, *quebra;
+  size_t n=0, m, k;
+  int ok;
+
+  while (p<fim)
+  {
+    quebra=memchr(p, '\n', (size_t)(fim-p));
+    if (quebra==NULL)
+      quebra=fim;
+    m=(size_t)(quebra-p);
+    if ((m>0)&&(p[m-1]=='\r'))
+      m--;
+    while (m>0)
+    {
+      k=(m<CODIGOS_LEITURA-n) ? m : CODIGOS_LEITURA-n;
+#ifdef USA_SIMD
+      ok=leituraSimd ? traduzBasesSse(p, k, cod+n, invalido) : traduzBases(p, k, cod+n, invalido);
+#else
+      ok=traduzBases(p, k, cod+n, invalido);
+#endif
+      if (!ok)
+        return 0;
+      n+=k;
+      p+=k;
+      m-=k;
+      if (n==CODIGOS_LEITURA)
+        pos=gravaCodigos(s, pos, cod, &n, 0);
+    }
+    p=quebra+1;
+  }
+  gravaCodigos(s, pos, cod, &n, 1);
+  return 1;
+}
+
+/* parte de um trecho grande, contada ou codificada por uma thread */
+typedef struct {
+  const char *ini;
+  size_t tam;
+  SeqCompacta *s;
+  size_t pos;              /* posicao da primeira base da parte em s */
+  size_t bases;            /* bases da parte, na contagem */
+  const char *invalido;    /* primeiro caractere invalido, ou NULL */
+  int conta;               /* 1 = so conta as bases, 0 = codifica */
+} ParteLeitura;
+
+void *parteLeituraThread(void *arg)
+{ ParteLeitura *parte=(ParteLeitura*)arg;
+
+  if (parte->conta)
+  {
+#ifdef USA_SIMD
+    parte->bases=parte->tam-(leituraSimd ? contaQuebrasSse(parte->ini, parte->tam) : contaQuebras(parte->ini, parte->tam));
+#else
+    parte->bases=parte->tam-contaQuebras(parte->ini, parte->tam);
+#endif
+  }
+  else
+  {
+    parte->invalido=NULL;
+    codificaTrecho(parte->ini, parte->tam, parte->s, parte->pos, &parte->invalido);
+  }
+  return NULL;
+}
+
+/* codifica as bases do registro r a partir da posicao inicio de s, que deve
+   ter espaco para elas. Trechos grandes sao divididos entre threads: as bases
+   de cada parte sao contadas em paralelo, o inicio de cada parte avanca ate uma
+   posicao multipla de 64, para que nenhuma palavra de bases ou de mascara seja
+   gravada por duas threads, e as partes sao codificadas em paralelo. Retorna 0
+   se houver caractere invalido. */
+int codificaRegistro(const RegistroSeq *r, SeqCompacta *s, size_t inicio)
+{ pthread_t threads[MAXTHREADS];
+  ParteLeitura partes[MAXTHREADS];
+  const char *invalido=NULL, *p, *fim;
+  size_t pos, inicioParte;
+  long nucleos;
+  int nPartes, k;
+
+  if (leituraSimd<0)
+  {
+#ifdef USA_SIMD
+    leituraSimd=__builtin_cpu_supports("sse4.1") ? 1 : 0;
+#else
+    leituraSimd=0;
+#endif
+  }
+
+  nucleos=sysconf(_SC_NPROCESSORS_ONLN);
+  nPartes=(int)(r->tamTrecho/BYTES_PARTE_LEITURA);
+  if (nPartes>nucleos)
+    nPartes=(int)nucleos;
+  if (nPartes>MAXTHREADS)
+    nPartes=MAXTHREADS;
+
+  if (nPartes>1)
+  {
+    for (k=0; k<nPartes; k++)
+    {
+      partes[k].ini=r->trecho+r->tamTrecho/nPartes*k;
+      partes[k].tam=(k<nPartes-1) ? r->tamTrecho/nPartes : (size_t)(r->trecho+r->tamTrecho-partes[k].ini);
+      partes[k].s=s;
+      partes[k].conta=1;
+      pthread_create(&threads[k], NULL, parteLeituraThread, &partes[k]);
+    }
+    for (k=0; k<nPartes; k++)
+      pthread_join(threads[k], NULL);
+
+    // Inicio de cada parte, a partir da segunda, em uma posicao multipla de 64
+    inicioParte=inicio;
+    for (k=0; k<nPartes; k++)
+    {
+      pos=inicioParte;
+      p=partes[k].ini;
+      fim=partes[k].ini+partes[k].tam;
+      while ((k>0)&&((pos&63)!=0)&&(p<fim))
+      {
+        if ((*p!='\n')&&(*p!='\r'))
+          pos++;
+        p++;
+      }
+      if ((k>0)&&((pos&63)!=0))
+        break; // parte curta demais para alinhar
+      inicioParte+=partes[k].bases;
+      if (k>0)
+      {
+        partes[k-1].tam+=(size_t)(p-partes[k].ini);
+        partes[k].tam-=(size_t)(p-partes[k].ini);
+        partes[k].ini=p;
+      }
+      partes[k].pos=pos;
+      partes[k].conta=0;
+    }
+    if (k<nPartes)
+      nPartes=1;
+  }
+
+  if (nPartes>1)
+  {
+    for (k=0; k<nPartes; k++)
+      pthread_create(&threads[k], NULL, parteLeituraThread, &partes[k]);
+    for (k=0; k<nPartes; k++)
+    {
+      pthread_join(threads[k], NULL);
+      if ((invalido==NULL)&&(partes[k].invalido!=NULL))
+        invalido=partes[k].invalido;
+    }
+  }
+  else
+    codificaTrecho(r->trecho, r->tamTrecho, s, inicio, &invalido);
+
+  if (invalido!=NULL)
+  {
+    printf("Caractere invalido na sequencia %zu do arquivo: %c\n", r->indice, *invalido);
+    return 0;
+  }
+  return 1;
+}
+
+/* leitura de arquivo que contem as sequencias: o primeiro par de registros,
+   com o mais longo como sequencia maior */
+/* define seqMaior e seqMenor a partir de um par de registros lidos. Retorna 0
+   se o par for longo demais ou tiver caracteres invalidos. */
+int defineParLido(const RegistroSeq *maior, const RegistroSeq *menor) {
+    if (maior->numBases + menor->numBases > (size_t)INT_MAX) {
+        printf("Sequencias longas demais: %zu e %zu bases.\n", maior->numBases, menor->numBases);
+        return 0;
+    }
+
+    tamSeqMaior = (int)maior->numBases;
+    alocaSequencia(&seqMaior, tamSeqMaior);
+    tamSeqMenor = (int)menor->numBases;
+    alocaSequencia(&seqMenor, tamSeqMenor);
+    if (!codificaRegistro(maior, &seqMaior, 0) || !codificaRegistro(menor, &seqMenor, 0))
+        return 0;
+
+    // Sequencias lidas nao tem indice de referencia nem trocas conhecidas
+    indRef = -1;
+    nTrocas = -1;
+    return 1;
+}
+
+void leSequenciasDeArquivo(char* fileName) {
+    LeitorSeq leitor;
+    RegistroSeq maior, menor;
+
+    if (!abreLeitor(&leitor, fileName))
+        exit(1);
+    if (proximoPar(&leitor, &maior, &menor) <= 0) {
+        printf("Erro ao ler o par de sequencias do arquivo %s.\n", fileName);
+        fechaLeitor(&leitor);
+        exit(1);
+    }
+    if (!defineParLido(&maior, &menor)) {
+        fechaLeitor(&leitor);
+        exit(1);
+    }
+    if (proximoRegistro(&leitor, &maior) > 0)
+        printf("O arquivo %s tem mais sequencias; apenas o primeiro par foi lido.\n", fileName);
+    fechaLeitor(&leitor);
+}
+
+/* leitura do tamanho da sequencia maior */
+int leTamMaior(void)
+{
+  printf("\nLeitura do Tamanho da Sequencia Maior:");
+  do
+  { printf("\nDigite 0 < valor < %d = ", maxSeq);
+    scanf("%d", &tamSeqMaior);
+  } while ((tamSeqMaior<1)||(tamSeqMaior>maxSeq));
+}
+
+/* leitura do tamanho da sequencia menor */
+int leTamMenor(void)
+{
+  printf("\nLeitura do Tamanho da Sequencia Menor:");
+  do
+  {  printf("\nDigite 0 < valor <= %d = ", tamSeqMaior);
+     scanf("%d", &tamSeqMenor);
+  } while ((tamSeqMenor<1)||(tamSeqMenor>tamSeqMaior));
+}
+
+/* leitura do valor da penalidade de gap */
+int lePenalidade(void)
+{   int penal;
+
+  printf("\nLeitura da Penalidade de Gap:");
+  do
+  {
+    printf("\nDigite valor >= 0 = ");
+    scanf("%d", &penal);
+  } while (penal<0);
+
+  return penal;
+}
+
+/* leitura da matriz de pesos */
+void leMatrizPesos()
+{ int i,j;
+
+  printf("\nLeitura da Matriz de Pesos:\n");
+  for (i=0; i<4; i++)
+  {
+    for (j=0; j<4; j++)
+    {
+      printf("Digite valor %c x %c = ", mapaBases[i], mapaBases[j]);
+      scanf("%d",&(matrizPesos[i][j]));
+    }
+    printf("\n");
+  }
+}
+
+/* mostra da matriz de pesos */
+void mostraMatrizPesos(void)
+{ int i,j;
+
+  printf("\nMatriz de Pesos Atual:");
+  printf("\n%4c%4c%4c%4c%4c\n",' ','A','T','G','C');
+  for (i=0; i<4; i++)
+  {
+    printf("%4c",mapaBases[i]);
+    for (j=0; j<4; j++)
+      printf("%4d",matrizPesos[i][j]);
+    printf("\n");
+  }
+}
+
+
+/* leitura da porcentagem maxima (grau) de mutacao aleatoria. Essa porcentagem eh
+   usada na geracao aleatoria da seqMenor. A seqMenor eh obtida a partir da seqMaior, para se parecer com ela, se diferenciando
+   por um certo grau de alteracoes em suas bases, fornecida pelo usuario. Esse
+   metodo evita a gera��o aleatoria de sequencias totalmente diferentes. A
+   quantidade de trocas realizadas eh no maximo a porcentagem aqui informada. */
+
+int leGrauMutacao(void)
+{ int prob;
+
+  printf("\nLeitura da Porcentagem Maxima de Mutacao Aleatoria:\n");
+  do
+  { printf("\nDigite 0 <= valor <= 100 = ");
+    scanf("%d", &prob);
+  } while ((prob<0)||(prob>100));
+
+  return prob;
+}
+
+/* leitura manual das sequencias de entrada seqMaior e seqMenor */
+void leSequencias(void)
+{ int i, erro;
+  char *seqMaiorAux=NULL, *seqMenorAux=NULL;
+  size_t capMaior, capMenor;
+
+  indRef=-1;
+  nTrocas=-1;
+  printf("\nLeitura das Sequencias:\n");
+
+  /* lendo a sequencia maior */
+  do
+  {
+    printf("\nPara a Sequencia Maior,");
+    printf("\nDigite apenas caracteres 'A', 'T', 'G' e 'C'");
+    do
+    { printf("\n> ");
+      tamSeqMaior=leLinha(stdin,&seqMaiorAux,&capMaior); /* sem o enter */
+    } while (tamSeqMaior<1);
+    printf("\ntamSeqMaior = %d\n",tamSeqMaior);
+    alocaSequencia(&seqMaior,tamSeqMaior);
+    i=0;
+    erro=0;
+    do
+    {
+      switch (seqMaiorAux[i])
+      {
+        case 'A': defineBase(&seqMaior,i,A);
+                  break;
+        case 'T': defineBase(&seqMaior,i,T);
+                  break;
+        case 'G': defineBase(&seqMaior,i,G);
+                  break;
+        case 'C': defineBase(&seqMaior,i,C);
+                  break;
+        default: erro=1;  /* nao eh permitido qquer outro caractere */
+      }
+      i++;
+    } while ((erro==0)&&(i<tamSeqMaior));
+  }while (erro==1);
+
+  /* lendo a sequencia menor */
+  do
+  {
+    printf("\nPara a Sequencia Menor, ");
+    printf("\nDigite apenas caracteres 'A', 'T', 'G' e 'C'");
+    do
+    { printf("\n> ");
+      tamSeqMenor=leLinha(stdin,&seqMenorAux,&capMenor); /* sem o enter */
+    } while ((tamSeqMenor<1)||(tamSeqMenor>tamSeqMaior));
+    printf("\ntamSeqMenor = %d\n",tamSeqMenor);
+    alocaSequencia(&seqMenor,tamSeqMenor);
+
+    i=0;
+    erro=0;
+    do
+    {
+      switch (seqMenorAux[i])
+      {
+        case 'A': defineBase(&seqMenor,i,A);
+                  break;
+        case 'T': defineBase(&seqMenor,i,T);
+                  break;
+        case 'G': defineBase(&seqMenor,i,G);
+                  break;
+        case 'C': defineBase(&seqMenor,i,C);
+                  break;
+        default: erro=1;
+      }
+      i++;
+    } while ((erro==0)&&(i<tamSeqMenor));
+  }while (erro==1);
+
+  free(seqMaiorAux);
+  free(seqMenorAux);
+}
+
+
+/* geracao das sequencias aleatorias, conforme tamanho. Gera-se numeros aleatorios
+   de 0 a 3 representando as bases 'A', 'T', 'G' e 'C'. Gera-se primeiramente a
+   maior sequencia e desta extrai a menor sequencia. A menor sequencia eh obtida
+   da maior por meio de algumas trocas de bases (mutacoes), de acordo com o grau
+   de mutacao informado. A ideia eh gerar sequencias parecidas, mas com certo grau
+   de diferenca. */
+
+void geraSequencias(void)
+{   int i, dif, probAux;
+    char base;
+
+    printf("\nGeracao Aleatoria das Sequencias:\n");
+
+    alocaSequencia(&seqMaior,tamSeqMaior);
+    alocaSequencia(&seqMenor,tamSeqMenor);
+
+    /* gerando a sequencia maior */
+    for (i=0; i<tamSeqMaior; i++)
+      {
+        base=rand()%4; /* produz valores de 0 a 3 */
+        defineBase(&seqMaior,i,base);
+      }
+
+    dif=tamSeqMaior-tamSeqMenor; /* diferenca entre os tamanhos das sequencias */
+
+    indRef=0;
+    if (dif>0)
+      indRef=rand()%dif; /* produz um indice aleatorio para indexar a sequencia maior,
+                         para a partir dele extrair a primeira versao da sequencia
+                         menor */
+
+    /* gerando a sequencia menor a partir da maior. Copia trecho da sequencia
+       maior, a partir de um indice aleatorio que nao ultrapasse os limites do
+       vetor maior */
+    for (i=0; i<tamSeqMenor; i++)
+        defineBase(&seqMenor,i,baseEm(&seqMaior,indRef+i));
+
+    /* causa mutacoes aleatorias na sequencia menor para gerar "gaps",
+       sobre cada base, de acordo com o grau (porcentagem) informado.
+       A mutacao causa a troca da base original por outra base aleatoria
+       necessariamente diferente. Gera-se uma probabilidade aleatoria
+       ateh 100 e se ela estiver dentro do grau informado, a mutacao
+       ocorre na base, caso contrario, mantem a base copiada. */
+
+    i=0;
+    nTrocas=0;
+    while ((i<tamSeqMenor)&&(nTrocas<((grauMuta*tamSeqMenor)/100)))
+    {
+      probAux=rand()%100+1;
+
+      if (probAux<=grauMuta)
+      {
+        defineBase(&seqMenor,i,(baseEm(&seqMenor,i)+(rand()%3)+1)%4);
+        nTrocas++;
+      }
+      i++;
+    }
+
+    printf("\nSequencias Geradas: Dif = %d, IndRef = %d, NTrocas = %d\n ",dif, indRef, nTrocas);
+}
+
+/* mostra das sequencias seqMaior e seqMenor */
+void mostraSequencias(void)
+{   int i;
+
+  printf("\nSequencias Atuais:\n");
+  printf("\nSequencia Maior, Tam = %d\n", tamSeqMaior);
+  for (i=0; i<tamSeqMaior; i++)
+    printf("%c",mapaBases[baseEm(&seqMaior,i)]);
+  printf("\n");
+
+  for (i=0; i<tamSeqMaior; i++)
+    if (i!=indRef)
+      printf(" ");
+    else printf("^");
+  printf("\nIndice de Referencia = %d\n", indRef);
 
   printf("\nSequencia Menor, Tam = %d\n", tamSeqMenor);
   for (i=0; i<tamSeqMenor; i++)
-    printf("%c",mapaBases[seqMenor[i]]);
+    printf("%c",mapaBases[baseEm(&seqMenor,i)]);
+  printf("\n");
+
+  for (i=0; i<tamSeqMenor; i++)
+      if ((indRef>=0)&&(baseEm(&seqMenor,i)!=baseEm(&seqMaior,indRef+i)))
+           printf("^");
+      else printf(" ");
+  printf("\nQuantidade de trocas = %d\n", nTrocas);
+
+}
+
+/* Pool de threads persistente, usado pelo preenchimento, pelo traceback e
+   pela faixa recalculada no modo de linhas de controle. Criar e juntar as
+   threads a cada execucao custa, em lotes de alinhamentos pequenos (opcao
+   -j), mais que o proprio trabalho; as threads do pool sao criadas uma unica
+   vez, cada uma fixada em um dos nucleos permitidos ao processo, e o pool so
+   cresce, sob demanda, ate MAXPOOL. Quem usa o pool submete tarefas (uma
+   funcao e o seu argumento) a um grupo e espera o grupo terminar com
+   aguardaGrupo, em vez de juntar threads.
+
+   Uma tarefa nao deve esperar outra que ainda esteja na fila: as do
+   preenchimento so esperam blocos que uma tarefa em execucao esta calculando,
+   entao funcionam com qualquer numero de threads no pool. */
+
+#define MAXPOOL    (MAXTHREADS+1) // caminhos do traceback e a faixa seguinte
+#define MAXTAREFAS 64             // tarefas na fila, potencia de 2
+
+typedef struct {
+    int pendentes;  // tarefas submetidas e ainda nao concluidas
+} GrupoTarefas;
+
+typedef struct {
+    void *(*funcao)(void *);
+    void *arg;
+    GrupoTarefas *grupo;
+} TarefaPool;
+
+struct {
+    pthread_t threads[MAXPOOL];
+    int nThreads;
+    TarefaPool fila[MAXTAREFAS];   // fila circular, de inicio a fim
+    unsigned inicio, fim;
+    pthread_mutex_t mutex;         // protege a fila e os grupos
+    pthread_cond_t temTarefa;      // tarefa nova na fila
+    pthread_cond_t concluiu;       // um grupo terminou ou a fila tem espaco
+} pool = {.mutex = PTHREAD_MUTEX_INITIALIZER, .temTarefa = PTHREAD_COND_INITIALIZER,
+          .concluiu = PTHREAD_COND_INITIALIZER};
+
+/* fixa a thread atual no i-esimo nucleo permitido ao processo, circularmente */
+void fixaNucleo(int i) {
+    cpu_set_t permitidos, nucleo;
+    int cpu, n;
+
+    if (sched_getaffinity(0, sizeof(permitidos), &permitidos) != 0)
+        return;
+    n = CPU_COUNT(&permitidos);
+    if (n <= 1)
+        return;
+    i %= n;
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        if (CPU_ISSET(cpu, &permitidos) && (i-- == 0))
+            break;
+    CPU_ZERO(&nucleo);
+    CPU_SET(cpu, &nucleo);
+    pthread_setaffinity_np(pthread_self(), sizeof(nucleo), &nucleo);
+}
+
+void* trabalhadorPool(void* arg) {
+    TarefaPool t;
+
+    fixaNucleo((int)(intptr_t)arg);
+    pthread_mutex_lock(&pool.mutex);
+    while (1) {
+        while (pool.inicio == pool.fim)
+            pthread_cond_wait(&pool.temTarefa, &pool.mutex);
+        t = pool.fila[pool.inicio++ % MAXTAREFAS];
+        pthread_cond_broadcast(&pool.concluiu); // abriu espaco na fila
+        pthread_mutex_unlock(&pool.mutex);
+
+        t.funcao(t.arg);
+
+        pthread_mutex_lock(&pool.mutex);
+        if (--t.grupo->pendentes == 0)
+            pthread_cond_broadcast(&pool.concluiu);
+    }
+    return NULL;
+}
+
+/* garante ao menos n threads no pool (no maximo MAXPOOL) */
+void preparaPool(int n) {
+    if (n > MAXPOOL)
+        n = MAXPOOL;
+    pthread_mutex_lock(&pool.mutex);
+    while ((pool.nThreads < n) &&
+           (pthread_create(&pool.threads[pool.nThreads], NULL, trabalhadorPool, (void *)(intptr_t)pool.nThreads) == 0))
+        pool.nThreads++;
+    pthread_mutex_unlock(&pool.mutex);
+}
+
+/* submete funcao(arg) ao pool, no grupo g. Sem nenhuma thread no pool, a
+   tarefa eh executada pela propria thread chamadora. */
+void submeteTarefa(GrupoTarefas *g, void *(*funcao)(void *), void *arg) {
+    pthread_mutex_lock(&pool.mutex);
+    if (pool.nThreads == 0) {
+        pthread_mutex_unlock(&pool.mutex);
+        funcao(arg);
+        return;
+    }
+    while (pool.fim - pool.inicio == MAXTAREFAS)
+        pthread_cond_wait(&pool.concluiu, &pool.mutex);
+    pool.fila[pool.fim % MAXTAREFAS].funcao = funcao;
+    pool.fila[pool.fim % MAXTAREFAS].arg = arg;
+    pool.fila[pool.fim % MAXTAREFAS].grupo = g;
+    pool.fim++;
+    g->pendentes++;
+    pthread_cond_signal(&pool.temTarefa);
+    pthread_mutex_unlock(&pool.mutex);
+}
+
+/* espera todas as tarefas do grupo g terminarem */
+void aguardaGrupo(GrupoTarefas *g) {
+    pthread_mutex_lock(&pool.mutex);
+    while (g->pendentes > 0)
+        pthread_cond_wait(&pool.concluiu, &pool.mutex);
+    pthread_mutex_unlock(&pool.mutex);
+}
+
+/* geraMatrizEscores gera a matriz de escores. A matriz de escores tera
+   tamSeqMenor+1 linhas e tamSeqMaior+1 colunas. A linha 0 e a coluna
+   0 s�o adicionadas para representar gaps e conter penalidades. As
+   demais linhas e colunas sao associadas as bases da seqMenor e da
+   SeqMaior, respectivamente. */
+
+/* A matriz de escores eh dividida em blocos (tiles) de tamBlocoLin linhas por
+   tamBlocoCol colunas, preenchidos em frente de onda (anti-diagonais de blocos).
+   Um bloco [bLin,bCol] so pode ser calculado depois que os blocos de cima
+   [bLin-1,bCol], da esquerda [bLin,bCol-1] e da diagonal [bLin-1,bCol-1] estiverem
+   prontos. Como os blocos de uma linha de blocos terminam da esquerda para a
+   direita, basta contar em feitosLinha quantos blocos de cada linha de blocos ja
+   terminaram; ao terminar um bloco, a thread verifica se os vizinhos da direita
+   e de baixo ficaram liberados e os coloca no seu proprio deque de blocos
+   prontos. Cada thread tira blocos do fim do seu deque (o ultimo liberado, cujas
+   bordas ela acabou de escrever e ainda estao na cache) e, com o seu vazio,
+   rouba do inicio do deque de outra, o bloco liberado ha mais tempo. Assim, no
+   comeco e no fim da frente de onda, quando ha poucos blocos prontos, e nos
+   buracos deixados por blocos mais demorados, uma thread ociosa pega qualquer
+   bloco pronto sem disputar uma fila unica com as demais. Cada linha de blocos
+   tem no maximo um bloco nos deques, e o controle ocupa memoria proporcional ao
+   numero de linhas de blocos, nao ao numero de blocos.
+
+   O formato dos blocos eh escolhido na execucao (opcao -y ou perfil gravado
+   pelo ajuste automatico, mais adiante), ate TAM_BLOCO_LIN_MAX x
+   TAM_BLOCO_COL_MAX, que dimensionam os vetores e os rascunhos por bloco. A
+   largura eh sempre multipla de 64 (COLUNAS_ANCORA, da matriz compacta), o que
+   tambem faz todo bloco comecar em uma coluna par. */
+
+#define TAM_BLOCO_LIN_MAX 256
+#define TAM_BLOCO_COL_MAX 1024
+
+int tamBlocoLin=64,   /* linhas de um bloco */
+    tamBlocoCol=256;  /* colunas de um bloco */
+
+// Primeiro e ultimo maior escore de um conjunto de celulas
+typedef struct {
+    int PMaior, linPMaior, colPMaior;  // primeiro maior escore, na ordem das linhas
+    int UMaior, linUMaior, colUMaior;  // ultimo maior escore, na ordem das linhas
+} MaioresBloco;
+
+// Deque de blocos prontos de uma thread: o dono poe e tira no fim, e as
+// outras threads roubam do inicio
+typedef struct {
+    int *blocos;                  // vetor circular de nBlocosLin+1 posicoes
+    unsigned inicio, fim;         // blocos em inicio..fim-1
+    pthread_mutex_t mutex;        // protege o deque; cada thread so trava um por vez
+} DequeBlocos;
+
+// Estrutura de controle da frente de onda, compartilhada entre as threads
+typedef struct {
+    int nBlocosLin, nBlocosCol;   // quantidade de blocos em cada dimensao
+    int *feitosLinha;             // blocos ja calculados em cada linha de blocos
+    int *liberadosLinha;          // blocos de cada linha de blocos ja colocados em um deque
+    DequeBlocos *deques;          // um deque de blocos prontos por thread
+    int nDeques;
+    int blocosProntos;            // blocos em todos os deques
+    int blocosRestantes;          // blocos ainda nao calculados
+    int dormindo;                 // threads esperando em temBloco
+    pthread_mutex_t mutex;        // protege a espera das threads sem bloco
+    pthread_cond_t temBloco;      // sinaliza bloco novo em um deque ou fim do trabalho
+    void (*processa)(int bLin, int bCol, void *area, MaioresBloco *maiores); // trabalho de cada bloco
+} FrenteOnda;
+
+// Estrutura para passar argumentos para as threads
+typedef struct {
+    int num_threads; // Número total de threads
+    int indice; // deque da thread na frente de onda
+    FrenteOnda* frente; // Frente de onda compartilhada
+    MaioresBloco maiores; // maiores escores dos blocos calculados pela thread
+} ThreadData;
+
+/* maior escore de cada linha do ultimo bloco calculado pela thread, gravado
+   pelo proprio calculo (escalar ou vetorial) enquanto os escores da linha
+   ainda estao nos registradores, e lido por registraBloco */
+__thread int maiorLinhaBloco[TAM_BLOCO_LIN_MAX];
+
+/* calcula todas as celulas de um bloco, linha a linha, na matriz de escores m.
+   As dependencias de cima, da esquerda e da diagonal ja estao prontas quando o
+   bloco eh retirado da fila */
+void calculaBloco(int **m, int bLin, int bCol) {
+    int lin, col, peso, linIni, linFim, colIni, colFim;
+    int escoreDiag, escoreLin, escoreCol, h, maiorLin;
+    unsigned char basesMenor[TAM_BLOCO_LIN_MAX], basesMaior[TAM_BLOCO_COL_MAX];
+
+    linIni = bLin * tamBlocoLin + 1;
+    linFim = (bLin + 1) * tamBlocoLin;
+    if (linFim > tamSeqMenor) linFim = tamSeqMenor;
+    colIni = bCol * tamBlocoCol + 1;
+    colFim = (bCol + 1) * tamBlocoCol;
+    if (colFim > tamSeqMaior) colFim = tamSeqMaior;
+
+    // Bases do bloco desempacotadas, uma por byte
+    desempacotaBases(&seqMenor, linIni - 1, linFim - linIni + 1, basesMenor);
+    desempacotaBases(&seqMaior, colIni - 1, colFim - colIni + 1, basesMaior);
+
+    for (lin = linIni; lin <= linFim; lin++) {
+        maiorLin = INT_MIN;
+        for (col = colIni; col <= colFim; col++) {
+            peso = matrizPesos[basesMenor[lin-linIni]][basesMaior[col-colIni]];
+            escoreDiag = m[lin-1][col-1] + peso;
+            escoreLin = m[lin][col-1] - penalGap;
+            escoreCol = m[lin-1][col] - penalGap;
+
+            if ((escoreDiag > escoreLin) && (escoreDiag > escoreCol)) {
+                h = escoreDiag;
+            } else if (escoreLin > escoreCol) {
+                h = escoreLin;
+            } else {
+                h = escoreCol;
+            }
+            m[lin][col] = h;
+            if (h > maiorLin) maiorLin = h;
+        }
+        maiorLinhaBloco[lin - linIni] = maiorLin;
+    }
+}
+
+/* direcoes de onde pode ter vindo o escore h, dados os escores candidatos da
+   diagonal (ja com o peso), da esquerda e de cima (ja com a penalidade) */
+static inline int codigoDirecao(int h, int diag, int esq, int cima) {
+    return ((diag == h) ? DIR_DIAG : 0) | ((esq == h) ? DIR_ESQ : 0) | ((cima == h) ? DIR_CIMA : 0);
+}
+
+/* Gaps afins (algoritmo de Gotoh): um gap de k posicoes custa penalAbre +
+   k*penalGap. Alem do escore H de cada celula, o preenchimento precisa do
+   melhor escore de um caminho que termina na celula com gap horizontal (esq) e
+   com gap vertical (cima):
+
+     esq[lin][col]  = max(H[lin][col-1] - penalAbre - penalGap, esq[lin][col-1] - penalGap)
+     cima[lin][col] = max(H[lin-1][col] - penalAbre - penalGap, cima[lin-1][col] - penalGap)
+     H[lin][col]    = max(H[lin-1][col-1] + peso, esq[lin][col], cima[lin][col])
+
+   Em vez de duas matrizes extras, esq e cima so existem em memoria rolante:
+   dentro de um bloco, esq rola ao longo da linha e cima em um vetor com uma
+   posicao por coluna do bloco. Entre blocos, bordaGapEsq guarda, para cada
+   linha, o esq da ultima coluna do bloco da esquerda, e bordaGapCima, para cada
+   coluna, o cima da ultima linha do bloco de cima, do mesmo modo que as bordas
+   de escores dos modos sem matriz. As bordas de gap sao lidas e atualizadas
+   pelo proprio calculo do bloco, que, havendo matriz de direcoes, tambem grava
+   o byte de direcoes de cada celula, com os bits de extensao dos gaps. */
+
+#define NEG_AFIM (INT_MIN/4) // escore de gap inexistente (linha 0 e coluna 0)
+
+int *bordaGapEsq = NULL,   // tamSeqMenor+1 escores de gap horizontal
+    *bordaGapCima = NULL;  // tamSeqMaior+1 escores de gap vertical
+
+/* calcula o bloco [bLin,bCol] com gaps afins, no laco escalar */
+void calculaBlocoAfim(int **m, int bLin, int bCol) {
+    int lin, col, linIni, linFim, colIni, colFim, h, esq, esqAnt, cima, cimaEstende, diag, bits, maiorLin;
+    int abre = penalAbre + penalGap, *pesos;
+    int gapCima[TAM_BLOCO_COL_MAX];
+    unsigned char basesMaior[TAM_BLOCO_COL_MAX], codigos[TAM_BLOCO_COL_MAX];
+
+    linIni = bLin * tamBlocoLin + 1;
+    linFim = (bLin + 1) * tamBlocoLin;
+    if (linFim > tamSeqMenor) linFim = tamSeqMenor;
+    colIni = bCol * tamBlocoCol + 1;
+    colFim = (bCol + 1) * tamBlocoCol;
+    if (colFim > tamSeqMaior) colFim = tamSeqMaior;
+
+    desempacotaBases(&seqMaior, colIni - 1, colFim - colIni + 1, basesMaior);
+    memcpy(gapCima, &bordaGapCima[colIni], (size_t)(colFim - colIni + 1) * sizeof(int));
+
+    for (lin = linIni; lin <= linFim; lin++) {
+        pesos = matrizPesos[baseEm(&seqMenor, lin - 1)];
+        esq = bordaGapEsq[lin];
+        maiorLin = INT_MIN;
+        for (col = colIni; col <= colFim; col++) {
+            esqAnt = esq;
+            esq -= penalGap;
+            if (m[lin][col-1] - abre > esq) esq = m[lin][col-1] - abre;
+            cimaEstende = gapCima[col-colIni] - penalGap;
+            cima = cimaEstende;
+            if (m[lin-1][col] - abre > cima) cima = m[lin-1][col] - abre;
+            gapCima[col-colIni] = cima;
+            diag = m[lin-1][col-1] + pesos[basesMaior[col-colIni]];
+
+            h = diag;
+            if (esq > h) h = esq;
+            if (cima > h) h = cima;
+            m[lin][col] = h;
+            if (h > maiorLin) maiorLin = h;
+
+            bits = codigoDirecao(h, diag, esq, cima);
+            bits |= (esq == esqAnt - penalGap) ? DIR_ESQ_ESTENDE : 0;
+            bits |= (cima == cimaEstende) ? DIR_CIMA_ESTENDE : 0;
+            bits |= (esq == m[lin][col-1] - abre) ? DIR_ESQ_ABRE : 0;
+            bits |= (cima == m[lin-1][col] - abre) ? DIR_CIMA_ABRE : 0;
+            codigos[col-colIni] = bits;
+        }
+        bordaGapEsq[lin] = esq;
+        maiorLinhaBloco[lin - linIni] = maiorLin;
+        if (matrizDirecoes != NULL)
+            memcpy(matrizDirecoes + (size_t)(lin - 1) * passoDirecoes + (colIni - 1), codigos, (size_t)(colFim - colIni + 1));
+    }
+    memcpy(&bordaGapCima[colIni], gapCima, (size_t)(colFim - colIni + 1) * sizeof(int));
+}
+
+/* Kernel vetorial (SIMD) de preenchimento dos blocos, no estilo "striped" de
+   Farrar (2007). As colunas do bloco sao distribuidas entre as lanes de forma
+   intercalada: com nLanes lanes e seg = ceil(largura/nLanes) vetores por linha,
+   a coluna p do bloco fica na lane p/seg do vetor p%seg. Assim, os vetores de
+   uma linha dependem apenas da linha anterior (diagonal e de cima), e a
+   dependencia da esquerda (gap horizontal) eh propagada dentro de cada lane no
+   primeiro passo e corrigida entre lanes por um laco "preguicoso" (lazy-F), que
+   quase sempre termina apos poucas iteracoes.
+
+   Os escores do bloco sao guardados relativos ao canto [r0-1,c0-1] do bloco.
+   Como celulas vizinhas diferem de no maximo penalGap+max(peso,0), o maior
+   desvio dentro do bloco eh limitado pelas dimensoes do bloco, e a largura das
+   lanes (8, 16 ou 32 bits) eh a menor que comporta esse limite, com aritmetica
+   saturada em 8 e 16 bits. O conjunto de instrucoes (SSE4.1, AVX2 ou AVX-512)
+   eh escolhido em tempo de execucao, conforme a CPU. Os perfis da seqMaior
+   (peso de cada base da seqMenor contra cada coluna, no layout intercalado)
+   sao montados uma vez por preenchimento, para cada coluna de blocos.
+
+   O maior escore de cada linha (para maiorLinhaBloco) eh acumulado em um vetor
+   no mesmo laco que calcula a linha, antes da correcao entre lanes: a correcao
+   so sobe celulas para o gap da esquerda, que fica abaixo do escore da celula
+   de onde ele veio, e as lanes alem do bloco tambem ficam abaixo de alguma
+   celula do bloco, pelo perfil muito negativo. Basta entao uma reducao entre as
+   lanes por linha. */
+
+enum { KERNEL_ESCALAR, KERNEL_SSE41, KERNEL_AVX2, KERNEL_AVX512, NUM_KERNELS };
+
+const char *nomeKernel[NUM_KERNELS]={"escalar","SSE4.1","AVX2","AVX-512"};
+
+typedef void (*KernelBloco)(int **m, int r0, int r1, int c0, int c1, const void *perfil, void *area);
+
+int kernelForcado=-1;        /* kernel escolhido na linha de comando, -1 = automatico */
+KernelBloco kernelAtual=NULL; /* kernel do preenchimento atual, NULL = escalar */
+int larguraLane=32,          /* bits por lane do kernel atual */
+    bytesVetor=16;           /* bytes por vetor do kernel atual */
+char *perfilSimd=NULL;       /* perfis de todas as colunas de blocos */
+size_t passoPerfil=0;        /* bytes entre os perfis de duas colunas de blocos */
+
+#define BYTES_AREA_SIMD (5*(TAM_BLOCO_COL_MAX*4+64)+64) // rascunho por thread
+
+#ifdef USA_SIMD
+
+/* deslocamento de uma lane para cima, inserindo x na lane 0 */
+#define SSE_DESLOCA(v,x,SET1,E)    _mm_alignr_epi8((v), SET1(x), 16-(E))
+#define AVX2_DESLOCA(v,x,SET1,E)   _mm256_alignr_epi8((v), _mm256_permute2x128_si256((v), SET1(x), 0x02), 16-(E))
+#define AVX512_DESLOCA(v,x,SET1,E) _mm512_alignr_epi8((v), _mm512_alignr_epi64((v), SET1(x), 6), 16-(E))
+
+#define SSE_DESLOCA8(v,x)     SSE_DESLOCA(v,x,_mm_set1_epi8,1)
+#define SSE_DESLOCA16(v,x)    SSE_DESLOCA(v,x,_mm_set1_epi16,2)
+#define SSE_DESLOCA32(v,x)    SSE_DESLOCA(v,x,_mm_set1_epi32,4)
+#define AVX2_DESLOCA8(v,x)    AVX2_DESLOCA(v,x,_mm256_set1_epi8,1)
+#define AVX2_DESLOCA16(v,x)   AVX2_DESLOCA(v,x,_mm256_set1_epi16,2)
+#define AVX2_DESLOCA32(v,x)   AVX2_DESLOCA(v,x,_mm256_set1_epi32,4)
+#define AVX512_DESLOCA8(v,x)  AVX512_DESLOCA(v,x,_mm512_set1_epi8,1)
+#define AVX512_DESLOCA16(v,x) AVX512_DESLOCA(v,x,_mm512_set1_epi16,2)
+#define AVX512_DESLOCA32(v,x) AVX512_DESLOCA(v,x,_mm512_set1_epi32,4)
+
+/* verdadeiro se alguma lane de a for maior que a de b */
+#define SSE_MAIOR8(a,b)     _mm_movemask_epi8(_mm_cmpgt_epi8((a),(b)))
+#define SSE_MAIOR16(a,b)    _mm_movemask_epi8(_mm_cmpgt_epi16((a),(b)))
+#define SSE_MAIOR32(a,b)    _mm_movemask_epi8(_mm_cmpgt_epi32((a),(b)))
+#define AVX2_MAIOR8(a,b)    _mm256_movemask_epi8(_mm256_cmpgt_epi8((a),(b)))
+#define AVX2_MAIOR16(a,b)   _mm256_movemask_epi8(_mm256_cmpgt_epi16((a),(b)))
+#define AVX2_MAIOR32(a,b)   _mm256_movemask_epi8(_mm256_cmpgt_epi32((a),(b)))
+#define AVX512_MAIOR8(a,b)  _mm512_cmpgt_epi8_mask((a),(b))
+#define AVX512_MAIOR16(a,b) _mm512_cmpgt_epi16_mask((a),(b))
+#define AVX512_MAIOR32(a,b) _mm512_cmpgt_epi32_mask((a),(b))
+
+/* preenche as linhas r0..r1, colunas c0..c1, da matriz de escores m (matrizEscores
+   ou o rascunho de um bloco, no modo de direcoes). A linha r0-1 e a coluna c0-1
+   ja estao calculadas. perfil aponta para os 4 x seg vetores de
+   pesos da coluna de blocos e area para o rascunho da thread. */
+#define DEFINE_KERNEL_BLOCO(NOME, ALVO, VT, TIPO, NEG, SET1, ADDS, SUBS, MAX, ALGUM_MAIOR, DESLOCA) \
+__attribute__((target(ALVO))) \
+static void NOME(int **m, int r0, int r1, int c0, int c1, const void *perfil, void *area) \
+{ \
+  const int nLanes=(int)(sizeof(VT)/sizeof(TIPO)); \
+  int w=c1-c0+1, seg=(w+nLanes-1)/nLanes; \
+  int lin, k, l, p, v, vies=m[r0-1][c0-1]; \
+  VT *hAnt=(VT*)area, *hNovo=hAnt+seg, *aux; \
+  VT vGap=SET1(penalGap), vDiag, vH, vF, vMaior; \
+  const VT *vPerfil; \
+  TIPO *t, reducao[64]; \
+  int *linha; \
+\
+  t=(TIPO*)hAnt; \
+  for (l=0; l<nLanes; l++) \
+    for (k=0; k<seg; k++) \
+    { \
+      p=l*seg+k; \
+      t[k*nLanes+l]=(p<w) ? (TIPO)(m[r0-1][c0+p]-vies) : (TIPO)(NEG); \
+    } \
+\
+  for (lin=r0; lin<=r1; lin++) \
+  { \
+    vPerfil=(const VT*)perfil+baseEm(&seqMenor, lin-1)*seg; \
+    vDiag=DESLOCA(hAnt[seg-1], m[lin-1][c0-1]-vies); \
+    vF=DESLOCA(SET1(NEG), m[lin][c0-1]-vies-penalGap); \
+    vMaior=SET1(NEG); \
+    for (k=0; k<seg; k++) \
+    { \
+      vH=ADDS(vDiag, vPerfil[k]); \
+      vH=MAX(vH, SUBS(hAnt[k], vGap)); \
+      vH=MAX(vH, vF); \
+      hNovo[k]=vH; \
+      vMaior=MAX(vMaior, vH); \
+      vF=SUBS(vH, vGap); \
+      vDiag=hAnt[k]; \
+    } \
+    memcpy(reducao, &vMaior, sizeof(VT)); \
+    v=reducao[0]; \
+    for (l=1; l<nLanes; l++) \
+      if (reducao[l]>v) v=reducao[l]; \
+    maiorLinhaBloco[lin-r0]=v+vies; \
+\
+    /* correcao do gap horizontal que atravessa de uma lane para a seguinte */ \
+    vF=DESLOCA(vF, NEG); \
+    k=0; \
+    while (ALGUM_MAIOR(vF, hNovo[k])) \
+    { \
+      hNovo[k]=MAX(hNovo[k], vF); \
+      vF=SUBS(hNovo[k], vGap); \
+      if (++k==seg) \
+      { \
+        k=0; \
+        vF=DESLOCA(vF, NEG); \
+      } \
+    } \
+\
+    t=(TIPO*)hNovo; \
+    linha=m[lin]+c0; \
+    for (l=0; l<nLanes; l++) \
+      for (k=0, p=l*seg; (k<seg)&&(p<w); k++, p++) \
+        linha[p]=t[k*nLanes+l]+vies; \
+\
+    aux=hAnt; \
+    hAnt=hNovo; \
+    hNovo=aux; \
+  } \
+}
+
+DEFINE_KERNEL_BLOCO(blocoSse8, "sse4.1", __m128i, int8_t, INT8_MIN, _mm_set1_epi8, _mm_adds_epi8, _mm_subs_epi8, _mm_max_epi8, SSE_MAIOR8, SSE_DESLOCA8)
+DEFINE_KERNEL_BLOCO(blocoSse16, "sse4.1", __m128i, int16_t, INT16_MIN, _mm_set1_epi16, _mm_adds_epi16, _mm_subs_epi16, _mm_max_epi16, SSE_MAIOR16, SSE_DESLOCA16)
+DEFINE_KERNEL_BLOCO(blocoSse32, "sse4.1", __m128i, int32_t, INT32_MIN/4, _mm_set1_epi32, _mm_add_epi32, _mm_sub_epi32, _mm_max_epi32, SSE_MAIOR32, SSE_DESLOCA32)
+DEFINE_KERNEL_BLOCO(blocoAvx2_8, "avx2", __m256i, int8_t, INT8_MIN, _mm256_set1_epi8, _mm256_adds_epi8, _mm256_subs_epi8, _mm256_max_epi8, AVX2_MAIOR8, AVX2_DESLOCA8)
+DEFINE_KERNEL_BLOCO(blocoAvx2_16, "avx2", __m256i, int16_t, INT16_MIN, _mm256_set1_epi16, _mm256_adds_epi16, _mm256_subs_epi16, _mm256_max_epi16, AVX2_MAIOR16, AVX2_DESLOCA16)
+DEFINE_KERNEL_BLOCO(blocoAvx2_32, "avx2", __m256i, int32_t, INT32_MIN/4, _mm256_set1_epi32, _mm256_add_epi32, _mm256_sub_epi32, _mm256_max_epi32, AVX2_MAIOR32, AVX2_DESLOCA32)
+DEFINE_KERNEL_BLOCO(blocoAvx512_8, "avx512f,avx512bw", __m512i, int8_t, INT8_MIN, _mm512_set1_epi8, _mm512_adds_epi8, _mm512_subs_epi8, _mm512_max_epi8, AVX512_MAIOR8, AVX512_DESLOCA8)
+DEFINE_KERNEL_BLOCO(blocoAvx512_16, "avx512f,avx512bw", __m512i, int16_t, INT16_MIN, _mm512_set1_epi16, _mm512_adds_epi16, _mm512_subs_epi16, _mm512_max_epi16, AVX512_MAIOR16, AVX512_DESLOCA16)
+DEFINE_KERNEL_BLOCO(blocoAvx512_32, "avx512f,avx512bw", __m512i, int32_t, INT32_MIN/4, _mm512_set1_epi32, _mm512_add_epi32, _mm512_sub_epi32, _mm512_max_epi32, AVX512_MAIOR32, AVX512_DESLOCA32)
+
+/* lanes iguais de a e b recebem as lanes de x, as demais ficam com zero */
+#define SSE_IGUAL8(a,b,x)     _mm_and_si128(_mm_cmpeq_epi8((a),(b)), (x))
+#define SSE_IGUAL16(a,b,x)    _mm_and_si128(_mm_cmpeq_epi16((a),(b)), (x))
+#define SSE_IGUAL32(a,b,x)    _mm_and_si128(_mm_cmpeq_epi32((a),(b)), (x))
+#define AVX2_IGUAL8(a,b,x)    _mm256_and_si256(_mm256_cmpeq_epi8((a),(b)), (x))
+#define AVX2_IGUAL16(a,b,x)   _mm256_and_si256(_mm256_cmpeq_epi16((a),(b)), (x))
+#define AVX2_IGUAL32(a,b,x)   _mm256_and_si256(_mm256_cmpeq_epi32((a),(b)), (x))
+#define AVX512_IGUAL8(a,b,x)  _mm512_maskz_mov_epi8(_mm512_cmpeq_epi8_mask((a),(b)), (x))
+#define AVX512_IGUAL16(a,b,x) _mm512_maskz_mov_epi16(_mm512_cmpeq_epi16_mask((a),(b)), (x))
+#define AVX512_IGUAL32(a,b,x) _mm512_maskz_mov_epi32(_mm512_cmpeq_epi32_mask((a),(b)), (x))
+
+/* kernel com gaps afins, no mesmo layout intercalado. O gap vertical (cima)
+   depende so da linha anterior e rola em um terceiro vetor do rascunho; o
+   horizontal (esq) eh propagado como o gap do kernel linear, com abertura
+   penalAbre+penalGap e extensao penalGap, e a correcao entre lanes continua
+   enquanto algum gap que atravessa a lane puder superar o aberto ali, como no
+   kernel de Farrar. As bordas de gap de entrada vem de bordaGapEsq e
+   bordaGapCima, relativas ao canto como os escores.
+
+   Havendo matriz de direcoes, um segundo passo intercalado, com a sua propria
+   correcao entre lanes, calcula o esq exato de cada celula a partir de H final,
+   e os bits da celula (igualdades de H com a diagonal, esq e cima e os bits de
+   extensao e de abertura dos gaps) sao montados em um vetor por segmento e
+   gravados, ja fora do layout intercalado, um byte por celula. No modo so
+   escore basta o esq da ultima coluna c1, para o bloco da direita: o maior
+   entre o gap que entrou no bloco, estendido ate c1, e max(H[col] +
+   (col-c0)*penalGap) para col < c1, descontadas a abertura e a extensao ate
+   c1, calculado sem dependencia entre as colunas, com um vetor de
+   deslocamentos por posicao e uma reducao entre as lanes. */
+#define DEFINE_KERNEL_AFIM(NOME, ALVO, VT, TIPO, NEG, SET1, ADDS, SUBS, MAX, ALGUM_MAIOR, DESLOCA, IGUAL, OU) \
+__attribute__((target(ALVO))) \
+static void NOME(int **m, int r0, int r1, int c0, int c1, const void *perfil, void *area) \
+{ \
+  const int nLanes=(int)(sizeof(VT)/sizeof(TIPO)); \
+  int w=c1-c0+1, seg=(w+nLanes-1)/nLanes; \
+  int lin, k, l, p, v, maior, esqFim, vies=m[r0-1][c0-1]; \
+  VT *hAnt=(VT*)area, *hNovo=hAnt+seg, *vCima=hNovo+seg, *vEsq=vCima+seg, *vBits=vEsq+seg, *aux; \
+  VT vGap=SET1(penalGap), vAbre=SET1(penalAbre+penalGap), vDiag, vH, vE, vF, vMaior, vAnt; \
+  const VT *vPerfil; \
+  TIPO *t, *tc, reducao[64]; \
+  int *linha; \
+  unsigned char codigos[TAM_BLOCO_COL_MAX], *dir=NULL; \
+\
+  if (matrizDirecoes!=NULL) \
+    dir=matrizDirecoes+(size_t)(r0-1)*passoDirecoes+(c0-1); \
+  t=(TIPO*)hAnt; \
+  tc=(TIPO*)vCima; \
+  for (l=0; l<nLanes; l++) \
+    for (k=0; k<seg; k++) \
+    { \
+      p=l*seg+k; \
+      t[k*nLanes+l]=(p<w) ? (TIPO)(m[r0-1][c0+p]-vies) : (TIPO)(NEG); \
+      v=(p<w) ? bordaGapCima[c0+p]-vies : (NEG); \
+      tc[k*nLanes+l]=(TIPO)((v<(NEG)) ? (NEG) : v); \
+      if (!dir) /* sem direcoes, vBits guarda os deslocamentos da reducao */ \
+        ((TIPO*)vBits)[k*nLanes+l]=(p<w-1) ? (TIPO)(p*penalGap) : (TIPO)(NEG); \
+    } \
+\
+  for (lin=r0; lin<=r1; lin++) \
+  { \
+    vPerfil=(const VT*)perfil+baseEm(&seqMenor, lin-1)*seg; \
+    vDiag=DESLOCA(hAnt[seg-1], m[lin-1][c0-1]-vies); \
+    v=bordaGapEsq[lin]-penalGap; \
+    if (m[lin][c0-1]-penalAbre-penalGap>v) v=m[lin][c0-1]-penalAbre-penalGap; \
+    v-=vies; \
+    esqFim=v-(w-1)*penalGap; \
+    if (v<(NEG)) v=(NEG); \
+    vF=DESLOCA(SET1(NEG), v); \
+    vMaior=SET1(NEG); \
+    for (k=0; k<seg; k++) \
+    { \
+      vE=SUBS(vCima[k], vGap); \
+      vH=SUBS(hAnt[k], vAbre); \
+      if (dir) \
+        vBits[k]=OU(IGUAL(vE, MAX(vE, vH), SET1(DIR_CIMA_ESTENDE)), \
+                    IGUAL(vH, MAX(vE, vH), SET1(DIR_CIMA_ABRE))); \
+      vE=MAX(vE, vH); \
+      vCima[k]=vE; \
+      vH=ADDS(vDiag, vPerfil[k]); \
+      vH=MAX(vH, vE); \
+      vH=MAX(vH, vF); \
+      hNovo[k]=vH; \
+      vMaior=MAX(vMaior, vH); \
+      vF=MAX(SUBS(vH, vAbre), SUBS(vF, vGap)); \
+      vDiag=hAnt[k]; \
+    } \
+    memcpy(reducao, &vMaior, sizeof(VT)); \
+    maior=reducao[0]; \
+    for (l=1; l<nLanes; l++) \
+      if (reducao[l]>maior) maior=reducao[l]; \
+    maiorLinhaBloco[lin-r0]=maior+vies; \
+\
+    /* correcao do gap horizontal que atravessa de uma lane para a seguinte */ \
+    vF=DESLOCA(vF, NEG); \
+    k=0; \
+    while (ALGUM_MAIOR(vF, SUBS(hNovo[k], vAbre))) \
+    { \
+      hNovo[k]=MAX(hNovo[k], vF); \
+      vF=SUBS(vF, vGap); \
+      if (++k==seg) \
+      { \
+        k=0; \
+        vF=DESLOCA(vF, NEG); \
+      } \
+    } \
+\
+    t=(TIPO*)hNovo; \
+    linha=m[lin]+c0; \
+    for (l=0; l<nLanes; l++) \
+      for (k=0, p=l*seg; (k<seg)&&(p<w); k++, p++) \
+        linha[p]=t[k*nLanes+l]+vies; \
+\
+    /* gap horizontal na coluna c1, para o bloco da direita */ \
+    if (!dir) \
+    { \
+      if (w>1) \
+      { \
+        vH=ADDS(hNovo[0], vBits[0]); \
+        for (k=1; k<seg; k++) \
+          vH=MAX(vH, ADDS(hNovo[k], vBits[k])); \
+        memcpy(reducao, &vH, sizeof(VT)); \
+        for (l=0; l<nLanes; l++) \
+        { \
+          p=reducao[l]-penalAbre-(w-1)*penalGap; \
+          if (p>esqFim) esqFim=p; \
+        } \
+      } \
+      bordaGapEsq[lin]=esqFim+vies; \
+      aux=hAnt; \
+      hAnt=hNovo; \
+      hNovo=aux; \
+      continue; \
+    } \
+\
+    /* esq exato: a coluna 0 de cada lane parte da ultima coluna da lane \
+       anterior, e o gap que atravessa as lanes eh corrigido como acima */ \
+    vF=MAX(SUBS(DESLOCA(hNovo[seg-1], NEG), vAbre), DESLOCA(SET1(NEG), v)); \
+    vEsq[0]=vF; \
+    for (k=1; k<seg; k++) \
+    { \
+      vF=MAX(SUBS(hNovo[k-1], vAbre), SUBS(vF, vGap)); \
+      vEsq[k]=vF; \
+    } \
+    vF=DESLOCA(SUBS(vF, vGap), NEG); \
+    k=0; \
+    while (ALGUM_MAIOR(vF, vEsq[k])) \
+    { \
+      vEsq[k]=MAX(vEsq[k], vF); \
+      vF=SUBS(vF, vGap); \
+      if (++k==seg) \
+      { \
+        k=0; \
+        vF=DESLOCA(vF, NEG); \
+      } \
+    } \
+\
+    v=bordaGapEsq[lin]-vies; \
+    vF=DESLOCA(vEsq[seg-1], (v<(NEG)) ? (NEG) : v); \
+    vDiag=DESLOCA(hAnt[seg-1], m[lin-1][c0-1]-vies); \
+    vAnt=DESLOCA(hNovo[seg-1], m[lin][c0-1]-vies); \
+    for (k=0; k<seg; k++) \
+    { \
+      vH=hNovo[k]; \
+      vE=OU(vBits[k], IGUAL(vH, ADDS(vDiag, vPerfil[k]), SET1(DIR_DIAG))); \
+      vE=OU(vE, IGUAL(vH, vEsq[k], SET1(DIR_ESQ))); \
+      vE=OU(vE, IGUAL(vH, vCima[k], SET1(DIR_CIMA))); \
+      vE=OU(vE, IGUAL(vEsq[k], SUBS(vF, vGap), SET1(DIR_ESQ_ESTENDE))); \
+      vE=OU(vE, IGUAL(vEsq[k], SUBS(vAnt, vAbre), SET1(DIR_ESQ_ABRE))); \
+      vBits[k]=vE; \
+      vF=vEsq[k]; \
+      vDiag=hAnt[k]; \
+      vAnt=hNovo[k]; \
+    } \
+    t=(TIPO*)vBits; \
+    for (l=0; l<nLanes; l++) \
+      for (k=0, p=l*seg; (k<seg)&&(p<w); k++, p++) \
+        codigos[p]=(unsigned char)t[k*nLanes+l]; \
+    memcpy(dir, codigos, (size_t)w); \
+    dir+=passoDirecoes; \
+\
+    t=(TIPO*)vEsq; \
+    bordaGapEsq[lin]=t[((w-1)%seg)*nLanes+(w-1)/seg]+vies; \
+\
+    aux=hAnt; \
+    hAnt=hNovo; \
+    hNovo=aux; \
+  } \
+\
+  /* gap vertical na ultima linha, para o bloco de baixo */ \
+  for (l=0; l<nLanes; l++) \
+    for (k=0, p=l*seg; (k<seg)&&(p<w); k++, p++) \
+      bordaGapCima[c0+p]=tc[k*nLanes+l]+vies; \
+}
+
+DEFINE_KERNEL_AFIM(afimSse8, "sse4.1", __m128i, int8_t, INT8_MIN, _mm_set1_epi8, _mm_adds_epi8, _mm_subs_epi8, _mm_max_epi8, SSE_MAIOR8, SSE_DESLOCA8, SSE_IGUAL8, _mm_or_si128)
+DEFINE_KERNEL_AFIM(afimSse16, "sse4.1", __m128i, int16_t, INT16_MIN, _mm_set1_epi16, _mm_adds_epi16, _mm_subs_epi16, _mm_max_epi16, SSE_MAIOR16, SSE_DESLOCA16, SSE_IGUAL16, _mm_or_si128)
+DEFINE_KERNEL_AFIM(afimSse32, "sse4.1", __m128i, int32_t, INT32_MIN/4, _mm_set1_epi32, _mm_add_epi32, _mm_sub_epi32, _mm_max_epi32, SSE_MAIOR32, SSE_DESLOCA32, SSE_IGUAL32, _mm_or_si128)
+DEFINE_KERNEL_AFIM(afimAvx2_8, "avx2", __m256i, int8_t, INT8_MIN, _mm256_set1_epi8, _mm256_adds_epi8, _mm256_subs_epi8, _mm256_max_epi8, AVX2_MAIOR8, AVX2_DESLOCA8, AVX2_IGUAL8, _mm256_or_si256)
+DEFINE_KERNEL_AFIM(afimAvx2_16, "avx2", __m256i, int16_t, INT16_MIN, _mm256_set1_epi16, _mm256_adds_epi16, _mm256_subs_epi16, _mm256_max_epi16, AVX2_MAIOR16, AVX2_DESLOCA16, AVX2_IGUAL16, _mm256_or_si256)
+DEFINE_KERNEL_AFIM(afimAvx2_32, "avx2", __m256i, int32_t, INT32_MIN/4, _mm256_set1_epi32, _mm256_add_epi32, _mm256_sub_epi32, _mm256_max_epi32, AVX2_MAIOR32, AVX2_DESLOCA32, AVX2_IGUAL32, _mm256_or_si256)
+DEFINE_KERNEL_AFIM(afimAvx512_8, "avx512f,avx512bw", __m512i, int8_t, INT8_MIN, _mm512_set1_epi8, _mm512_adds_epi8, _mm512_subs_epi8, _mm512_max_epi8, AVX512_MAIOR8, AVX512_DESLOCA8, AVX512_IGUAL8, _mm512_or_si512)
+DEFINE_KERNEL_AFIM(afimAvx512_16, "avx512f,avx512bw", __m512i, int16_t, INT16_MIN, _mm512_set1_epi16, _mm512_adds_epi16, _mm512_subs_epi16, _mm512_max_epi16, AVX512_MAIOR16, AVX512_DESLOCA16, AVX512_IGUAL16, _mm512_or_si512)
+DEFINE_KERNEL_AFIM(afimAvx512_32, "avx512f,avx512bw", __m512i, int32_t, INT32_MIN/4, _mm512_set1_epi32, _mm512_add_epi32, _mm512_sub_epi32, _mm512_max_epi32, AVX512_MAIOR32, AVX512_DESLOCA32, AVX512_IGUAL32, _mm512_or_si512)
+
+/* kernels por conjunto de instrucoes e largura de lane (8, 16 e 32 bits), com
+   gaps lineares e afins */
+KernelBloco kernelsBloco[NUM_KERNELS][3]={
+  {NULL, NULL, NULL},
+  {blocoSse8, blocoSse16, blocoSse32},
+  {blocoAvx2_8, blocoAvx2_16, blocoAvx2_32},
+  {blocoAvx512_8, blocoAvx512_16, blocoAvx512_32}
+};
+KernelBloco kernelsAfim[NUM_KERNELS][3]={
+  {NULL, NULL, NULL},
+  {afimSse8, afimSse16, afimSse32},
+  {afimAvx2_8, afimAvx2_16, afimAvx2_32},
+  {afimAvx512_8, afimAvx512_16, afimAvx512_32}
+};
+
+/* melhor conjunto de instrucoes suportado pela CPU */
+int melhorKernelCpu(void)
+{
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")&&__builtin_cpu_supports("avx512bw"))
+    return KERNEL_AVX512;
+  if (__builtin_cpu_supports("avx2"))
+    return KERNEL_AVX2;
+  if (__builtin_cpu_supports("sse4.1"))
+    return KERNEL_SSE41;
+  return KERNEL_ESCALAR;
+}
+
+#else
+
+KernelBloco kernelsBloco[NUM_KERNELS][3]={{NULL}};
+KernelBloco kernelsAfim[NUM_KERNELS][3]={{NULL}};
+
+int melhorKernelCpu(void)
+{
+  return KERNEL_ESCALAR;
+}
+
+#endif
+
+/* monta, para a coluna de blocos c0..c1, os 4 x seg vetores de perfil no layout
+   intercalado: lane l do vetor k da base b recebe o peso de b contra a coluna
+   c0+l*seg+k, ou um valor muito negativo nas posicoes alem do bloco */
+void montaPerfilBloco(int c0, int c1, char *dest)
+{ int nLanes=bytesVetor*8/larguraLane, w=c1-c0+1, seg=(w+nLanes-1)/nLanes;
+  int b, k, l, p, peso, limite, i;
+  unsigned char bases[TAM_BLOCO_COL_MAX];
+
+  desempacotaBases(&seqMaior, c0-1, w, bases);
+  limite=(larguraLane==8) ? INT8_MAX : (larguraLane==16) ? INT16_MAX : (1<<28);
+  for (b=0; b<4; b++)
+    for (l=0; l<nLanes; l++)
+      for (k=0; k<seg; k++)
+      {
+        p=l*seg+k;
+        peso=(p<w) ? matrizPesos[b][bases[p]] : -limite-1;
+        if (peso<-limite-1) peso=-limite-1;
+        if (peso>limite) peso=limite;
+        i=(b*seg+k)*nLanes+l;
+        if (larguraLane==8)
+          ((int8_t*)dest)[i]=(int8_t)peso;
+        else if (larguraLane==16)
+          ((int16_t*)dest)[i]=(int16_t)peso;
+        else
+          ((int32_t*)dest)[i]=peso;
+      }
+}
+
+/* conjunto de instrucoes do preenchimento: o da opcao -k, se a CPU o suporta,
+   ou o mais largo que ela suporta */
+int kernelDoPreenchimento(void)
+{ int isa=(kernelForcado>=0) ? kernelForcado : melhorKernelCpu();
+
+  return (isa>melhorKernelCpu()) ? melhorKernelCpu() : isa;
+}
+
+/* escolhe o kernel do preenchimento: o conjunto de instrucoes mais largo que a
+   CPU suporta e a menor largura de lane que comporta os escores de um bloco, e
+   monta os perfis de todas as colunas de blocos. Com mostra=0 (no ajuste dos
+   blocos), a escolha nao eh informada. */
+void preparaKernelSimd(int nBlocosCol, int mostra)
+{ int isa, pesoMax=0, delta, limite, i, j, bCol, nLanes, seg, c1;
+
+  isa=kernelDoPreenchimento();
+  kernelAtual=NULL;
+  if (isa==KERNEL_ESCALAR)
+  {
+    if (mostra)
+      printf("\nKernel de preenchimento: escalar");
+    return;
+  }
+
+  /* celulas vizinhas diferem de no maximo delta, entao um bloco se afasta do
+     seu canto no maximo (altura+largura)*delta */
+  for (i=0; i<4; i++)
+    for (j=0; j<4; j++)
+      if (matrizPesos[i][j]>pesoMax)
+        pesoMax=matrizPesos[i][j];
+  delta=penalAbre+penalGap+pesoMax;
+  limite=(tamBlocoLin+tamBlocoCol+2)*delta;
+  if (2*limite<INT8_MAX)
+    larguraLane=8;
+  else if (2*limite<INT16_MAX)
+    larguraLane=16;
+  else
+    larguraLane=32;
+
+  bytesVetor=(isa==KERNEL_AVX512) ? 64 : (isa==KERNEL_AVX2) ? 32 : 16;
+  kernelAtual=((penalAbre>0) ? kernelsAfim : kernelsBloco)[isa][larguraLane==8 ? 0 : larguraLane==16 ? 1 : 2];
+
+  nLanes=bytesVetor*8/larguraLane;
+  seg=(tamBlocoCol+nLanes-1)/nLanes;
+  passoPerfil=(size_t)4*seg*bytesVetor;
+  free(perfilSimd);
+  perfilSimd=malloc(nBlocosCol*passoPerfil+64);
+  for (bCol=0; bCol<nBlocosCol; bCol++)
+  {
+    c1=(bCol+1)*tamBlocoCol;
+    if (c1>tamSeqMaior) c1=tamSeqMaior;
+    montaPerfilBloco(bCol*tamBlocoCol+1, c1, alinhaPonteiro(perfilSimd)+bCol*passoPerfil);
+  }
+
+  if (mostra)
+    printf("\nKernel de preenchimento: %s, lanes de %d bits", nomeKernel[isa], larguraLane);
+}
+
+/* calcula o bloco [bLin,bCol] da matriz de escores m com o kernel vetorial
+   escolhido para o preenchimento atual ou, sem ele, com o laco escalar */
+void calculaBlocoEm(int **m, int bLin, int bCol, void *area) {
+    int linFim, colFim;
+
+    if (kernelAtual == NULL) {
+        if (penalAbre > 0)
+            calculaBlocoAfim(m, bLin, bCol);
+        else
+            calculaBloco(m, bLin, bCol);
+        return;
+    }
+    linFim = (bLin + 1) * tamBlocoLin;
+    if (linFim > tamSeqMenor) linFim = tamSeqMenor;
+    colFim = (bCol + 1) * tamBlocoCol;
+    if (colFim > tamSeqMaior) colFim = tamSeqMaior;
+    kernelAtual(m, bLin * tamBlocoLin + 1, linFim, bCol * tamBlocoCol + 1, colFim,
+                alinhaPonteiro(perfilSimd) + bCol * passoPerfil, area);
+}
+
+/* Matriz compacta (opcao -z). Celulas vizinhas de uma linha ou de uma coluna
+   diferem pouco: com gaps lineares, a diferenca fica entre -penalGap e o
+   maior peso mais penalGap, e com gaps afins, em no maximo o delta do kernel
+   vetorial para cada lado. As celulas [1..tamSeqMenor,1..tamSeqMaior] sao
+   divididas em blocos de tamBlocoLin linhas por COLUNAS_ANCORA colunas (os
+   blocos de preenchimento tem alguns deles lado a lado), e cada bloco guarda
+   so o escore do seu canto, em 32 bits, e uma diferenca de bitsDelta bits por
+   celula, somada a menorDelta: na primeira coluna, em relacao a celula de
+   cima, e nas demais, a da esquerda. Cada linha de um bloco ocupa bitsDelta
+   palavras de 64 bits, e o escore de uma celula eh o do canto mais as
+   diferencas da primeira coluna ate a sua linha e as da sua linha ate ela,
+   somadas uma palavra por vez. A linha 0 e a coluna 0 nao sao guardadas. Com
+   os pesos e a penalidade padrao, sao 2 bits por celula em vez de 32.
+
+   O preenchimento eh o dos modos sem matriz, e cada bloco calculado eh
+   compactado no rascunho, ainda na cache. O traceback le as celulas direto da
+   matriz compacta, e as exportacoes descompactam uma linha por vez. */
+
+#define COLUNAS_ANCORA 64
+
+/* soma dos campos de bits bits de x */
+static inline int somaCampos(uint64_t x, int bits)
+{
+  switch (bits)
+  {
+  case 2:
+    return __builtin_popcountll(x & 0x5555555555555555ULL) + 2 * __builtin_popcountll(x & 0xAAAAAAAAAAAAAAAAULL);
+  case 4:
+    x = (x & 0x0F0F0F0F0F0F0F0FULL) + ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL);
+    return (int)((x * 0x0101010101010101ULL) >> 56);
+  case 8:
+    x = (x & 0x00FF00FF00FF00FFULL) + ((x >> 8) & 0x00FF00FF00FF00FFULL);
+    return (int)((x * 0x0001000100010001ULL) >> 48);
+  default:
+    x = (x & 0x0000FFFF0000FFFFULL) + ((x >> 16) & 0x0000FFFF0000FFFFULL);
+    return (int)((x & 0xFFFFFFFFULL) + (x >> 32));
+  }
+}
+
+/* linha de diferencas da celula [lin,col] e indice do seu bloco */
+static inline const uint64_t *linhaCompacta(int lin, int col, size_t *bloco)
+{
+  *bloco = (size_t)((lin - 1) / tamBlocoLin) * compacta.blocosCol + (col - 1) / COLUNAS_ANCORA;
+  return compacta.deltas + (*bloco * tamBlocoLin + (lin - 1) % tamBlocoLin) * compacta.bitsDelta;
+}
+
+/* escore da primeira coluna do bloco da celula [lin,col], lin,col >= 1 */
+static inline int escorePrimeiraColuna(int lin, int col)
+{
+  const uint64_t *p;
+  size_t bloco;
+  int r = (lin - 1) % tamBlocoLin, i, soma = 0;
+  uint64_t mascara = (1ULL << compacta.bitsDelta) - 1;
+
+  p = linhaCompacta(lin, col, &bloco) - (size_t)r * compacta.bitsDelta;
+  for (i = 1; i <= r; i++)
+    soma += (int)(p[(size_t)i * compacta.bitsDelta] & mascara);
+  return compacta.ancoras[bloco] + soma + r * compacta.menorDelta;
+}
+
+/* escore da celula [lin,col] da matriz compacta */
+int escoreCompacto(int lin, int col)
+{
+  const uint64_t *p;
+  size_t bloco;
+  int f, palavras, resto, soma = 0, i;
+
+  if ((lin == 0) || (col == 0))
+    return escoreBorda(lin + col);
+  p = linhaCompacta(lin, col, &bloco);
+  f = (col - 1) % COLUNAS_ANCORA;
+
+  // campos 1..f da linha: os f+1 primeiros menos o da primeira coluna
+  palavras = (f + 1) * compacta.bitsDelta / 64;
+  resto = (f + 1) * compacta.bitsDelta % 64;
+  for (i = 0; i < palavras; i++)
+    soma += somaCampos(p[i], compacta.bitsDelta);
+  if (resto > 0)
+    soma += somaCampos(p[palavras] & ((1ULL << resto) - 1), compacta.bitsDelta);
+  soma -= (int)(p[0] & ((1ULL << compacta.bitsDelta) - 1));
+  return escorePrimeiraColuna(lin, col) + soma + f * compacta.menorDelta;
+}
+
+/* descompacta as colunas c0..c1 da linha lin em dest[c0..c1]. c0 eh 0 ou a
+   primeira coluna de um bloco compacto. */
+void descompactaColunas(int lin, int c0, int c1, int *dest)
+{
+  const uint64_t *p;
+  size_t bloco;
+  int col, j, v, bits = compacta.bitsDelta;
+  uint64_t mascara = (1ULL << bits) - 1;
+
+  for (col = c0; (lin == 0) && (col <= c1); col++)
+    dest[col] = escoreBorda(col);
+  if (lin == 0)
+    return;
+  if (c0 == 0)
+    dest[c0++] = escoreBorda(lin);
+  for (; c0 <= c1; c0 += COLUNAS_ANCORA)
+  {
+    p = linhaCompacta(lin, c0, &bloco);
+    v = escorePrimeiraColuna(lin, c0);
+    dest[c0] = v;
+    for (j = 1; (j < COLUNAS_ANCORA) && (c0 + j <= c1); j++)
+    {
+      v += (int)((p[j * bits / 64] >> (j * bits % 64)) & mascara) + compacta.menorDelta;
+      dest[c0 + j] = v;
+    }
+  }
+}
+
+/* descompacta a linha lin, colunas 0..tamSeqMaior, em dest */
+void descompactaLinha(int lin, int *dest)
+{
+  descompactaColunas(lin, 0, tamSeqMaior, dest);
+}
+
+/* linha lin da matriz de escores: a propria linha da matriz ou, na matriz
+   compacta, a linha descompactada em buf, com tamSeqMaior+1 inteiros */
+const int *linhaEscores(int lin, int *buf)
+{
+  if (matrizEscores != NULL)
+    return matrizEscores[lin];
+  descompactaLinha(lin, buf);
+  return buf;
+}
+
+/* empacota as COLUNAS_ANCORA diferencas d em bits palavras de p. Chamada com
+   bits constante, para que o compilador desenrole os lacos. */
+static inline void empacotaDiferencas(const uint32_t *d, uint64_t *p, int bits)
+{
+  uint64_t x;
+  int w, j, porPalavra = 64 / bits;
+
+  for (w = 0; w < bits; w++)
+  {
+    x = 0;
+    for (j = 0; j < porPalavra; j++)
+      x |= (uint64_t)d[w * porPalavra + j] << (j * bits);
+    p[w] = x;
+  }
+}
+
+/* compacta as celulas r0..r1 x c0..c1 do bloco de preenchimento, calculadas
+   em m. r0 e c0 sao a primeira linha e a primeira coluna de blocos da matriz
+   compacta, entao blocos de preenchimento diferentes escrevem em blocos
+   compactos diferentes. */
+void compactaBloco(int **m, int r0, int r1, int c0, int c1) {
+    uint32_t d[COLUNAS_ANCORA];
+    uint64_t *p;
+    size_t bloco;
+    int lin, cb, n, j, bits = compacta.bitsDelta, menor = compacta.menorDelta;
+    const int *atu;
+
+    for (cb = c0; cb <= c1; cb += COLUNAS_ANCORA) {
+        n = (c1 - cb + 1 < COLUNAS_ANCORA) ? c1 - cb + 1 : COLUNAS_ANCORA;
+        p = (uint64_t *)linhaCompacta(r0, cb, &bloco);
+        compacta.ancoras[bloco] = m[r0][cb];
+        for (lin = r0; lin <= r1; lin++, p += bits) {
+            // as diferencas da linha primeiro, depois empacotadas palavra a palavra
+            atu = m[lin] + cb;
+            d[0] = (lin > r0) ? (uint32_t)(atu[0] - m[lin - 1][cb] - menor) : 0;
+            for (j = 1; j < n; j++)
+                d[j] = (uint32_t)(atu[j] - atu[j - 1] - menor);
+            for (; j < COLUNAS_ANCORA; j++)
+                d[j] = 0;
+            if (bits == 2)
+                empacotaDiferencas(d, p, 2);
+            else if (bits == 4)
+                empacotaDiferencas(d, p, 4);
+            else if (bits == 8)
+                empacotaDiferencas(d, p, 8);
+            else
+                empacotaDiferencas(d, p, 16);
+        }
+    }
+}
+
+/* escolhe a largura das diferencas e aloca a matriz compacta. Retorna 0 se as
+   diferencas possiveis nao couberem em 16 bits ou nao houver memoria. */
+int alocaMatrizCompacta(void) {
+    int i, j, pesoMax = INT_MIN, maiorDelta, faixa;
+    size_t blocos;
+
+    for (i = 0; i < 4; i++)
+        for (j = 0; j < 4; j++)
+            if (matrizPesos[i][j] > pesoMax)
+                pesoMax = matrizPesos[i][j];
+    if (penalAbre > 0) {
+        if (pesoMax < 0)
+            pesoMax = 0;
+        maiorDelta = penalAbre + penalGap + pesoMax;
+        compacta.menorDelta = -maiorDelta;
+    } else {
+        maiorDelta = (pesoMax + penalGap > -penalGap) ? pesoMax + penalGap : -penalGap;
+        compacta.menorDelta = -penalGap;
+    }
+    faixa = maiorDelta - compacta.menorDelta + 1;
+    compacta.bitsDelta = (faixa <= 4) ? 2 : (faixa <= 16) ? 4 : (faixa <= 256) ? 8 : 16;
+    if (faixa > 65536) {
+        printf("\nDiferencas entre celulas grandes demais para a matriz compacta\n");
+        return 0;
+    }
+
+    compacta.blocosCol = (tamSeqMaior + COLUNAS_ANCORA - 1) / COLUNAS_ANCORA;
+    blocos = (size_t)((tamSeqMenor + tamBlocoLin - 1) / tamBlocoLin) * compacta.blocosCol;
+    compacta.ancoras = malloc(blocos * sizeof(int32_t) + 1);
+    compacta.deltas = malloc(blocos * tamBlocoLin * compacta.bitsDelta * sizeof(uint64_t) + 1);
+    if ((compacta.ancoras == NULL) || (compacta.deltas == NULL)) {
+        printf("\nMemoria insuficiente para a matriz compacta %d x %d\n", tamSeqMenor + 1, tamSeqMaior + 1);
+        free(compacta.ancoras);
+        free(compacta.deltas);
+        compacta.ancoras = NULL;
+        compacta.deltas = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+/* bytes ocupados pela matriz compacta */
+double bytesMatrizCompacta(void) {
+    double blocos = (double)((tamSeqMenor + tamBlocoLin - 1) / tamBlocoLin) * compacta.blocosCol;
+
+    return blocos * (sizeof(int32_t) + tamBlocoLin * compacta.bitsDelta * sizeof(uint64_t));
+}
+
+/* Modos sem a matriz de escores completa (direcoes e so escore). Cada bloco eh
+   calculado no rascunho da thread, com (tamBlocoLin+1) x (tamBlocoCol+1)
+   inteiros, e so as bordas entre blocos sao guardadas: bordaLinha tem, para
+   cada coluna, o escore da ultima linha de blocos que ja passou por ela, e
+   bordaColuna, para cada linha, o da ultima coluna de blocos. Um bloco le a sua
+   linha de cima e a sua coluna da esquerda dessas bordas e as sobrescreve com a
+   sua ultima linha e a sua ultima coluna, ja que os blocos de baixo e da direita
+   so comecam depois dele. O canto [r0-1,c0-1] seria sobrescrito pelo bloco da
+   esquerda antes do uso, entao cada bloco guarda em cantoLinha[bLin], antes de
+   sobrescrever bordaLinha, o canto do proximo bloco da sua linha de blocos.
+   Tudo ocupa memoria linear no tamanho das sequencias.
+
+   Logo apos o calculo, com o bloco ainda na cache, sao localizados o primeiro e
+   o ultimo maior escore do bloco, acumulados por thread e combinados ao final,
+   e, no modo de direcoes, gravados os bits de direcao das celulas. Cada bloco
+   comeca em uma coluna par (tamBlocoCol eh multiplo de 64), entao blocos
+   vizinhos nunca escrevem no mesmo byte de matrizDirecoes. */
+
+#define BYTES_ESCORES_BLOCO ((TAM_BLOCO_LIN_MAX+1)*(TAM_BLOCO_COL_MAX+1)*sizeof(int))
+
+int *bordaLinha = NULL,   // tamSeqMaior+1 escores
+    *bordaColuna = NULL,  // tamSeqMenor+1 escores
+    *cantoLinha = NULL;   // um canto por linha de blocos
+
+/* libera as bordas, usadas so no preenchimento */
+void liberaBordas(void) {
+    free(bordaLinha);
+    free(bordaColuna);
+    free(cantoLinha);
+    free(bordaGapEsq);
+    free(bordaGapCima);
+    bordaLinha = bordaColuna = cantoLinha = NULL;
+    bordaGapEsq = bordaGapCima = NULL;
+}
+
+/* acumula em dest os maiores escores de mb: em caso de empate, o primeiro maior
+   fica com a celula que vem antes na ordem das linhas e o ultimo com a que vem
+   depois. A ordem de combinacao nao altera o resultado. */
+void combinaMaiores(MaioresBloco *dest, const MaioresBloco *mb) {
+    if ((mb->PMaior > dest->PMaior) ||
+        ((mb->PMaior == dest->PMaior) && ((mb->linPMaior < dest->linPMaior) ||
+                                          ((mb->linPMaior == dest->linPMaior) && (mb->colPMaior < dest->colPMaior))))) {
+        dest->PMaior = mb->PMaior;
+        dest->linPMaior = mb->linPMaior;
+        dest->colPMaior = mb->colPMaior;
+    }
+    if ((mb->UMaior > dest->UMaior) ||
+        ((mb->UMaior == dest->UMaior) && ((mb->linUMaior > dest->linUMaior) ||
+                                          ((mb->linUMaior == dest->linUMaior) && (mb->colUMaior > dest->colUMaior))))) {
+        dest->UMaior = mb->UMaior;
+        dest->linUMaior = mb->linUMaior;
+        dest->colUMaior = mb->colUMaior;
+    }
+}
+
+/* localiza o primeiro e o ultimo maior escore do bloco r0..r1 x c0..c1 de m,
+   recem-calculado pela thread, acumulando-os em maiores, e, se houver matriz
+   de direcoes com gaps lineares, grava os bits das celulas (com gaps afins, o
+   calculo do bloco ja os gravou). Os maiores de cada linha vem do calculo, em
+   maiorLinhaBloco, e so a primeira e a ultima linha com o maior do bloco sao
+   percorridas, para achar as colunas. */
+void registraBloco(int **m, int r0, int r1, int c0, int c1, MaioresBloco *maiores) {
+    unsigned char basesMaior[TAM_BLOCO_COL_MAX], codigos[TAM_BLOCO_COL_MAX + 1];
+    unsigned char *dest;
+    int lin, col, w = c1 - c0 + 1;
+    int *pesos, *ant, *atu;
+    int gravaBits = (matrizDirecoes != NULL) && (penalAbre == 0);
+    MaioresBloco mb;
+
+    mb.PMaior = INT_MIN;
+    mb.linPMaior = mb.linUMaior = r0;
+    for (lin = r0; lin <= r1; lin++) {
+        if (maiorLinhaBloco[lin - r0] > mb.PMaior) {
+            mb.PMaior = maiorLinhaBloco[lin - r0];
+            mb.linPMaior = lin;
+        }
+        if (maiorLinhaBloco[lin - r0] == mb.PMaior)
+            mb.linUMaior = lin;
+    }
+    mb.UMaior = mb.PMaior;
+    atu = m[mb.linPMaior];
+    for (col = c0; atu[col] != mb.PMaior; col++)
+        ;
+    mb.colPMaior = col;
+    atu = m[mb.linUMaior];
+    for (col = c1; atu[col] != mb.UMaior; col--)
+        ;
+    mb.colUMaior = col;
+    combinaMaiores(maiores, &mb);
+    if (!gravaBits)
+        return;
+
+    desempacotaBases(&seqMaior, c0 - 1, w, basesMaior);
+    codigos[w] = 0;
+    for (lin = r0; lin <= r1; lin++) {
+        atu = m[lin];
+        pesos = matrizPesos[baseEm(&seqMenor, lin - 1)];
+        ant = m[lin - 1];
+        for (col = c0; col <= c1; col++)
+            codigos[col - c0] = codigoDirecao(atu[col], ant[col - 1] + pesos[basesMaior[col - c0]],
+                                              atu[col - 1] - penalGap, ant[col] - penalGap);
+        dest = matrizDirecoes + (size_t)(lin - 1) * passoDirecoes + (c0 - 1) / 2;
+        for (col = 0; col < w; col += 2)
+            dest[col / 2] = codigos[col] | (codigos[col + 1] << 4);
+    }
+}
+
+/* calcula o bloco [bLin,bCol] sem a matriz de escores: monta as bordas no
+   rascunho do bloco, calcula os escores, registra o bloco e sobrescreve as
+   bordas com a ultima linha e a ultima coluna do bloco */
+void processaBlocoSemMatriz(int bLin, int bCol, void *area, MaioresBloco *maiores) {
+    int *linhas[TAM_BLOCO_LIN_MAX + 1], **m;
+    int *escores = (int *)((char *)area + BYTES_AREA_SIMD);
+    int r0, r1, c0, c1, lin, i;
+
+    r0 = bLin * tamBlocoLin + 1;
+    r1 = (bLin + 1) * tamBlocoLin;
+    if (r1 > tamSeqMenor) r1 = tamSeqMenor;
+    c0 = bCol * tamBlocoCol + 1;
+    c1 = (bCol + 1) * tamBlocoCol;
+    if (c1 > tamSeqMaior) c1 = tamSeqMaior;
+
+    // m[lin][col] enderecam o rascunho com os indices da matriz completa
+    for (i = 0; i <= r1 - r0 + 1; i++)
+        linhas[i] = escores + i * (tamBlocoCol + 1) - (c0 - 1);
+    m = linhas - (r0 - 1);
+
+    // Canto, linha de cima e coluna da esquerda do bloco
+    m[r0 - 1][c0 - 1] = (bCol == 0) ? escoreBorda(r0 - 1) : cantoLinha[bLin];
+    memcpy(&m[r0 - 1][c0], &bordaLinha[c0], (size_t)(c1 - c0 + 1) * sizeof(int));
+    for (lin = r0; lin <= r1; lin++)
+        m[lin][c0 - 1] = (bCol == 0) ? escoreBorda(lin) : bordaColuna[lin];
+
+    calculaBlocoEm(m, bLin, bCol, area);
+    registraBloco(m, r0, r1, c0, c1, maiores);
+    if (compacta.ancoras != NULL)
+        compactaBloco(m, r0, r1, c0, c1);
+
+    // A ultima linha do bloco pode ser uma linha de controle
+    if ((linhasControle != NULL) && (r1 % passoControle == 0) && (r1 < tamSeqMenor)) {
+        int *controle = linhasControle + (size_t)(r1 / passoControle) * larguraControle;
+        if (bCol == 0)
+            controle[0] = escoreBorda(r1);
+        memcpy(&controle[c0], &m[r1][c0], (size_t)(c1 - c0 + 1) * sizeof(int));
+    }
+
+    cantoLinha[bLin] = bordaLinha[c1];
+    memcpy(&bordaLinha[c0], &m[r1][c0], (size_t)(c1 - c0 + 1) * sizeof(int));
+    for (lin = r0; lin <= r1; lin++)
+        bordaColuna[lin] = m[lin][c1];
+}
+
+/* aloca as bordas dos modos sem matriz de escores e, no modo de direcoes, a
+   matriz de direcoes, liberando a matriz de escores. Retorna 0 se nao houver
+   memoria suficiente. */
+int alocaBordas(int nBlocosLin) {
+    int col;
+
+    liberaMatrizEscores();
+    if (((modoPreenchimento == MODO_DIRECOES) || ((modoPreenchimento == MODO_COMPACTA) && (penalAbre > 0))) &&
+        !alocaMatrizDirecoes())
+        return 0;
+    bordaLinha = malloc(((size_t)tamSeqMaior + 1) * sizeof(int));
+    bordaColuna = malloc(((size_t)tamSeqMenor + 1) * sizeof(int));
+    cantoLinha = malloc(((size_t)nBlocosLin + 1) * sizeof(int));
+    if ((bordaLinha == NULL) || (bordaColuna == NULL) || (cantoLinha == NULL)) {
+        printf("\nMemoria insuficiente para as bordas dos blocos\n");
+        liberaMatrizDirecoes();
+        liberaBordas();
+        return 0;
+    }
+
+    // A linha 0 eh a borda de cima da primeira linha de blocos
+    for (col = 0; col <= tamSeqMaior; col++)
+        bordaLinha[col] = escoreBorda(col);
+    return 1;
+}
+
+/* aloca as bordas de gap, com gaps afins, em qualquer modo de preenchimento.
+   A linha 0 e a coluna 0 nao terminam em gap do outro sentido, entao comecam
+   com NEG_AFIM. Retorna 0 se nao houver memoria suficiente. */
+int alocaBordasGap(void) {
+    int i;
+
+    bordaGapEsq = malloc(((size_t)tamSeqMenor + 1) * sizeof(int));
+    bordaGapCima = malloc(((size_t)tamSeqMaior + 1) * sizeof(int));
+    if ((bordaGapEsq == NULL) || (bordaGapCima == NULL)) {
+        printf("\nMemoria insuficiente para as bordas de gap\n");
+        liberaBordas();
+        return 0;
+    }
+    for (i = 0; i <= tamSeqMenor; i++)
+        bordaGapEsq[i] = NEG_AFIM;
+    for (i = 0; i <= tamSeqMaior; i++)
+        bordaGapCima[i] = NEG_AFIM;
+    return 1;
+}
+
+/* Modo de linhas de controle (opcao -c). O preenchimento segue o dos modos sem
+   matriz e guarda so uma linha de escores a cada passoControle linhas (um
+   multiplo de tamBlocoLin, entao as linhas de controle sao ultimas linhas de
+   blocos). No traceback, a faixa entre duas linhas de controle eh recalculada
+   a partir da de cima, bloco a bloco com o mesmo kernel, so ate a coluna mais
+   a direita que os caminhos ainda ocupam, e os caminhos a percorrem; enquanto
+   isso, uma thread auxiliar ja recalcula a faixa de cima em um segundo buffer.
+
+   Com n = tamSeqMenor e s = passoControle, a memoria eh de n/s + 1 linhas de
+   controle e 2*s linhas de faixa, minima com s perto de raiz(n/2), e o
+   traceback recalcula no maximo a matriz inteira uma vez. Dentro do orcamento
+   da opcao -c, escolhe-se o menor s, que mais aproxima a coluna limite de
+   cada faixa da do caminho; se a matriz inteira couber, ela eh usada, sem
+   recalculo. So com gaps lineares, como no metodo de Hirschberg. */
+
+/* verifica se a matriz de escores inteira cabe no orcamento da opcao -c */
+int matrizCabeNoOrcamento(void) {
+    larguraControle = ((tamSeqMaior + 1 + ALINHAMENTO_LINHA - 1) / ALINHAMENTO_LINHA) * ALINHAMENTO_LINHA;
+    return ((size_t)tamSeqMenor + 1) * larguraControle * sizeof(int) <= orcamentoControle;
+}
+
+/* escolhe passoControle para o orcamento e aloca as linhas de controle, com a
+   linha 0 ja preenchida. Retorna 0 se o orcamento for pequeno demais ou se
+   nao houver memoria. */
+int alocaLinhasControle(void) {
+    size_t bytesLinha, bytes, minimo = 0;
+    int s, col, limite = ((tamSeqMenor + tamBlocoLin - 1) / tamBlocoLin) * tamBlocoLin;
+
+    larguraControle = ((tamSeqMaior + 1 + ALINHAMENTO_LINHA - 1) / ALINHAMENTO_LINHA) * ALINHAMENTO_LINHA;
+    bytesLinha = larguraControle * sizeof(int);
+    passoControle = 0;
+    for (s = tamBlocoLin; s <= limite; s += tamBlocoLin) {
+        bytes = ((size_t)(tamSeqMenor - 1) / s + 1 + 2 * (size_t)s) * bytesLinha;
+        if (bytes <= orcamentoControle) {
+            passoControle = s;
+            break;
+        }
+        if ((minimo == 0) || (bytes < minimo))
+            minimo = bytes;
+    }
+    if ((minimo == 0) || (((size_t)tamSeqMenor + 1) * bytesLinha < minimo))
+        minimo = ((size_t)tamSeqMenor + 1) * bytesLinha; // a matriz inteira gasta menos
+    if (passoControle == 0) {
+        // em entradas pequenas, %.1f MB mostraria 0.0; abaixo de 1 MB sai em bytes
+        if (minimo < 1000000)
+            printf("\nOrcamento de %zu bytes insuficiente para as linhas de controle; o minimo eh %zu bytes\n",
+                   orcamentoControle, minimo);
+        else
+            printf("\nOrcamento de %.1f MB insuficiente para as linhas de controle; o minimo eh %.1f MB\n",
+                   orcamentoControle / 1e6, minimo / 1e6);
+        return 0;
+    }
+
+    linhasControle = malloc(((size_t)(tamSeqMenor - 1) / passoControle + 1) * bytesLinha);
+    if (linhasControle == NULL) {
+        printf("\nMemoria insuficiente para as linhas de controle\n");
+        return 0;
+    }
+    for (col = 0; col <= tamSeqMaior; col++)
+        linhasControle[col] = escoreBorda(col);
+    return 1;
+}
+
+typedef struct {
+    int *escores;   // passoControle linhas de larguraControle inteiros
+    int **linhas;   // passoControle+1 linhas, a primeira eh a de controle
+    int **m;        // m[lin][col] enderecam a faixa com os indices da matriz
+    int lin0, lin1; // linha de controle e ultima linha a recalcular
+    int colFim;     // ultima coluna a recalcular
+    char *area;     // rascunho do kernel vetorial
+} FaixaControle;
+
+/* recalcula as linhas lin0+1..lin1 da faixa, colunas 1..colFim (completando
+   os blocos), a partir da linha de controle lin0 */
+void recalculaFaixa(FaixaControle *f) {
+    int lin, bLin, bCol, linFim = f->lin0 + passoControle;
+
+    if (linFim > tamSeqMenor) linFim = tamSeqMenor;
+    f->m = f->linhas - f->lin0;
+    f->m[f->lin0] = linhasControle + (size_t)(f->lin0 / passoControle) * larguraControle;
+    for (lin = f->lin0 + 1; lin <= linFim; lin++) {
+        f->m[lin] = f->escores + (size_t)(lin - f->lin0 - 1) * larguraControle;
+        f->m[lin][0] = escoreBorda(lin);
+    }
+    for (bLin = f->lin0 / tamBlocoLin; bLin <= (f->lin1 - 1) / tamBlocoLin; bLin++)
+        for (bCol = 0; bCol <= (f->colFim - 1) / tamBlocoCol; bCol++)
+            calculaBlocoEm(f->m, bLin, bCol, alinhaPonteiro(f->area));
+}
+
+void* recalculaFaixaThread(void* arg) {
+    recalculaFaixa((FaixaControle*)arg);
+    return NULL;
+}
+
+/* calcula o bloco [bLin,bCol], na matriz de escores ou sem ela */
+void processaBloco(int bLin, int bCol, void *area, MaioresBloco *maiores) {
+    int r1, c1;
+
+    if (matrizEscores == NULL) {
+        processaBlocoSemMatriz(bLin, bCol, area, maiores);
+        return;
+    }
+    r1 = (bLin + 1) * tamBlocoLin;
+    if (r1 > tamSeqMenor) r1 = tamSeqMenor;
+    c1 = (bCol + 1) * tamBlocoCol;
+    if (c1 > tamSeqMaior) c1 = tamSeqMaior;
+    calculaBlocoEm(matrizEscores, bLin, bCol, area);
+    registraBloco(matrizEscores, bLin * tamBlocoLin + 1, r1, bCol * tamBlocoCol + 1, c1, maiores);
+}
+
+/* verifica se o bloco [bLin,bCol] pode ser calculado: ele eh o proximo da sua
+   linha de blocos e o bloco de cima ja terminou (o que implica o da diagonal) */
+int dependenciasProntas(FrenteOnda* f, int bLin, int bCol) {
+    if ((bLin >= f->nBlocosLin) || (bCol >= f->nBlocosCol))
+        return 0;
+    if (__atomic_load_n(&f->feitosLinha[bLin], __ATOMIC_SEQ_CST) != bCol)
+        return 0;
+    if ((bLin > 0) && (__atomic_load_n(&f->feitosLinha[bLin-1], __ATOMIC_SEQ_CST) <= bCol))
+        return 0;
+    return 1;
+}
+
+/* poe o bloco no fim do deque d e acorda uma thread que esteja esperando */
+void poeBloco(FrenteOnda* f, DequeBlocos* d, int bloco) {
+    pthread_mutex_lock(&d->mutex);
+    d->blocos[d->fim++ % (f->nBlocosLin + 1)] = bloco;
+    pthread_mutex_unlock(&d->mutex);
+
+    __atomic_add_fetch(&f->blocosProntos, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&f->dormindo, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&f->mutex);
+        pthread_cond_signal(&f->temBloco);
+        pthread_mutex_unlock(&f->mutex);
+    }
+}
+
+/* tira um bloco do deque d: do fim, se d eh o da propria thread, ou do inicio,
+   num roubo. Retorna -1 se o deque estiver vazio. */
+int tiraBloco(FrenteOnda* f, DequeBlocos* d, int roubo) {
+    int bloco = -1;
+
+    pthread_mutex_lock(&d->mutex);
+    if (d->inicio != d->fim)
+        bloco = roubo ? d->blocos[d->inicio++ % (f->nBlocosLin + 1)]
+                      : d->blocos[--d->fim % (f->nBlocosLin + 1)];
+    pthread_mutex_unlock(&d->mutex);
+    if (bloco >= 0)
+        __atomic_sub_fetch(&f->blocosProntos, 1, __ATOMIC_SEQ_CST);
+    return bloco;
+}
+
+/* proximo bloco da thread eu: o do seu deque ou, com ele vazio, um roubado das
+   outras, a partir da seguinte. Sem nenhum bloco pronto, espera um bloco ou o
+   fim do trabalho; retorna -1 quando todos os blocos terminaram. */
+int proximoBloco(FrenteOnda* f, int eu) {
+    int i, bloco;
+
+    while (1) {
+        bloco = tiraBloco(f, &f->deques[eu], 0);
+        for (i = 1; (bloco < 0) && (i < f->nDeques); i++)
+            bloco = tiraBloco(f, &f->deques[(eu + i) % f->nDeques], 1);
+        if (bloco >= 0)
+            return bloco;
+
+        pthread_mutex_lock(&f->mutex);
+        __atomic_add_fetch(&f->dormindo, 1, __ATOMIC_SEQ_CST);
+        while ((__atomic_load_n(&f->blocosProntos, __ATOMIC_SEQ_CST) == 0) &&
+               (__atomic_load_n(&f->blocosRestantes, __ATOMIC_SEQ_CST) > 0))
+            pthread_cond_wait(&f->temBloco, &f->mutex);
+        __atomic_sub_fetch(&f->dormindo, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&f->mutex);
+        if (__atomic_load_n(&f->blocosRestantes, __ATOMIC_SEQ_CST) == 0)
+            return -1; // Todos os blocos foram calculados
+    }
+}
+
+/* poe o bloco [bLin,bCol] no deque d se as dependencias dele estiverem
+   prontas e nenhuma outra thread o tiver liberado antes */
+void liberaBloco(FrenteOnda* f, DequeBlocos* d, int bLin, int bCol) {
+    int esperado = bCol;
+
+    if (dependenciasProntas(f, bLin, bCol) &&
+        __atomic_compare_exchange_n(&f->liberadosLinha[bLin], &esperado, bCol + 1, 0,
+                                    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+        poeBloco(f, d, bLin * f->nBlocosCol + bCol);
+}
+
+/* conta o bloco como pronto e libera os vizinhos da direita e de baixo, se as
+   dependencias deles ficaram completas (o da diagonal ainda depende do da
+   direita), no deque da thread eu. Sem trava global: as duas dependencias de
+   um vizinho podem terminar ao mesmo tempo, e como cada uma grava feitosLinha
+   antes de ler a da outra, ao menos uma encontra o vizinho liberado; a troca
+   atomica em liberadosLinha faz so uma delas coloca-lo em um deque.
+   O ultimo bloco de uma linha de blocos torna finais as linhas da matriz ate
+   ela, que sao passadas para a gravacao em segundo plano. */
+void concluiBloco(FrenteOnda* f, int eu, int bLin, int bCol) {
+    __atomic_store_n(&f->feitosLinha[bLin], bCol + 1, __ATOMIC_SEQ_CST);
+
+    // O de baixo vai primeiro, para o dono seguir na mesma linha de blocos e
+    // os roubos levarem o de baixo
+    liberaBloco(f, &f->deques[eu], bLin + 1, bCol);
+    liberaBloco(f, &f->deques[eu], bLin, bCol + 1);
+
+    if (__atomic_sub_fetch(&f->blocosRestantes, 1, __ATOMIC_SEQ_CST) == 0) {
+        pthread_mutex_lock(&f->mutex);
+        pthread_cond_broadcast(&f->temBloco);
+        pthread_mutex_unlock(&f->mutex);
+    }
+
+    if (bCol + 1 == f->nBlocosCol)
+        liberaLinhasEscritor(((bLin + 1) * tamBlocoLin < tamSeqMenor ? (bLin + 1) * tamBlocoLin : tamSeqMenor) + 1);
+}
+
+/* rascunho do kernel vetorial e do bloco sem matriz, alocado uma vez por
+   thread do pool e mantido de um preenchimento para o outro */
+__thread char *rascunhoThread = NULL;
+
+void* preenchematriz(void* arg) {
+    ThreadData *data = (ThreadData*)arg;
+    FrenteOnda *f = data->frente;
+    int bloco;
+
+    if (rascunhoThread == NULL)
+        rascunhoThread = malloc(BYTES_AREA_SIMD + BYTES_ESCORES_BLOCO + 64);
+
+    data->maiores.PMaior = data->maiores.UMaior = INT_MIN;
+    data->maiores.linPMaior = data->maiores.colPMaior = 0;
+    data->maiores.linUMaior = data->maiores.colUMaior = 0;
+    while ((bloco = proximoBloco(f, data->indice)) >= 0) {
+        f->processa(bloco / f->nBlocosCol, bloco % f->nBlocosCol, alinhaPonteiro(rascunhoThread), &data->maiores);
+        concluiBloco(f, data->indice, bloco / f->nBlocosCol, bloco % f->nBlocosCol);
+    }
+    return NULL;
+}
+
+/* prepara a frente de onda de nBlocosLin x nBlocosCol blocos e processa como
+   o trabalho de cada bloco; os deques sao criados por executaFrente */
+void iniciaFrente(FrenteOnda *f, int nBlocosLin, int nBlocosCol,
+                  void (*processa)(int, int, void *, MaioresBloco *)) {
+    f->nBlocosLin = nBlocosLin;
+    f->nBlocosCol = nBlocosCol;
+    f->processa = processa;
+    f->feitosLinha = calloc(nBlocosLin + 1, sizeof(int));
+    f->liberadosLinha = calloc(nBlocosLin + 1, sizeof(int));
+    f->deques = NULL;
+    f->nDeques = 0;
+    f->blocosProntos = 0;
+    f->blocosRestantes = nBlocosLin * nBlocosCol;
+    f->dormindo = 0;
+    pthread_mutex_init(&f->mutex, NULL);
+    pthread_cond_init(&f->temBloco, NULL);
+}
+
+/* percorre a frente de onda com K tarefas do pool, uma por thread pedida e
+   cada uma com o seu deque, comecando pelo bloco [0,0] no deque da primeira,
+   e a libera */
+void executaFrente(FrenteOnda *f, ThreadData *thread_data, int K) {
+    GrupoTarefas grupo = {0};
+
+    f->nDeques = K;
+    f->deques = calloc(K, sizeof(DequeBlocos));
+    for (int i = 0; i < K; i++) {
+        f->deques[i].blocos = malloc((f->nBlocosLin + 1) * sizeof(int));
+        pthread_mutex_init(&f->deques[i].mutex, NULL);
+    }
+    if (f->blocosRestantes > 0) {
+        f->liberadosLinha[0] = 1;
+        poeBloco(f, &f->deques[0], 0);
+    }
+
+    preparaPool(K);
+    for (int i = 0; i < K; i++) {
+        thread_data[i].num_threads = K;
+        thread_data[i].indice = i;
+        thread_data[i].frente = f;
+        submeteTarefa(&grupo, preenchematriz, &thread_data[i]);
+    }
+
+    // Aguarda a conclusão de todas as tarefas
+    aguardaGrupo(&grupo);
+
+    // Destruir os mutexes e liberar a frente de onda
+    for (int i = 0; i < K; i++) {
+        pthread_mutex_destroy(&f->deques[i].mutex);
+        free(f->deques[i].blocos);
+    }
+    free(f->deques);
+    pthread_cond_destroy(&f->temBloco);
+    pthread_mutex_destroy(&f->mutex);
+    free(f->feitosLinha);
+    free(f->liberadosLinha);
+}
+/* escolha do formato dos blocos, definida junto com o ajuste automatico */
+void escolheBlocos(void);
+
+/* gravacao em segundo plano, definida junto com o formato binario da matriz */
+int iniciaEscritor(const char *nomeArquivo);
+void concluiEscritor(void);
+void salvaMatrizBinaria(const char *nomeArquivo);
+
+void geraMatrizEscores(int K) {
+    ThreadData thread_data[K];
+    FrenteOnda frente;
+    int i, nBlocosLin, nBlocosCol, gravaDepois, semMatriz;
+    double inicio, tempo;
+
+    printf("\nGeracao da Matriz de escores:\n");
+
+    escolheBlocos();
+    nBlocosLin = (tamSeqMenor + tamBlocoLin - 1) / tamBlocoLin;
+    nBlocosCol = (tamSeqMaior + tamBlocoCol - 1) / tamBlocoCol;
+
+    semMatriz = (modoPreenchimento != MODO_MATRIZ);
+    if (modoPreenchimento == MODO_CONTROLE) {
+        if (penalAbre > 0) {
+            printf("\nO modo de linhas de controle (-c) usa apenas gaps lineares (sem a opcao -g).\n");
+            liberaMatrizEscores();
+            return;
+        }
+        // Com a matriz inteira no orcamento, o preenchimento eh o do modo da
+        // matriz; senao, o dos modos sem matriz, mais as linhas de controle
+        semMatriz = !matrizCabeNoOrcamento();
+    }
+    if (semMatriz) {
+        // Sem matriz de escores: as penalidades iniciais ficam nas bordas
+        if (!alocaBordas(nBlocosLin))
+            return;
+        if (((modoPreenchimento == MODO_CONTROLE) && !alocaLinhasControle()) ||
+            ((modoPreenchimento == MODO_COMPACTA) && !alocaMatrizCompacta())) {
+            liberaMatrizDirecoes();
+            liberaBordas();
+            return;
+        }
+    } else {
+        liberaMatrizDirecoes();
+        if (!alocaMatrizEscores())
+            return;
+        if ((penalAbre > 0) && !alocaMatrizDirecoes())
+            return;
+
+        // Inicializando a linha de penalidades/gaps
+        for (int col = 0; col <= tamSeqMaior; col++) {
+            matrizEscores[0][col] = escoreBorda(col);
+        }
+
+        // Inicializando a coluna de penalidades/gaps
+        for (int lin = 0; lin <= tamSeqMenor; lin++) {
+            matrizEscores[lin][0] = escoreBorda(lin);
+        }
+    }
+    if ((penalAbre > 0) && !alocaBordasGap()) {
+        liberaMatrizEscores();
+        return;
+    }
+
+    // Inicializando a frente de onda, com o bloco [0,0] como unico pronto
+    iniciaFrente(&frente, nBlocosLin, nBlocosCol, processaBloco);
+
+    // A matriz vai para matriz_escores.bin em segundo plano, ja durante o
+    // preenchimento se sobra um nucleo alem das K threads ou, senao, a partir
+    // do fim dele, em paralelo com o traceback. Sem a thread de gravacao, o
+    // arquivo eh gravado antes de voltar ao menu.
+    gravaDepois = (modoPreenchimento == MODO_MATRIZ) && gravaMatriz;
+    if (gravaDepois && (sysconf(_SC_NPROCESSORS_ONLN) > K))
+        gravaDepois = !iniciaEscritor("matriz_escores.bin");
+
+    inicio = tempoAtual();
+    preparaKernelSimd(nBlocosCol, 1);
+    executaFrente(&frente, thread_data, K);
+    tempo = tempoAtual() - inicio;
+
+    // Cada thread acumulou os maiores escores dos seus blocos; a combinacao
+    // mantem a ordem das linhas, qualquer que seja a thread de cada bloco
+    for (i = 1; i < K; i++)
+        combinaMaiores(&thread_data[0].maiores, &thread_data[i].maiores);
+    PMaior = thread_data[0].maiores.PMaior;
+    linPMaior = thread_data[0].maiores.linPMaior;
+    colPMaior = thread_data[0].maiores.colPMaior;
+    UMaior = thread_data[0].maiores.UMaior;
+    linUMaior = thread_data[0].maiores.linUMaior;
+    colUMaior = thread_data[0].maiores.colUMaior;
+
+    if (semMatriz) {
+        liberaBordas();
+
+        if (modoPreenchimento == MODO_DIRECOES)
+            printf("\nMatriz de direcoes Gerada (%.1f MB, sem a matriz de escores).",
+                   (double)tamSeqMenor * passoDirecoes / 1e6);
+        else if (modoPreenchimento == MODO_COMPACTA)
+            printf("\nMatriz compacta Gerada (%.1f MB, diferencas de %d bits, %.1f vezes menor que a matriz).",
+                   bytesMatrizCompacta() / 1e6, compacta.bitsDelta,
+                   ((double)tamSeqMenor + 1) * (tamSeqMaior + 1) * sizeof(int) / bytesMatrizCompacta());
+        else if (modoPreenchimento == MODO_CONTROLE)
+            printf("\nLinhas de controle Geradas, a cada %d linhas (%.1f MB, mais %.1f MB de faixas no traceback).",
+                   passoControle, ((tamSeqMenor - 1) / passoControle + 1) * larguraControle * sizeof(int) / 1e6,
+                   2.0 * passoControle * larguraControle * sizeof(int) / 1e6);
+        else
+            printf("\nMaiores escores calculados (so escore, sem matriz).");
+        printf("\nPrimeiro Maior escore = %d na celula [%d,%d]", PMaior, linPMaior, colPMaior);
+        printf("\nUltimo Maior escore = %d na celula [%d,%d]", UMaior, linUMaior, colUMaior);
+        printf("\nTempo de preenchimento = %.3f s (%.1f milhoes de celulas/s)\n", tempo,
+               tempo > 0 ? (double)tamSeqMenor * tamSeqMaior / tempo / 1e6 : 0.0);
+        if ((modoPreenchimento == MODO_COMPACTA) && gravaMatriz)
+            salvaMatrizBinaria("matriz_escores.bin");
+        return;
+    }
+    liberaBordas();
+
+    if (modoPreenchimento == MODO_CONTROLE)
+        printf("\nA matriz de escores inteira cabe no orcamento da opcao -c e foi guardada.");
+    printf("\nMatriz de escores Gerada.");
+    printf("\nPrimeiro Maior escore = %d na celula [%d,%d]", PMaior, linPMaior, colPMaior);
+    printf("\nUltimo Maior escore = %d na celula [%d,%d]", UMaior, linUMaior, colUMaior);
+    printf("\nTempo de preenchimento = %.3f s (%.1f milhoes de celulas/s)\n", tempo,
+           tempo > 0 ? (double)tamSeqMenor * tamSeqMaior / tempo / 1e6 : 0.0);
+    if (gravaDepois && !iniciaEscritor("matriz_escores.bin"))
+        salvaMatrizBinaria("matriz_escores.bin");
+    concluiEscritor();
+}
+
+/* Ajuste automatico do formato dos blocos. A altura de um bloco define quantas
+   linhas reaproveitam a linha de cima enquanto ela esta na cache, e a largura,
+   quanto de cada linha (e do perfil do kernel) precisa caber nela; o melhor
+   formato depende das caches da CPU. No ajuste, cada formato candidato
+   preenche uma matriz de teste de LIN_AJUSTE x COL_AJUSTE celulas, com uma
+   thread e o kernel que o preenchimento usaria, e o mais rapido (o menor tempo
+   de REPETICOES_AJUSTE preenchimentos) vai para o perfil, com o nome do kernel.
+
+   O perfil fica em um unico lugar por usuario, ARQUIVO_PERFIL_BLOCOS na pasta
+   pessoal ($HOME), ou no arquivo da opcao -P, e eh lido no primeiro
+   preenchimento, se o kernel for o mesmo. O ajuste, que leva cerca de um
+   segundo, so eh feito com a opcao -u ou, sem perfil, num preenchimento de
+   pelo menos CELULAS_AJUSTE celulas, que ja leva mais que isso; alinhamentos
+   menores usam o formato padrao. A opcao -y fixa o formato sem perfil nem
+   ajuste. As mensagens vao para a saida de erros, que nao se mistura aos
+   resultados de -i e -j. */
+
+#define ARQUIVO_PERFIL_BLOCOS ".nw_perfil_blocos"
+#define LIN_AJUSTE            1024
+#define COL_AJUSTE            16384
+#define REPETICOES_AJUSTE     2
+#define CELULAS_AJUSTE        (16.0*LIN_AJUSTE*COL_AJUSTE)
+
+int alturasCandidatas[]={32, 64, 128, 256},
+    largurasCandidatas[]={128, 256, 512, 1024};
+int formatoFixado=0;   /* formato dado pela opcao -y */
+int reajustaBlocos=0;  /* ajusta no proximo preenchimento, mesmo com o perfil
+                          gravado ou num alinhamento pequeno (opcao -u) */
+int blocosEscolhidos=0;          /* formato ja lido do perfil ou ajustado */
+char *arquivoPerfilBlocos=NULL;  /* perfil da opcao -P */
+char caminhoPerfil[4096];
+
+/* arquivo do perfil: o da opcao -P ou ARQUIVO_PERFIL_BLOCOS em $HOME (ou na
+   pasta atual, sem $HOME) */
+const char *perfilBlocos(void) {
+    const char *pasta = getenv("HOME");
+
+    if (arquivoPerfilBlocos != NULL)
+        return arquivoPerfilBlocos;
+    if ((pasta == NULL) || (*pasta == 0))
+        return ARQUIVO_PERFIL_BLOCOS;
+    snprintf(caminhoPerfil, sizeof(caminhoPerfil), "%s/%s", pasta, ARQUIVO_PERFIL_BLOCOS);
+    return caminhoPerfil;
+}
+
+/* verifica se o formato lin x col eh aceito pelo preenchimento */
+int formatoBlocoValido(int lin, int col) {
+    return (lin >= 1) && (lin <= TAM_BLOCO_LIN_MAX) && (col >= COLUNAS_ANCORA) &&
+           (col <= TAM_BLOCO_COL_MAX) && (col % COLUNAS_ANCORA == 0);
+}
+
+/* le o formato da opcao -y, "linhas,colunas". Retorna 0 se ele for invalido */
+int leFormatoBloco(const char *texto) {
+    int lin, col;
+
+    if ((sscanf(texto, "%d,%d", &lin, &col) != 2) || !formatoBlocoValido(lin, col))
+        return 0;
+    tamBlocoLin = lin;
+    tamBlocoCol = col;
+    formatoFixado = 1;
+    return 1;
+}
+
+/* le o formato do perfil gravado, se ele existir e for do kernel atual */
+int lePerfilBlocos(void) {
+    FILE *arq = fopen(perfilBlocos(), "r");
+    char kernel[32];
+    int lin, col, ok;
+
+    if (arq == NULL)
+        return 0;
+    ok = (fscanf(arq, "%31s %d %d", kernel, &lin, &col) == 3) &&
+         (strcmp(kernel, nomeKernel[kernelDoPreenchimento()]) == 0) && formatoBlocoValido(lin, col);
+    fclose(arq);
+    if (ok) {
+        tamBlocoLin = lin;
+        tamBlocoCol = col;
+    }
+    return ok;
+}
+
+/* tempo de um preenchimento da matriz de teste com o formato atual */
+double tempoFormatoBloco(void) {
+    ThreadData dados[1];
+    FrenteOnda frente;
+    int nBlocosCol = (tamSeqMaior + tamBlocoCol - 1) / tamBlocoCol;
+    double inicio;
+
+    iniciaFrente(&frente, (tamSeqMenor + tamBlocoLin - 1) / tamBlocoLin, nBlocosCol, processaBloco);
+    preparaKernelSimd(nBlocosCol, 0);
+    inicio = tempoAtual();
+    executaFrente(&frente, dados, 1);
+    return tempoAtual() - inicio;
+}
+
+/* mede os formatos candidatos em sequencias aleatorias, fica com o mais rapido
+   e o grava no perfil. As sequencias atuais e a penalidade de abertura sao
+   restauradas no fim; a matriz atual eh liberada, entao deve ser chamada antes
+   de o preenchimento alocar a sua. */
+void ajustaBlocos(void) {
+    int i, j, r, col, maior = tamSeqMaior, menor = tamSeqMenor, abre = penalAbre;
+    int melhorLin = tamBlocoLin, melhorCol = tamBlocoCol;
+    SeqCompacta seqMaiorAtual = seqMaior, seqMenorAtual = seqMenor, vazia = {NULL, NULL, 0};
+    double t, melhor = 0;
+    FILE *arq;
+    int gravado = 0;
+
+    fprintf(stderr, "Ajustando o formato dos blocos para esta CPU...\n");
+    penalAbre = 0; // o teste usa o kernel de gaps lineares
+    tamSeqMaior = COL_AJUSTE;
+    tamSeqMenor = LIN_AJUSTE;
+    seqMaior = seqMenor = vazia;
+    alocaSequencia(&seqMaior, tamSeqMaior);
+    alocaSequencia(&seqMenor, tamSeqMenor);
+    for (i = 0; i < tamSeqMaior; i++)
+        defineBase(&seqMaior, i, rand() % 4);
+    for (i = 0; i < tamSeqMenor; i++)
+        defineBase(&seqMenor, i, rand() % 4);
+
+    if (alocaMatrizEscores()) {
+        for (col = 0; col <= tamSeqMaior; col++)
+            matrizEscores[0][col] = escoreBorda(col);
+        for (i = 0; i <= tamSeqMenor; i++)
+            matrizEscores[i][0] = escoreBorda(i);
+        tempoFormatoBloco(); // a primeira passada so traz as paginas da matriz
+
+        for (i = 0; i < (int)(sizeof(alturasCandidatas) / sizeof(int)); i++)
+            for (j = 0; j < (int)(sizeof(largurasCandidatas) / sizeof(int)); j++) {
+                tamBlocoLin = alturasCandidatas[i];
+                tamBlocoCol = largurasCandidatas[j];
+                for (r = 0; r < REPETICOES_AJUSTE; r++) {
+                    t = tempoFormatoBloco();
+                    if ((melhor == 0) || (t < melhor)) {
+                        melhor = t;
+                        melhorLin = tamBlocoLin;
+                        melhorCol = tamBlocoCol;
+                    }
+                }
+            }
+    }
+    liberaMatrizEscores();
+    free(perfilSimd);
+    perfilSimd = NULL;
+    free(seqMaior.bases);
+    free(seqMaior.mascara);
+    free(seqMenor.bases);
+    free(seqMenor.mascara);
+    seqMaior = seqMaiorAtual;
+    seqMenor = seqMenorAtual;
+    tamSeqMaior = maior;
+    tamSeqMenor = menor;
+    penalAbre = abre;
+    tamBlocoLin = melhorLin;
+    tamBlocoCol = melhorCol;
+    if (melhor == 0)
+        return; // sem memoria para o teste, fica o formato padrao
+
+    fprintf(stderr, "Blocos de %d x %d celulas (%.1f milhoes de celulas/s por thread)\n", tamBlocoLin,
+            tamBlocoCol, (double)LIN_AJUSTE * COL_AJUSTE / melhor / 1e6);
+    arq = fopen(perfilBlocos(), "w");
+    if (arq != NULL) {
+        gravado = fprintf(arq, "%s %d %d\n", nomeKernel[kernelDoPreenchimento()], tamBlocoLin, tamBlocoCol) > 0;
+        gravado = (fclose(arq) == 0) && gravado;
+    }
+    if (!gravado)
+        fprintf(stderr, "Nao foi possivel gravar %s; o ajuste sera refeito na proxima execucao\n",
+                perfilBlocos());
+}
+
+/* define o formato dos blocos antes de um preenchimento: o da opcao -y, o do
+   perfil gravado, o do ajuste (pedido com -u ou, sem perfil, num alinhamento
+   grande) ou, ate la, o padrao */
+void escolheBlocos(void) {
+    if (formatoFixado || blocosEscolhidos)
+        return;
+    if (!reajustaBlocos && lePerfilBlocos()) {
+        blocosEscolhidos = 1;
+        return;
+    }
+    if (reajustaBlocos || ((double)tamSeqMenor * tamSeqMaior >= CELULAS_AJUSTE)) {
+        ajustaBlocos();
+        blocosEscolhidos = 1;
+    }
+}
+
+/* Arquivo binario da matriz de escores (matriz_escores.bin), gravado apos o
+   preenchimento no modo da matriz. Ao contrario do texto, que formata cada
+   celula, o arquivo sai em escritas grandes e sequenciais e pode ser mapeado
+   de volta na memoria (opcao -r). O layout, em little-endian, eh:
+
+     cabecalho   BYTES_CABECALHO_MATRIZ bytes: CabecalhoMatriz e zeros
+     linhas      linhas x bytesLinha bytes; cada linha tem as colunas celulas
+                 de bytesCelula bytes (int16 se todos os escores possiveis
+                 cabem em 16 bits, int32 senao), completadas com zeros ate um
+                 multiplo de 64 bytes
+     somas       se SOMAS_POR_LINHA, uma soma de verificacao de 64 bits por
+                 linha, no estilo de Fletcher: s1 acumula as palavras de 32
+                 bits da linha e s2 acumula s1, com s2 na metade alta
+
+   Com celulas de 32 bits, as linhas ficam com o mesmo passo da matriz na
+   memoria, e o mapeamento do arquivo eh usado diretamente como matriz. */
+
+#define ASSINATURA_MATRIZ      "NWESCOR1"
+#define BYTES_CABECALHO_MATRIZ 256
+#define SOMAS_POR_LINHA        1 // flag: ha somas de verificacao por linha
+#define BYTES_ESCRITA_MATRIZ   (4<<20)
+
+typedef struct {
+  char assinatura[8];
+  uint32_t bytesCabecalho;   /* deslocamento da linha 0 */
+  uint32_t bytesCelula;      /* 2 ou 4 */
+  uint32_t linhas, colunas;  /* tamSeqMenor+1 e tamSeqMaior+1 */
+  uint64_t bytesLinha;       /* passo entre linhas, multiplo de 64 */
+  uint32_t flags;
+  int32_t penalGap, penalAbre;
+  int32_t pesos[16];         /* matrizPesos, linha a linha */
+  uint64_t hashMaior, hashMenor; /* FNV-1a das bases de cada sequencia */
+  int32_t PMaior, linPMaior, colPMaior, UMaior, linUMaior, colUMaior;
+} CabecalhoMatriz;
+
+int exportaTexto=0;           /* grava tambem matriz_escores.txt (opcao -t) */
+char *arquivoReaproveitado=NULL; /* matriz binaria a mapear em vez de preencher (opcao -r) */
+
+/* FNV-1a de 64 bits das n primeiras bases de uma sequencia compactada */
+uint64_t hashSequencia(const SeqCompacta *s, int n)
+{ uint64_t h=0xcbf29ce484222325ULL, palavra;
+  size_t i, nPalavras=PALAVRAS_BASES(n);
+  int k;
+
+  for (i=0; i<nPalavras; i++)
+  {
+    palavra=s->bases[i];
+    if ((i==nPalavras-1)&&(n%32!=0))
+      palavra&=((uint64_t)1<<(2*(n%32)))-1; // so as bases da sequencia
+    for (k=0; k<8; k++)
+    {
+      h^=(palavra>>(8*k))&0xFF;
+      h*=0x100000001b3ULL;
+    }
+  }
+  return h^(uint64_t)n;
+}
+
+/* soma de verificacao de uma linha de n bytes (n multiplo de 4) */
+uint64_t somaLinha(const void *linha, size_t n)
+{ const uint32_t *p=(const uint32_t*)linha;
+  uint64_t s1=0, s2=0;
+  size_t i;
+
+  for (i=0; i<n/4; i++)
+  {
+    s1+=p[i];
+    s2+=s1;
+  }
+  return (s2<<32)^(s1&0xFFFFFFFFULL);
+}
+
+/* bytes por celula do arquivo: 2 se nenhum escore da matriz pode passar de 16
+   bits, pelo limite de (tamSeqMaior+tamSeqMenor) passos do maior peso ou da
+   maior penalidade, mais uma abertura de gap por passo */
+int bytesCelulaMatriz(void)
+{ long long limite, passo=penalGap+penalAbre;
+  int i, j;
+
+  for (i=0; i<4; i++)
+    for (j=0; j<4; j++)
+      if (llabs(matrizPesos[i][j])>passo)
+        passo=llabs(matrizPesos[i][j]);
+  limite=((long long)tamSeqMaior+tamSeqMenor)*passo;
+  return (limite<=INT16_MAX) ? 2 : 4;
+}
+
+/* cabecalho da matriz atual */
+void montaCabecalhoMatriz(CabecalhoMatriz *cab)
+{ int i, j;
+
+  memset(cab, 0, sizeof(CabecalhoMatriz));
+  memcpy(cab->assinatura, ASSINATURA_MATRIZ, 8);
+  cab->bytesCabecalho=BYTES_CABECALHO_MATRIZ;
+  cab->bytesCelula=bytesCelulaMatriz();
+  cab->linhas=tamSeqMenor+1;
+  cab->colunas=tamSeqMaior+1;
+  cab->bytesLinha=(((uint64_t)cab->colunas*cab->bytesCelula+63)/64)*64;
+  cab->flags=SOMAS_POR_LINHA;
+  cab->penalGap=penalGap;
+  cab->penalAbre=penalAbre;
+  for (i=0; i<4; i++)
+    for (j=0; j<4; j++)
+      cab->pesos[4*i+j]=matrizPesos[i][j];
+  cab->hashMaior=hashSequencia(&seqMaior, tamSeqMaior);
+  cab->hashMenor=hashSequencia(&seqMenor, tamSeqMenor);
+  cab->PMaior=PMaior;
+  cab->linPMaior=linPMaior;
+  cab->colPMaior=colPMaior;
+  cab->UMaior=UMaior;
+  cab->linUMaior=linUMaior;
+  cab->colUMaior=colUMaior;
+}
+
+/* grava todos os n bytes de buf em fd. Retorna 0 em caso de erro. */
+int gravaTudo(int fd, const void *buf, size_t n)
+{ const char *p=(const char*)buf;
+  ssize_t gravados;
+
+  while (n>0)
+  {
+    gravados=write(fd, p, n);
+    if (gravados<=0)
+      return 0;
+    p+=gravados;
+    n-=(size_t)gravados;
+  }
+  return 1;
+}
+
+/* copia uma linha da matriz para dest no formato do arquivo, com os zeros do
+   final, e retorna a sua soma de verificacao */
+uint64_t empacotaLinha(const CabecalhoMatriz *cab, const int *linha, char *dest)
+{ int16_t *linha16;
+  int col;
+
+  memset(dest+(size_t)cab->colunas*cab->bytesCelula, 0, cab->bytesLinha-(size_t)cab->colunas*cab->bytesCelula);
+  if (cab->bytesCelula==4)
+    memcpy(dest, linha, (size_t)cab->colunas*4);
+  else
+  {
+    linha16=(int16_t*)dest;
+    for (col=0; col<(int)cab->colunas; col++)
+      linha16[col]=(int16_t)linha[col];
+  }
+  return somaLinha(dest, cab->bytesLinha);
+}
+
+/* grava a matriz de escores no formato binario, acumulando as linhas em um
+   buffer de BYTES_ESCRITA_MATRIZ bytes para escrever em blocos grandes. O
+   arquivo eh escrito com outro nome e renomeado no fim, para nao truncar um
+   arquivo que ainda esteja mapeado como matriz. A matriz compacta eh gravada
+   no mesmo formato, descompactada linha a linha. */
+void salvaMatrizBinaria(const char *nomeArquivo)
+{ CabecalhoMatriz cab;
+  char cabecalho[BYTES_CABECALHO_MATRIZ], *buf, temporario[1024];
+  uint64_t *somas;
+  size_t usados=0, bytesBuf;
+  int fd, lin, ok, *linha;
+  double inicio=tempoAtual();
+
+  if ((matrizEscores==NULL)&&(compacta.ancoras==NULL))
+    return;
+
+  montaCabecalhoMatriz(&cab);
+  memset(cabecalho, 0, sizeof(cabecalho));
+  memcpy(cabecalho, &cab, sizeof(cab));
+  bytesBuf=(cab.bytesLinha>BYTES_ESCRITA_MATRIZ) ? cab.bytesLinha : BYTES_ESCRITA_MATRIZ;
+  buf=malloc(bytesBuf);
+  somas=malloc((size_t)cab.linhas*sizeof(uint64_t));
+  linha=malloc((size_t)cab.colunas*sizeof(int));
+  snprintf(temporario, sizeof(temporario), "%s.tmp", nomeArquivo);
+  fd=open(temporario, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+  if ((buf==NULL)||(somas==NULL)||(linha==NULL)||(fd<0))
+  {
+    printf("\nErro ao gravar o arquivo %s\n", nomeArquivo);
+    free(buf);
+    free(somas);
+    free(linha);
+    if (fd>=0)
+      close(fd);
+    return;
+  }
+
+  ok=gravaTudo(fd, cabecalho, sizeof(cabecalho));
+  for (lin=0; ok&&(lin<=tamSeqMenor); lin++)
+  {
+    if (usados+cab.bytesLinha>bytesBuf)
+    {
+      ok=gravaTudo(fd, buf, usados);
+      usados=0;
+    }
+    somas[lin]=empacotaLinha(&cab, linhaEscores(lin, linha), buf+usados);
+    usados+=cab.bytesLinha;
+  }
+  if (ok)
+    ok=gravaTudo(fd, buf, usados)&&gravaTudo(fd, somas, (size_t)cab.linhas*sizeof(uint64_t));
+  if (close(fd)!=0)
+    ok=0;
+  if (ok&&(rename(temporario, nomeArquivo)!=0))
+    ok=0;
+  if (!ok)
+    unlink(temporario);
+  free(buf);
+  free(somas);
+  free(linha);
+
+  if (!ok)
+    printf("\nErro ao gravar o arquivo %s\n", nomeArquivo);
+  else
+    printf("Matriz de escores salva no arquivo '%s' (%.1f MB, celulas de %d bits, %.3f s)\n", nomeArquivo,
+           (BYTES_CABECALHO_MATRIZ+(double)cab.linhas*(cab.bytesLinha+8))/1e6, 8*cab.bytesCelula,
+           tempoAtual()-inicio);
+}
+
+/* thread de gravacao em segundo plano: espera as linhas ficarem prontas,
+   copia-as para o buffer, que eh gravado cada vez que enche, e grava as somas
+   no fim. O cabecalho depende dos maiores escores, conhecidos so depois do
+   preenchimento, e eh gravado por ultimo, no inicio do arquivo. */
+void* escritorMatriz(void* arg)
+{ CabecalhoMatriz *cab=(CabecalhoMatriz*)arg;
+  char cabecalho[BYTES_CABECALHO_MATRIZ], *buf, temporario[1024+8];
+  uint64_t *somas;
+  size_t usados=0, bytesBuf;
+  int fd, lin=0, prontas, ok;
+
+  memset(cabecalho, 0, sizeof(cabecalho));
+  bytesBuf=(cab->bytesLinha>BYTES_ESCRITA_MATRIZ) ? cab->bytesLinha : BYTES_ESCRITA_MATRIZ;
+  buf=malloc(bytesBuf);
+  somas=malloc((size_t)cab->linhas*sizeof(uint64_t));
+  snprintf(temporario, sizeof(temporario), "%s.tmp", escritor.nome);
+  fd=open(temporario, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+  ok=(buf!=NULL)&&(somas!=NULL)&&(fd>=0)&&gravaTudo(fd, cabecalho, sizeof(cabecalho));
+
+  while (ok&&(lin<(int)cab->linhas))
+  {
+    pthread_mutex_lock(&escritor.mutex);
+    while (escritor.linhasProntas<=lin)
+      pthread_cond_wait(&escritor.mudou, &escritor.mutex);
+    prontas=escritor.linhasProntas;
+    pthread_mutex_unlock(&escritor.mutex);
+
+    for (; ok&&(lin<prontas); lin++)
+    {
+      if (usados+cab->bytesLinha>bytesBuf)
+      {
+        ok=gravaTudo(fd, buf, usados);
+        usados=0;
+      }
+      somas[lin]=empacotaLinha(cab, matrizEscores[lin], buf+usados);
+      usados+=cab->bytesLinha;
+    }
+  }
+  if (ok)
+    ok=gravaTudo(fd, buf, usados)&&gravaTudo(fd, somas, (size_t)cab->linhas*sizeof(uint64_t));
+
+  pthread_mutex_lock(&escritor.mutex);
+  while (!escritor.preenchida)
+    pthread_cond_wait(&escritor.mudou, &escritor.mutex);
+  cab->PMaior=escritor.PMaior;
+  cab->linPMaior=escritor.linPMaior;
+  cab->colPMaior=escritor.colPMaior;
+  cab->UMaior=escritor.UMaior;
+  cab->linUMaior=escritor.linUMaior;
+  cab->colUMaior=escritor.colUMaior;
+  pthread_mutex_unlock(&escritor.mutex);
+  memcpy(cabecalho, cab, sizeof(CabecalhoMatriz));
+  if (ok)
+    ok=(pwrite(fd, cabecalho, sizeof(cabecalho), 0)==(ssize_t)sizeof(cabecalho));
+
+  if ((fd>=0)&&(close(fd)!=0))
+    ok=0;
+  if (ok&&(rename(temporario, escritor.nome)!=0))
+    ok=0;
+  if (!ok&&(fd>=0))
+    unlink(temporario);
+  free(buf);
+  free(somas);
+  free(cab);
+  escritor.ok=ok;
+  escritor.fim=tempoAtual();
+  pthread_exit(NULL);
+}
+
+/* inicia a gravacao da matriz em segundo plano, com a linha 0 ja pronta.
+   Retorna 0 se a thread nao puder ser criada. */
+int iniciaEscritor(const char *nomeArquivo)
+{ CabecalhoMatriz *cab=malloc(sizeof(CabecalhoMatriz));
+
+  if (cab==NULL)
+    return 0;
+  montaCabecalhoMatriz(cab);
+  snprintf(escritor.nome, sizeof(escritor.nome), "%s", nomeArquivo);
+  escritor.linhasProntas=1;
+  escritor.preenchida=0;
+  escritor.ok=0;
+  escritor.inicio=tempoAtual();
+  pthread_mutex_init(&escritor.mutex, NULL);
+  pthread_cond_init(&escritor.mudou, NULL);
+  if (pthread_create(&escritor.thread, NULL, escritorMatriz, cab)!=0)
+  {
+    pthread_cond_destroy(&escritor.mudou);
+    pthread_mutex_destroy(&escritor.mutex);
+    free(cab);
+    return 0;
+  }
+  escritor.ativo=1;
+  printf("\nGravando a matriz de escores no arquivo '%s' em segundo plano.", nomeArquivo);
+  return 1;
+}
+
+/* informa a thread de gravacao de que o preenchimento terminou, com os
+   maiores escores que vao no cabecalho */
+void concluiEscritor(void)
+{
+  if (!escritor.ativo)
+    return;
+  pthread_mutex_lock(&escritor.mutex);
+  escritor.linhasProntas=tamSeqMenor+1;
+  escritor.PMaior=PMaior;
+  escritor.linPMaior=linPMaior;
+  escritor.colPMaior=colPMaior;
+  escritor.UMaior=UMaior;
+  escritor.linUMaior=linUMaior;
+  escritor.colUMaior=colUMaior;
+  escritor.fimPreenchimento=tempoAtual();
+  escritor.preenchida=1;
+  pthread_cond_signal(&escritor.mudou);
+  pthread_mutex_unlock(&escritor.mutex);
+}
+
+/* mapeia um arquivo binario de matriz de escores como a matriz atual, se ele
+   foi gravado para as mesmas sequencias, pesos e penalidades. Com celulas de
+   32 bits, as linhas da matriz apontam para o proprio mapeamento (privado, de
+   modo que um preenchimento posterior nao altera o arquivo); com 16 bits, os
+   escores sao convertidos para uma matriz alocada. Retorna 0 se o arquivo nao
+   servir. */
+int carregaMatrizBinaria(const char *nomeArquivo)
+{ CabecalhoMatriz cab, atual;
+  struct stat info;
+  const uint64_t *somas;
+  const int16_t *linha16;
+  char *mapa;
+  size_t tamEsperado;
+  int fd, lin, col;
+
+  fd=open(nomeArquivo, O_RDONLY);
+  if ((fd<0)||(fstat(fd, &info)!=0)||((size_t)info.st_size<BYTES_CABECALHO_MATRIZ))
+  {
+    printf("\nArquivo de matriz %s ausente ou invalido\n", nomeArquivo);
+    if (fd>=0)
+      close(fd);
+    return 0;
+  }
+  mapa=mmap(NULL, (size_t)info.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapa==MAP_FAILED)
+  {
+    printf("\nErro ao mapear o arquivo %s\n", nomeArquivo);
+    return 0;
+  }
+
+  memcpy(&cab, mapa, sizeof(cab));
+  montaCabecalhoMatriz(&atual);
+  tamEsperado=(size_t)cab.bytesCabecalho+(size_t)cab.linhas*cab.bytesLinha+
+              ((cab.flags&SOMAS_POR_LINHA) ? (size_t)cab.linhas*sizeof(uint64_t) : 0);
+  if ((memcmp(cab.assinatura, ASSINATURA_MATRIZ, 8)!=0)||((size_t)info.st_size<tamEsperado)||
+      ((cab.bytesCelula!=2)&&(cab.bytesCelula!=4))||(cab.bytesCabecalho%64!=0)||(cab.bytesLinha%64!=0)||
+      (cab.bytesLinha<(uint64_t)cab.colunas*cab.bytesCelula))
+  {
+    printf("\nArquivo %s nao eh uma matriz de escores valida\n", nomeArquivo);
+    munmap(mapa, (size_t)info.st_size);
+    return 0;
+  }
+  if ((cab.linhas!=atual.linhas)||(cab.colunas!=atual.colunas)||(cab.penalGap!=atual.penalGap)||
+      (cab.penalAbre!=atual.penalAbre)||(memcmp(cab.pesos, atual.pesos, sizeof(cab.pesos))!=0)||
+      (cab.hashMaior!=atual.hashMaior)||(cab.hashMenor!=atual.hashMenor))
+  {
+    printf("\nA matriz do arquivo %s foi gerada para outras sequencias ou parametros\n", nomeArquivo);
+    munmap(mapa, (size_t)info.st_size);
+    return 0;
+  }
+  if (cab.flags&SOMAS_POR_LINHA)
+  {
+    somas=(const uint64_t*)(mapa+cab.bytesCabecalho+(size_t)cab.linhas*cab.bytesLinha);
+    for (lin=0; lin<(int)cab.linhas; lin++)
+      if (somaLinha(mapa+cab.bytesCabecalho+(size_t)lin*cab.bytesLinha, cab.bytesLinha)!=somas[lin])
+      {
+        printf("\nLinha %d da matriz do arquivo %s corrompida\n", lin, nomeArquivo);
+        munmap(mapa, (size_t)info.st_size);
+        return 0;
+      }
+  }
+
+  liberaMatrizEscores();
+  if (cab.bytesCelula==4)
+  {
+    matrizEscores=malloc((size_t)cab.linhas*sizeof(int*));
+    if (matrizEscores==NULL)
+    {
+      munmap(mapa, (size_t)info.st_size);
+      return 0;
+    }
+    for (lin=0; lin<(int)cab.linhas; lin++)
+      matrizEscores[lin]=(int*)(mapa+cab.bytesCabecalho+(size_t)lin*cab.bytesLinha);
+    passoLinha=(int)(cab.bytesLinha/sizeof(int));
+    linMatriz=cab.linhas;
+    colMatriz=cab.colunas;
+    mapaMatriz=mapa;
+    tamMapaMatriz=(size_t)info.st_size;
+  }
+  else
+  {
+    if (!alocaMatrizEscores())
+    {
+      munmap(mapa, (size_t)info.st_size);
+      return 0;
+    }
+    for (lin=0; lin<(int)cab.linhas; lin++)
+    {
+      linha16=(const int16_t*)(mapa+cab.bytesCabecalho+(size_t)lin*cab.bytesLinha);
+      for (col=0; col<(int)cab.colunas; col++)
+        matrizEscores[lin][col]=linha16[col];
+    }
+    munmap(mapa, (size_t)info.st_size);
+  }
+
+  PMaior=cab.PMaior;
+  linPMaior=cab.linPMaior;
+  colPMaior=cab.colPMaior;
+  UMaior=cab.UMaior;
+  linUMaior=cab.linUMaior;
+  colUMaior=cab.colUMaior;
+  printf("\nMatriz de escores carregada do arquivo '%s' (celulas de %d bits).", nomeArquivo, 8*cab.bytesCelula);
+  printf("\nPrimeiro Maior escore = %d na celula [%d,%d]", PMaior, linPMaior, colPMaior);
+  printf("\nUltimo Maior escore = %d na celula [%d,%d]\n", UMaior, linUMaior, colUMaior);
+  return 1;
+}
+
+/* largura das colunas da matriz em texto: 4, como no formato original, ou a
+   necessaria para que escores de mais digitos nao se juntem */
+int larguraEscores(int *buf)
+{ int lin, col, menor=0, maior=tamSeqMaior, largura=4;
+  const int *linha;
+  char texto[16];
+
+  for (lin=0; lin<=tamSeqMenor; lin++)
+  {
+    linha=linhaEscores(lin, buf);
+    for (col=0; col<=tamSeqMaior; col++)
+    {
+      if (linha[col]<menor) menor=linha[col];
+      if (linha[col]>maior) maior=linha[col];
+    }
+  }
+  if (snprintf(texto, sizeof(texto), "%d", menor)>=largura)
+    largura=(int)strlen(texto)+1;
+  if (snprintf(texto, sizeof(texto), "%d", maior)>=largura)
+    largura=(int)strlen(texto)+1;
+  return largura;
+}
+
+/* exporta a matriz de escores, completa ou compacta, em texto (opcao -t) */
+void salvaMatrizEmArquivo(const char* nomeArquivo) {
+    int w, *buf;
+    const int *linha;
+
+    if ((matrizEscores == NULL) && (compacta.ancoras == NULL))
+        return;
+    buf = malloc(((size_t)tamSeqMaior + 1) * sizeof(int));
+    w = larguraEscores(buf);
+
+    FILE* arquivo = fopen(nomeArquivo, "w");
+    if (arquivo == NULL) {
+        perror("Erro ao abrir o arquivo");
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(arquivo, "Matriz de escores Atual:\n");
+
+    fprintf(arquivo, "%*c%*c", w, ' ', w, ' ');
+    for (int i = 0; i <= tamSeqMaior; i++) {
+        fprintf(arquivo, "%*d", w, i);
+    }
+    fprintf(arquivo, "\n");
+
+    fprintf(arquivo, "%*c%*c%*c", w, ' ', w, ' ', w, '-');
+    for (int i = 0; i < tamSeqMaior; i++) {
+        fprintf(arquivo, "%*c", w, mapaBases[baseEm(&seqMaior, i)]);
+    }
+    fprintf(arquivo, "\n");
+
+    fprintf(arquivo, "%*c%*c", w, '0', w, '-');
+    linha = linhaEscores(0, buf);
+    for (int col = 0; col <= tamSeqMaior; col++) {
+        fprintf(arquivo, "%*d", w, linha[col]);
+    }
+    fprintf(arquivo, "\n");
+
+    for (int lin = 1; lin <= tamSeqMenor; lin++) {
+        fprintf(arquivo, "%*d%*c", w, lin, w, mapaBases[baseEm(&seqMenor, lin - 1)]);
+        linha = linhaEscores(lin, buf);
+        for (int col = 0; col <= tamSeqMaior; col++) {
+            fprintf(arquivo, "%*d", w, linha[col]);
+        }
+        fprintf(arquivo, "\n");
+    }
+
+    fclose(arquivo);
+    free(buf);
+    printf("Matriz de scores salva no arquivo '%s'\n", nomeArquivo);
+}
+
+/* imprime a matriz de escores de acordo */
+void mostraMatrizEscores()
+{ int i, lin, col, *buf;
+  const int *linha;
+
+  if ((matrizEscores==NULL)&&(compacta.ancoras==NULL))
+  {
+    if (matrizDirecoes!=NULL)
+      printf("\nMatriz de escores nao guardada no modo de direcoes (-d).\n");
+    else if (modoPreenchimento==MODO_ESCORE)
+      printf("\nMatriz de escores nao guardada no modo so escore (-e).\n");
+    else if (linhasControle!=NULL)
+      printf("\nMatriz de escores nao guardada no modo de linhas de controle (-c).\n");
+    else
+      printf("\nMatriz de escores ainda nao gerada.\n");
+    return;
+  }
+
+  printf("\nMatriz de escores Atual:\n");
+
+  printf("%4c%4c",' ',' ');
+  for (i=0; i<=tamSeqMaior; i++)
+    printf("%4d",i);
+  printf("\n");
+
+  printf("%4c%4c%4c",' ',' ','-');
+  for (i=0; i<tamSeqMaior; i++)
+    printf("%4c",mapaBases[baseEm(&seqMaior,i)]);
+  printf("\n");
+
+  buf=malloc(((size_t)tamSeqMaior+1)*sizeof(int));
+  printf("%4c%4c",'0','-');
+  linha=linhaEscores(0,buf);
+  for (col=0; col<=tamSeqMaior; col++)
+    printf("%4d",linha[col]);
+  printf("\n");
+
+  for (lin=1;lin<=tamSeqMenor;lin++)
+  {
+    printf("%4d%4c",lin,mapaBases[baseEm(&seqMenor,lin-1)]);
+    linha=linhaEscores(lin,buf);
+    for (col=0;col<=tamSeqMaior;col++)
+    {
+      printf("%4d",linha[col]);
+    }
+    printf("\n");
+  }
+  free(buf);
+}
+
+
+/* mostra os alinhamentos */
+void mostraAlinhamentoGlobal(void)
+{   int i;
+
+  if (alinhaGMaior.bases==NULL)
+  {
+    printf("\nAlinhamento Global ainda nao gerado.\n");
+    return;
+  }
+
+  printf("\nAlinhamento Obtido - Tamanho = %d:\n", tamAlinha);
+
+  printf("%c",mapaBases[baseEm(&alinhaGMaior,0)]);
+  for (i=1; i<tamAlinha; i++)
+    printf("%c",mapaBases[baseEm(&alinhaGMaior,i)]);
+  printf("\n");
+
+  printf("%c",mapaBases[baseEm(&alinhaGMenor,0)]);
+  for (i=1; i<tamAlinha; i++)
+    printf("%c",mapaBases[baseEm(&alinhaGMenor,i)]);
   printf("\n");
+}
+
+/* gera o alinhamento global por meio do percurso de retorno na Matriz de escores,
+   em duas formas possiveis, conforme o parametro tipo: 1) a partir da celula do
+   primeiro maior escore [linPMaior,colPMaior] ou 2) a partir da celula de ultimo
+   maior escore [linUMaior,colUMaior], ambos em direcao a celula inicial [0,0],
+   uma celula por vez. O caminho de retorno deve ser feito seguindo o mesmo caminho
+   inverso que gerou a celular final a partir da celula inicial. O alinhamento
+   global eh composto por duas sequencias alinhaGMenor e alinhaGMaior.
+
+   Note que outros alinhamentos globais podem ser encontrados se o percurso do
+   traceback for ramificado em celulas que foram "escoreadas/pontuadas" por meio
+   de uma estrategia de desempate, pelo fato de ter havido empate na pontuacao
+   dos nohs vizinhos. Alem disso, alinhamentos parciais tambem podem ser obtidos
+   com traceback iniciado a partir de qualquer c�lula */
+
+int k = 1;  // Número de alinhamentos que o usuário deseja gerar
+int desempateFixo = 0; // direcao preferida nos empates (opcao -x): 0 diagonal, 1 cima, 2 esquerda
+int alinhaEmColunas = 1; // 0 = o traceback gera so as operacoes, sem expandi-las em colunas
+typedef struct {
+    SeqCompacta alinhaGMaior; // tamSeqMaior+tamSeqMenor posicoes, se alinhaEmColunas
+    SeqCompacta alinhaGMenor;
+    int tamAlinha;
+    Cigar cigar;              // o alinhamento em operacoes, escrito pelo traceback
+} Alinhamento;
+
+Alinhamento *resultados = NULL; // os thread_count alinhamentos do ultimo traceback, em ordem
+int thread_count = 0;
+
+int **linhasFaixa = NULL; // escores da faixa atual no modo de linhas de controle
+
+/* direcoes de onde pode ter vindo o escore da celula [lin,col], lin,col >= 1:
+   lidas da matriz de direcoes, se o preenchimento a gravou, ou recalculadas a
+   partir dos escores vizinhos, da matriz, da matriz compacta ou da faixa
+   recalculada. Com gaps
+   afins, a matriz de direcoes sempre existe e tem um byte por celula, com os
+   bits de extensao dos gaps. */
+int direcoesCelula(int lin, int col) {
+    size_t i;
+    int peso, **m;
+
+    if ((matrizDirecoes != NULL) && (penalAbre > 0))
+        return matrizDirecoes[(size_t)(lin - 1) * passoDirecoes + (col - 1)];
+    if (matrizDirecoes != NULL) {
+        i = (size_t)(lin - 1) * passoDirecoes + (col - 1) / 2;
+        return (matrizDirecoes[i] >> (4 * ((col - 1) & 1))) & 0xF;
+    }
+    peso = matrizPesos[baseEm(&seqMenor, lin-1)][baseEm(&seqMaior, col-1)];
+    if (compacta.ancoras != NULL)
+        return codigoDirecao(escoreCompacto(lin, col), escoreCompacto(lin-1, col-1) + peso,
+                             escoreCompacto(lin, col-1) - penalGap, escoreCompacto(lin-1, col) - penalGap);
+    m = (matrizEscores != NULL) ? matrizEscores : linhasFaixa;
+    return codigoDirecao(m[lin][col], m[lin-1][col-1] + peso, m[lin][col-1] - penalGap, m[lin-1][col] - penalGap);
+}
+
+/* Rastro do traceback (opcao -v). Em vez de escrever cada passo na saida, cada
+   caminho registra seus passos num anel proprio de eventos de 64 bits, sem
+   trava e sem E/S durante o percurso: so a thread que percorre o caminho
+   escreve no anel, e ele eh lido depois que todos os caminhos terminam. O anel
+   guarda os ultimos capRastro eventos de cada caminho. Desligado (capRastro =
+   0), o custo eh um teste por passo; ligado, uma escrita de 8 bytes.
+
+   Cada evento traz a celula de onde o passo saiu (30 bits para a linha e 30
+   para a coluna), o passo (DIR_DIAG, DIR_ESQ ou DIR_CIMA) e se a celula tinha
+   empate. */
+
+#define EVENTO_RASTRO(lin,col,passo,empate) \
+  (((uint64_t)(lin)<<34)|((uint64_t)(col)<<4)|((uint64_t)(empate)<<3)|(uint64_t)(passo))
+
+typedef struct {
+  uint64_t *eventos;  /* capRastro eventos */
+  uint64_t total;     /* eventos registrados, inclusive os ja sobrescritos */
+  uint64_t empates;
+} AnelRastro;
+
+int capRastro = 0;    /* eventos por caminho, potencia de 2; 0 = rastro desligado */
+
+static inline void registraRastro(AnelRastro *anel, uint64_t evento)
+{
+    anel->eventos[anel->total++ & (uint64_t)(capRastro - 1)] = evento;
+}
+
+/* Enumeracao dos alinhamentos otimos (opcao -q). Cada empate entre direcoes
+   (DIR_DIAG, DIR_ESQ, DIR_CIMA) numa celula fora de gap eh um ponto em que
+   caminhos otimos diferentes se separam; como cada direcao leva a uma
+   operacao diferente, dois caminhos que se separam num empate dao
+   alinhamentos diferentes. Com gaps afins, o passo de gap que sai de uma
+   celula com os bits de estender e de abrir o gap ligados tambem eh um empate:
+   estendido, o gap continua na celula seguinte; aberto, ele termina nela, que
+   entao nao pode seguir pelo mesmo gap (abrir a partir de um gap no mesmo
+   sentido custaria mais que estende-lo), e os alinhamentos tambem diferem.
+   Os caminhos sao ordenados pelas escolhas feitas nos
+   empates, do fim do alinhamento para o inicio, com a direcao preferida (-x)
+   antes das outras e as outras na ordem diagonal, cima, esquerda, e a
+   extensao do gap antes da abertura; os k
+   alinhamentos gerados sao os k primeiros dessa ordem (ou todos, se houver
+   menos), os mesmos a cada execucao e com qualquer numero de threads.
+
+   A lista de caminhos esta sempre nessa ordem. Um caminho segue sempre a
+   primeira escolha e guarda, num anel, as alternativas dos empates mais
+   fundos que ainda podem entrar entre os k primeiros; ao fim de cada rodada
+   (os caminhos ativos percorridos em paralelo, uma tarefa do pool cada), as
+   alternativas viram caminhos novos, inseridos logo apos o caminho que as
+   encontrou, do empate mais fundo para o mais raso, e a lista eh cortada em k.
+   Cada prefixo de escolhas eh percorrido por um unico caminho: o ramo comeca
+   na celula do empate, com uma copia das operacoes ja escritas pelo pai, e
+   nunca refaz o trecho comum. */
+
+typedef struct {
+    int tbLin, tbCol, pos;   // celula do empate e colunas ja escritas ate ela
+    int passo;               // a alternativa, forcada no primeiro passo do ramo; com
+                             // DIR_ESQ_ABRE ou DIR_CIMA_ABRE, o gap termina nele
+    int ini;                 // inicio das operacoes do pai na celula do empate
+    uint32_t primeira;       // ops[ini] do pai antes de ele a estender
+} Empate;
+
+typedef struct {
+    int tbLin, tbCol, pos, emGap; // ponto do percurso, para continua-lo na proxima faixa
+    int passoInicial;        // passo forcado na primeira celula (ramo de um empate), 0 = nenhum,
+                             // com o bit de abertura se o gap termina nele
+    int linMin;              // o percurso para ao chegar nesta linha (0 = ate o fim)
+    Empate *empates;         // anel das alternativas mais fundas
+    int capEmpates, maxEmpates, nEmpates;
+    AnelRastro anel;
+} Caminho;
+
+/* os caminhos ocupam capCaminhos posicoes (as mesmas de resultados); a lista
+   tem os nLista caminhos vivos, na ordem da enumeracao */
+Caminho *caminhos = NULL;
+int capCaminhos = 0;
+int *lista = NULL, nLista = 0;
+
+/* direcoes dos empates: a preferida e depois as demais, na ordem padrao */
+int ordemEmpate[3];
+
+/* guarda uma alternativa de empate no anel do caminho, que cresce ate
+   maxEmpates e entao sobrescreve as mais antigas (as mais rasas) */
+static void registraEmpate(Caminho *c, const Empate *e) {
+    Empate *novo;
+    int cap;
+
+    if ((c->nEmpates == c->capEmpates) && (c->capEmpates < c->maxEmpates)) {
+        cap = (c->capEmpates == 0) ? 16 : 2 * c->capEmpates;
+        if (cap > c->maxEmpates)
+            cap = c->maxEmpates;
+        novo = realloc(c->empates, (size_t)cap * sizeof(Empate));
+        if (novo != NULL) {
+            c->empates = novo;
+            c->capEmpates = cap;
+        }
+    }
+    if (c->capEmpates > 0)
+        c->empates[c->nEmpates++ % c->capEmpates] = *e;
+}
+
+void* traceBack(void* arg) {
+    Caminho* c = (Caminho*)arg;
+    int tbLin = c->tbLin;
+    int tbCol = c->tbCol;
+    int pos = c->pos;
+    int emGap = c->emGap;
+    int dir, origens, passo, empate, r, fecha, estende;
+    Empate alt;
+
+    Alinhamento* resultado = &resultados[c - caminhos];
+    AnelRastro* anel = (capRastro > 0) ? &c->anel : NULL;
+
+    while (tbLin > c->linMin && tbCol > 0) {
+        dir = direcoesCelula(tbLin, tbCol);
+
+        // Dentro de um gap afim, o passo segue o gap ate a celula em que ele foi
+        // aberto. Fora dele, com mais de uma direcao possivel (empate), segue a
+        // primeira na ordem dos empates e guarda as outras para os ramos
+        origens = dir & (DIR_DIAG | DIR_ESQ | DIR_CIMA);
+        empate = !emGap && ((origens & (origens - 1)) != 0);
+        fecha = 0;
+        if (c->passoInicial) {
+            passo = c->passoInicial & (DIR_DIAG | DIR_ESQ | DIR_CIMA);
+            fecha = c->passoInicial & (DIR_ESQ_ABRE | DIR_CIMA_ABRE);
+            c->passoInicial = 0;
+        } else if (emGap) {
+            passo = emGap;
+        } else if (empate) {
+            for (r = 0; !(origens & ordemEmpate[r]); r++)
+                ;
+            passo = ordemEmpate[r];
+            if (c->maxEmpates > 0) {
+                alt.tbLin = tbLin;
+                alt.tbCol = tbCol;
+                alt.pos = pos;
+                alt.ini = resultado->cigar.ini;
+                alt.primeira = (alt.ini < resultado->cigar.cap) ? resultado->cigar.ops[alt.ini] : 0;
+                // Da ultima para a primeira, para que a mais recente seja a da frente
+                for (int a = 2; a > r; a--)
+                    if (origens & ordemEmpate[a]) {
+                        alt.passo = ordemEmpate[a];
+                        registraEmpate(c, &alt);
+                    }
+            }
+        } else if (dir & DIR_DIAG) {
+            passo = DIR_DIAG;
+        } else if (dir & DIR_ESQ) {
+            passo = DIR_ESQ;
+        } else {
+            passo = DIR_CIMA;
+        }
+
+        // O gap continua na proxima celula se ele pode ser extensao do dela;
+        // se tambem pode ter sido aberto nela, a abertura fica para um ramo
+        if (passo == DIR_ESQ)
+            estende = (dir & DIR_ESQ_ESTENDE) ? ((dir & DIR_ESQ_ABRE) ? 2 : 1) : 0;
+        else if (passo == DIR_CIMA)
+            estende = (dir & DIR_CIMA_ESTENDE) ? ((dir & DIR_CIMA_ABRE) ? 2 : 1) : 0;
+        else
+            estende = 0;
+        if (fecha)
+            estende = 0;
+        if (estende == 2) {
+            empate = 1;
+            if (c->maxEmpates > 0) {
+                alt.tbLin = tbLin;
+                alt.tbCol = tbCol;
+                alt.pos = pos;
+                alt.ini = resultado->cigar.ini;
+                alt.primeira = (alt.ini < resultado->cigar.cap) ? resultado->cigar.ops[alt.ini] : 0;
+                alt.passo = passo | ((passo == DIR_ESQ) ? DIR_ESQ_ABRE : DIR_CIMA_ABRE);
+                registraEmpate(c, &alt);
+            }
+        }
+        if (anel != NULL) {
+            registraRastro(anel, EVENTO_RASTRO(tbLin, tbCol, passo, empate));
+            anel->empates += empate;
+        }
+
+        if (passo == DIR_DIAG) {
+            acrescentaOps(&resultado->cigar, (baseEm(&seqMenor, tbLin-1) == baseEm(&seqMaior, tbCol-1)) ? OP_IGUAL : OP_TROCA, 1);
+            tbLin--;
+            tbCol--;
+        } else if (passo == DIR_ESQ) {
+            acrescentaOps(&resultado->cigar, OP_REMOVE, 1);
+            tbCol--;
+        } else {
+            acrescentaOps(&resultado->cigar, OP_INSERE, 1);
+            tbLin--;
+        }
+
+        emGap = estende ? passo : 0;
+        pos++;
+    }
+
+    // Parado numa linha de controle, o percurso continua na faixa de cima
+    c->tbLin = tbLin;
+    c->tbCol = tbCol;
+    c->pos = pos;
+    c->emGap = emGap;
+    if (tbLin > 0 && tbCol > 0)
+        return NULL;
+
+    // Adicionar gaps restantes; as operacoes ja estao na ordem certa
+    if (tbLin > 0)
+        acrescentaOps(&resultado->cigar, OP_INSERE, tbLin);
+    if (tbCol > 0)
+        acrescentaOps(&resultado->cigar, OP_REMOVE, tbCol);
+    resultado->tamAlinha = pos + tbLin + tbCol;
+
+    return NULL;
+}
+
+/* prepara o caminho da posicao i para comecar na celula [lin,col] com a
+   coluna pos. Retorna 0 se nao houver memoria. */
+int iniciaCaminho(int i, int lin, int col, int pos) {
+    Caminho *c = &caminhos[i];
+
+    if (!redimensionaCigar(&resultados[i].cigar, tamSeqMaior + tamSeqMenor))
+        return 0;
+    if ((capRastro > 0) && (c->anel.eventos == NULL) &&
+        ((c->anel.eventos = malloc((size_t)capRastro * sizeof(uint64_t))) == NULL)) {
+        printf("\nMemoria insuficiente para o rastro do traceback\n");
+        capRastro = 0;
+    }
+    c->anel.total = 0;
+    c->anel.empates = 0;
+    c->tbLin = lin;
+    c->tbCol = col;
+    c->pos = pos;
+    c->emGap = 0;
+    c->passoInicial = 0;
+    c->nEmpates = 0;
+    return 1;
+}
+
+/* garante posicoes para n caminhos e para a lista. Retorna 0 se nao houver
+   memoria. */
+int alocaCaminhos(int n) {
+    Caminho *c;
+    Alinhamento *a;
+    int *l;
+
+    if (n <= capCaminhos)
+        return 1;
+    c = realloc(caminhos, (size_t)n * sizeof(Caminho));
+    if (c != NULL)
+        caminhos = c;
+    a = realloc(resultados, (size_t)n * sizeof(Alinhamento));
+    if (a != NULL)
+        resultados = a;
+    l = realloc(lista, (size_t)n * sizeof(int));
+    if (l != NULL)
+        lista = l;
+    if ((c == NULL) || (a == NULL) || (l == NULL))
+        return 0;
+    memset(caminhos + capCaminhos, 0, (size_t)(n - capCaminhos) * sizeof(Caminho));
+    memset(resultados + capCaminhos, 0, (size_t)(n - capCaminhos) * sizeof(Alinhamento));
+    capCaminhos = n;
+    return 1;
+}
+
+/* transforma as alternativas guardadas na ultima rodada em caminhos novos,
+   logo apos o caminho que as encontrou, e corta a lista nos k primeiros. As
+   posicoes dos caminhos cortados sao reaproveitadas pelos ramos. Retorna 0 se
+   nao houver memoria. */
+int ramificaCaminhos(void) {
+    int *pai = malloc((size_t)k * sizeof(int));
+    Empate **ramo = malloc((size_t)k * sizeof(Empate*));
+    char *usado = calloc((size_t)capCaminhos, 1);
+    int i, j, n = 0, livre = 0, ok = (pai != NULL) && (ramo != NULL) && (usado != NULL);
+
+    for (i = 0; ok && (i < nLista) && (n < k); i++) {
+        Caminho *c = &caminhos[lista[i]];
+
+        pai[n] = lista[i];
+        ramo[n++] = NULL;
+        usado[lista[i]] = 1;
+        // Do mais recente (o empate mais fundo) para o mais antigo ainda no anel
+        for (j = c->nEmpates - 1; (j >= 0) && (j >= c->nEmpates - c->capEmpates) && (n < k); j--) {
+            pai[n] = lista[i];
+            ramo[n++] = &c->empates[j % c->capEmpates];
+        }
+    }
+
+    for (i = 0; ok && (i < n); i++) {
+        if (ramo[i] == NULL) {
+            lista[i] = pai[i];
+            continue;
+        }
+        while (usado[livre])
+            livre++;
+        usado[livre] = 1;
+        lista[i] = livre;
+        if (!iniciaCaminho(livre, ramo[i]->tbLin, ramo[i]->tbCol, ramo[i]->pos)) {
+            ok = 0;
+            break;
+        }
+
+        // O ramo herda as operacoes do pai ate o empate
+        Cigar *cp = &resultados[pai[i]].cigar, *cr = &resultados[livre].cigar;
+        int tam = cp->cap - ramo[i]->ini;
+
+        cr->ini = cr->cap - tam;
+        memcpy(cr->ops + cr->ini, cp->ops + ramo[i]->ini, (size_t)tam * sizeof(uint32_t));
+        if (tam > 0)
+            cr->ops[cr->ini] = ramo[i]->primeira;
+        caminhos[livre].passoInicial = ramo[i]->passo;
+    }
+    if (ok)
+        nLista = n;
+    for (i = 0; i < nLista; i++)
+        caminhos[lista[i]].nEmpates = 0;
+
+    free(pai);
+    free(ramo);
+    free(usado);
+    return ok;
+}
+
+/* percorre, em rodadas, os caminhos da lista ate todos terminarem ou pararem
+   na linha linMin. Retorna 0 se nao houver memoria para os ramos. */
+int percorreCaminhos(int linMin) {
+    GrupoTarefas grupo = {0};
+    int i, ativos;
+
+    do {
+        ativos = 0;
+        for (i = 0; i < nLista; i++) {
+            Caminho *c = &caminhos[lista[i]];
+
+            if ((c->tbLin > linMin) && (c->tbCol > 0)) {
+                c->linMin = linMin;
+                c->maxEmpates = k - 1 - i;
+                submeteTarefa(&grupo, traceBack, c);
+                ativos++;
+            }
+        }
+        aguardaGrupo(&grupo);
+        if ((ativos > 0) && !ramificaCaminhos())
+            return 0;
+    } while (ativos > 0);
+    return 1;
+}
+
+/* traceback no modo de linhas de controle: as faixas sao recalculadas de
+   baixo para cima, a de cima em paralelo com o percurso da atual. Retorna 0
+   se nao houver memoria para as faixas. O percurso parte da celula
+   [linIni,colIni]. */
+int percorreFaixas(int linIni, int colIni) {
+    FaixaControle faixas[2];
+    GrupoTarefas auxiliar = {0};
+    int i, j, atual = 0, colFim = colIni, ok = 1;
+
+    for (i = 0; i < 2; i++) {
+        faixas[i].escores = malloc((size_t)passoControle * larguraControle * sizeof(int));
+        faixas[i].linhas = malloc(((size_t)passoControle + 1) * sizeof(int*));
+        faixas[i].area = malloc(BYTES_AREA_SIMD + 64);
+        ok = ok && (faixas[i].escores != NULL) && (faixas[i].linhas != NULL) && (faixas[i].area != NULL);
+    }
+
+    // A primeira faixa so precisa ir ate a celula inicial
+    j = (linIni - 1) / passoControle;
+    faixas[0].lin0 = j * passoControle;
+    faixas[0].lin1 = linIni;
+    faixas[0].colFim = colFim;
+    if (ok)
+        recalculaFaixa(&faixas[0]);
+
+    for (; ok && (j >= 0); j--) {
+        // Os caminhos so andam para a esquerda, entao a coluna mais a direita
+        // ocupada agora limita tambem a faixa de cima
+        if (j > 0) {
+            faixas[1 - atual].lin0 = (j - 1) * passoControle;
+            faixas[1 - atual].lin1 = j * passoControle;
+            faixas[1 - atual].colFim = colFim;
+            submeteTarefa(&auxiliar, recalculaFaixaThread, &faixas[1 - atual]);
+        }
+        linhasFaixa = faixas[atual].m;
+        ok = percorreCaminhos(j * passoControle);
+        aguardaGrupo(&auxiliar);
+
+        colFim = 0;
+        for (i = 0; i < nLista; i++)
+            if ((caminhos[lista[i]].tbLin > 0) && (caminhos[lista[i]].tbCol > colFim))
+                colFim = caminhos[lista[i]].tbCol;
+        if (colFim == 0)
+            break;
+        atual = 1 - atual;
+    }
+    linhasFaixa = NULL;
+
+    for (i = 0; i < 2; i++) {
+        free(faixas[i].escores);
+        free(faixas[i].linhas);
+        free(faixas[i].area);
+    }
+    if (!ok)
+        printf("\nMemoria insuficiente para as faixas do traceback\n");
+    return ok;
+}
+
+#define ARQUIVO_RASTRO "rastro_traceback.txt"
+
+FILE *arqRastro = NULL;   /* aberto no primeiro traceback com rastro */
+int numRastros = 0;
+
+/* decodifica os aneis dos n primeiros caminhos em ARQUIVO_RASTRO, do evento
+   mais antigo ainda guardado ao mais recente, com as mesmas mensagens que o
+   traceback escrevia a cada passo, e mostra um resumo por caminho. O anel de
+   um ramo comeca na celula do empate. Os tracebacks de uma mesma execucao (os
+   pares de -j, por exemplo) vao um apos o outro. */
+void decodificaRastro(int n) {
+    uint64_t e, ini;
+    int passo, empate;
+
+    if ((arqRastro == NULL) && ((arqRastro = fopen(ARQUIVO_RASTRO, "w")) == NULL)) {
+        perror("Erro ao abrir o arquivo do rastro");
+        return;
+    }
+    fprintf(arqRastro, "Traceback %d\n", ++numRastros);
+    for (int i = 0; i < n; i++) {
+        AnelRastro *anel = &caminhos[i].anel;
+
+        ini = (anel->total > (uint64_t)capRastro) ? anel->total - capRastro : 0;
+        printf("Rastro do caminho %d: %llu passos, %llu empates", i + 1, (unsigned long long)anel->total,
+               (unsigned long long)anel->empates);
+        if (ini > 0)
+            printf(" (guardados os ultimos %d)", capRastro);
+        printf("\n");
+        if (ini > 0)
+            fprintf(arqRastro, "Caminho %d: %llu passos anteriores nao guardados\n", i + 1, (unsigned long long)ini);
+        for (; ini < anel->total; ini++) {
+            e = anel->eventos[ini & (uint64_t)(capRastro - 1)];
+            passo = (int)(e & 7);
+            empate = (int)((e >> 3) & 1);
+            fprintf(arqRastro, "Caminho %d: [%d,%d] %s %s\n", i + 1, (int)(e >> 34), (int)((e >> 4) & 0x3FFFFFFF),
+                    empate ? "Empate, escolha para" : "Escolha para",
+                    (passo == DIR_DIAG) ? "diagonal" : (passo == DIR_ESQ) ? "cima" : "esquerda");
+        }
+    }
+    fflush(arqRastro);
+    printf("Rastro do traceback salvo no arquivo '%s'\n", ARQUIVO_RASTRO);
+}
+
+/* direcao seguida no empate, conforme a preferencia (opcao -x) */
+const int direcaoPreferida[3] = {DIR_DIAG, DIR_ESQ, DIR_CIMA};
+
+/* primeira direcao de cada combinacao de bits na ordem dos empates, a que o
+   traceback segue */
+int primeiraDirecao[8];
+
+/* monta ordemEmpate, a direcao preferida e depois as demais na ordem padrao,
+   e primeiraDirecao */
+void preparaOrdemEmpate(void) {
+    int i, j;
+
+    ordemEmpate[0] = direcaoPreferida[desempateFixo];
+    for (i = 0, j = 1; i < 3; i++)
+        if (direcaoPreferida[i] != ordemEmpate[0])
+            ordemEmpate[j++] = direcaoPreferida[i];
+    for (i = 0; i < 8; i++) {
+        for (j = 0; (j < 2) && !(i & ordemEmpate[j]); j++)
+            ;
+        primeiraDirecao[i] = ordemEmpate[j];
+    }
+}
+
+void iniciarTraceBack(int tipo) {
+    Caminho c;
+    Alinhamento a;
+    int i, j, ok, linIni, colIni;
+
+    if ((matrizEscores == NULL) && (matrizDirecoes == NULL) && (linhasControle == NULL) &&
+        (compacta.ancoras == NULL)) {
+        if (modoPreenchimento == MODO_ESCORE)
+            printf("\nModo so escore (-e): nao ha matriz para o traceback; use o metodo de Hirschberg.\n");
+        else
+            printf("\nMatriz de escores ainda nao gerada.\n");
+        return;
+    }
+
+    linIni = (tipo == 2) ? linUMaior : linPMaior;
+    colIni = (tipo == 2) ? colUMaior : colPMaior;
+    if (alinhaEmColunas)
+        alocaAlinhamento();
+    if (!alocaCaminhos(k) || !iniciaCaminho(0, linIni, colIni, 0)) {
+        printf("\nMemoria insuficiente para o alinhamento\n");
+        exit(1);
+    }
+    lista[0] = 0;
+    nLista = 1;
+    thread_count = 0; // Resetar a contagem a cada nova execução
+
+    preparaOrdemEmpate();
+
+    // Os caminhos de cada rodada sao divididos entre as numthreads threads do pool
+    j = (numthreads > 0) ? numthreads : 1;
+    preparaPool((linhasControle != NULL) ? j + 1 : j);
+    ok = (linhasControle != NULL) ? percorreFaixas(linIni, colIni) : percorreCaminhos(0);
+    if (!ok) {
+        printf("\nMemoria insuficiente para o alinhamento\n");
+        exit(1);
+    }
+
+    // Os caminhos terminados passam para o inicio, na ordem da lista
+    for (i = 0; i < nLista; i++) {
+        if ((caminhos[lista[i]].tbLin > 0) && (caminhos[lista[i]].tbCol > 0))
+            continue;
+        j = lista[i];
+        c = caminhos[thread_count];
+        caminhos[thread_count] = caminhos[j];
+        caminhos[j] = c;
+        a = resultados[thread_count];
+        resultados[thread_count] = resultados[j];
+        resultados[j] = a;
+        for (int l = 0; l < nLista; l++)
+            if ((l != i) && (lista[l] == thread_count))
+                lista[l] = j;
+        thread_count++;
+    }
+    if (capRastro > 0)
+        decodificaRastro(thread_count);
+
+    // Expandir as operacoes em colunas e copiar o primeiro alinhamento gerado
+    // para as variáveis globais
+    for (i = 0; alinhaEmColunas && (i < thread_count); i++) {
+        if (!redimensionaCompacta(&resultados[i].alinhaGMaior, (size_t)tamSeqMaior + tamSeqMenor) ||
+            !redimensionaCompacta(&resultados[i].alinhaGMenor, (size_t)tamSeqMaior + tamSeqMenor)) {
+            printf("\nMemoria insuficiente para o alinhamento\n");
+            exit(1);
+        }
+        expandeCigar(&resultados[i].cigar, &resultados[i].alinhaGMaior, &resultados[i].alinhaGMenor);
+    }
+    if (thread_count > 0)
+        tamAlinha = resultados[0].tamAlinha;
+    if (alinhaEmColunas && (thread_count > 0)) {
+        memcpy(alinhaGMaior.bases, resultados[0].alinhaGMaior.bases, PALAVRAS_BASES(tamAlinha) * sizeof(uint64_t));
+        memcpy(alinhaGMaior.mascara, resultados[0].alinhaGMaior.mascara, PALAVRAS_MASCARA(tamAlinha) * sizeof(uint64_t));
+        memcpy(alinhaGMenor.bases, resultados[0].alinhaGMenor.bases, PALAVRAS_BASES(tamAlinha) * sizeof(uint64_t));
+        memcpy(alinhaGMenor.mascara, resultados[0].alinhaGMenor.mascara, PALAVRAS_MASCARA(tamAlinha) * sizeof(uint64_t));
+    }
 
-  for (i=0; i<tamSeqMenor; i++)
-      if (seqMenor[i]!=seqMaior[indRef+i])
-           printf("^");
-      else printf(" ");
-  printf("\nQuantidade de trocas = %d\n", nTrocas);
+    // Mostrar apenas os alinhamentos únicos, sem duplicações
+    if (mostraDetalhes && (thread_count < k))
+        printf("Ha apenas %d alinhamento(s) otimo(s) a partir desta celula.\n", thread_count);
+    for (i = 0; mostraDetalhes && (i < thread_count); i++) {
+        printf("Alinhamento %d:\n", i + 1);
+        for (j = 0; j < resultados[i].tamAlinha; j++) {
+            printf("%c", mapaBases[baseEm(&resultados[i].alinhaGMaior, j)]);
+        }
+        printf("\n");
+        for (j = 0; j < resultados[i].tamAlinha; j++) {
+            printf("%c", mapaBases[baseEm(&resultados[i].alinhaGMenor, j)]);
+        }
+        printf("\n");
+    }
+}
 
+/* Contagem dos alinhamentos otimos (opcao -s). Antes de pedir k alinhamentos,
+   vale saber quantos existem, e enumera-los cresce exponencialmente. O numero
+   de caminhos otimos que o traceback pode seguir a partir de uma celula eh a
+   soma dos numeros das celulas de onde o seu escore pode ter vindo (os bits de
+   direcao), e 1 na linha 0 e na coluna 0, de onde o traceback so completa os
+   gaps. Essa soma depende das mesmas tres vizinhas que o preenchimento, entao
+   a contagem eh uma segunda frente de onda, com os mesmos blocos e as mesmas
+   threads, sobre a matriz ja preenchida: cada bloco guarda as contagens de
+   duas linhas no rascunho e deixa a ultima linha e a ultima coluna nas bordas
+   de contagem, como o preenchimento sem matriz. So os blocos ate a linha e a
+   coluna dos maiores escores sao percorridos.
+
+   Com gaps afins, cada celula tem tres contagens, como o traceback tem tres
+   estados: fora de gap, onde os empates ramificam, e dentro de um gap
+   horizontal ou vertical, onde o passo segue o gap e, na vizinha, o gap
+   continua se puder ser estendido e termina se puder ter sido aberto ali (os
+   dois, se ambos forem otimos). Os
+   contadores tem bitsContagem bits, em palavras de 64 bits da menos para a
+   mais significativa, e saturam no maior valor em vez de dar a volta. */
+
+int bitsContagem = 0;          /* opcao -s, multiplo de 64; 0 = sem contagem */
+int palavrasContagem = 1;      /* palavras de 64 bits por contador */
+int celulaContagem = 1;        /* palavras por celula: um contador por estado */
+int linFimContagem, colFimContagem;
+uint64_t *bordaLinhaContagem = NULL,   /* colFimContagem+1 celulas */
+         *bordaColunaContagem = NULL,  /* linFimContagem+1 celulas */
+         *cantoContagem = NULL,        /* um canto por linha de blocos */
+         *umContagem = NULL,           /* celula da linha 0 e da coluna 0 */
+         *contagemP = NULL, *contagemU = NULL;
+
+__thread uint64_t *rascunhoContagem = NULL; /* duas linhas de um bloco, por thread */
+__thread size_t capRascunhoContagem = 0;
+
+/* soma o contador a ao contador d, saturando */
+static inline void somaContagem(uint64_t *d, const uint64_t *a) {
+    uint64_t v, vaiUm = 0;
+    int i;
+
+    for (i = 0; i < palavrasContagem; i++) {
+        v = d[i] + vaiUm;
+        vaiUm = (v < vaiUm);
+        v += a[i];
+        vaiUm += (v < a[i]);
+        d[i] = v;
+    }
+    if (vaiUm)
+        memset(d, 0xFF, (size_t)palavrasContagem * sizeof(uint64_t));
 }
 
-/* geraMatrizEscores gera a matriz de escores. A matriz de escores tera
-   tamSeqMenor+1 linhas e tamSeqMaior+1 colunas. A linha 0 e a coluna
-   0 s�o adicionadas para representar gaps e conter penalidades. As
-   demais linhas e colunas sao associadas as bases da seqMenor e da
-   SeqMaior, respectivamente. */
+/* bits de direcao das celulas c0..c1 da linha lin: da matriz de direcoes ou,
+   com gaps lineares, calculados das linhas de escores atu (lin) e ant (lin-1),
+   da matriz ou descompactadas, enderecadas pelas colunas da matriz, e dos
+   pesos da base da linha com cada coluna do bloco */
+static void direcoesLinha(int lin, int c0, int c1, const int *atu, const int *ant,
+                          const int *pesos, unsigned char *dest) {
+    int col;
+
+    if (matrizDirecoes != NULL) {
+        for (col = c0; col <= c1; col++)
+            dest[col - c0] = direcoesCelula(lin, col);
+        return;
+    }
+    for (col = c0; col <= c1; col++)
+        dest[col - c0] = codigoDirecao(atu[col], ant[col - 1] + pesos[col - c0],
+                                       atu[col - 1] - penalGap, ant[col] - penalGap);
+}
 
-// Estrutura para passar argumentos para as threads
-typedef struct {
-    int num_threads; // Número total de threads
-    pthread_mutex_t* mutex; // Mutex para sincronização
-} ThreadData;
+/* contagem de um estado de gap em d: a do mesmo gap na vizinha v (desl
+   palavras adiante), se ele pode ser estendido, mais a da vizinha fora de gap,
+   se ele pode ter sido aberto ali, conforme os bits da celula */
+static inline void contaGap(uint64_t *d, const uint64_t *v, int bits, int estende, int abre, int desl) {
+    memset(d, 0, palavrasContagem * sizeof(uint64_t));
+    if (bits & estende)
+        somaContagem(d, v + desl);
+    if ((bits & abre) || !(bits & estende))
+        somaContagem(d, v);
+}
 
-void* preenchematriz(void* arg) {
-    ThreadData *data = (ThreadData*)arg;
-    int lin, col, peso;
-    int escoreDiag, escoreLin, escoreCol;
-    static int linha_atual = 1; // Índice global de linha, compartilhado entre threads
-	
-    while (1) {
-        pthread_mutex_lock(data->mutex);
-        lin = linha_atual++;
-        pthread_mutex_unlock(data->mutex);
+/* conta os caminhos otimos das celulas do bloco [bLin,bCol]. O rascunho eh o
+   de cada thread, do tamanho dos contadores, e nao ha maiores a registrar, entao
+   area e maiores ficam sem uso. */
+void contaBloco(int bLin, int bCol, void *area, MaioresBloco *maiores) {
+    unsigned char basesMaior[TAM_BLOCO_COL_MAX], dir[TAM_BLOCO_COL_MAX];
+    int escores[2][TAM_BLOCO_COL_MAX + 1], pesos[4][TAM_BLOCO_COL_MAX];
+    const int *escAtu = NULL, *escAnt = NULL;
+    uint64_t *ant, *atu, *t, *c, *esq, *cima, v;
+    int r0, r1, c0, c1, w, lin, i, p = palavrasContagem, n = celulaContagem;
+    int descompacta = (matrizEscores == NULL) && (matrizDirecoes == NULL);
+
+    (void)area;
+    (void)maiores;
+    r0 = bLin * tamBlocoLin + 1;
+    r1 = (bLin + 1) * tamBlocoLin;
+    if (r1 > linFimContagem) r1 = linFimContagem;
+    c0 = bCol * tamBlocoCol + 1;
+    c1 = (bCol + 1) * tamBlocoCol;
+    if (c1 > colFimContagem) c1 = colFimContagem;
+    w = c1 - c0 + 1;
+
+    if (capRascunhoContagem < 2 * ((size_t)tamBlocoCol + 1) * n) {
+        free(rascunhoContagem);
+        capRascunhoContagem = 2 * ((size_t)tamBlocoCol + 1) * n;
+        rascunhoContagem = malloc(capRascunhoContagem * sizeof(uint64_t));
+    }
+    ant = rascunhoContagem;
+    atu = ant + (size_t)(w + 1) * n;
+    desempacotaBases(&seqMaior, c0 - 1, w, basesMaior);
+    for (i = 0; i < 4 * w; i++)
+        pesos[i / w][i % w] = matrizPesos[i / w][basesMaior[i % w]];
+
+    // Canto e linha de cima do bloco; a posicao 0 eh a coluna c0-1
+    memcpy(ant, (bCol == 0) ? umContagem : cantoContagem + (size_t)bLin * n, n * sizeof(uint64_t));
+    memcpy(ant + n, bordaLinhaContagem + (size_t)c0 * n, (size_t)w * n * sizeof(uint64_t));
+
+    // Na matriz compacta, as linhas do bloco sao descompactadas uma vez
+    if (descompacta) {
+        escAnt = escores[(r0 - 1) & 1] - (c0 - 1);
+        descompactaColunas(r0 - 1, c0, c1, (int *)escAnt);
+        ((int *)escAnt)[c0 - 1] = escoreCompacto(r0 - 1, c0 - 1);
+    }
 
-        if (lin > tamSeqMenor) {
-            break; // Se todas as linhas foram processadas, saia do loop
+    for (lin = r0; lin <= r1; lin++) {
+        memcpy(atu, (bCol == 0) ? umContagem : bordaColunaContagem + (size_t)lin * n, n * sizeof(uint64_t));
+        if (descompacta) {
+            escAtu = escores[lin & 1] - (c0 - 1);
+            escAnt = escores[(lin - 1) & 1] - (c0 - 1);
+            descompactaColunas(lin, c0, c1, (int *)escAtu);
+            ((int *)escAtu)[c0 - 1] = escoreCompacto(lin, c0 - 1);
+        } else if (matrizDirecoes == NULL) {
+            escAtu = matrizEscores[lin];
+            escAnt = matrizEscores[lin - 1];
+        }
+        direcoesLinha(lin, c0, c1, escAtu, escAnt, pesos[baseEm(&seqMenor, lin - 1)], dir);
+
+        // Com gaps lineares e 64 bits, um contador por celula, sem desvios:
+        // os bits de direcao viram mascaras das tres parcelas
+        for (i = 1; (n == 1) && (i <= w); i++) {
+            uint64_t e = atu[i - 1] & -(uint64_t)((dir[i - 1] >> 1) & 1);
+            uint64_t s = ant[i] & -(uint64_t)((dir[i - 1] >> 2) & 1);
+            int satura;
+
+            v = ant[i - 1] & -(uint64_t)(dir[i - 1] & 1);
+            v += e;
+            satura = (v < e);
+            v += s;
+            satura |= (v < s);
+            atu[i] = v | -(uint64_t)satura;
+        }
+        for (i = 1; (n > 1) && (i <= w); i++) {
+            c = atu + (size_t)i * n;
+            esq = atu + (size_t)(i - 1) * n;
+            cima = ant + (size_t)i * n;
+            // Os estados de gap da celula vem antes, ja que o passo de gap
+            // fora de gap entra neles
+            if (n > p) {
+                contaGap(c + p, esq, dir[i - 1], DIR_ESQ_ESTENDE, DIR_ESQ_ABRE, p);
+                contaGap(c + 2 * p, cima, dir[i - 1], DIR_CIMA_ESTENDE, DIR_CIMA_ABRE, 2 * p);
+                esq = c + p;
+                cima = c + 2 * p;
+            }
+            memset(c, 0, p * sizeof(uint64_t));
+            if (dir[i - 1] & DIR_DIAG)
+                somaContagem(c, ant + (size_t)(i - 1) * n);
+            if (dir[i - 1] & DIR_ESQ)
+                somaContagem(c, esq);
+            if (dir[i - 1] & DIR_CIMA)
+                somaContagem(c, cima);
         }
 
-        for (col = 1; col <= tamSeqMaior; col++) {
-            peso = matrizPesos[seqMenor[lin-1]][seqMaior[col-1]];
-            escoreDiag = matrizEscores[lin-1][col-1] + peso;
-            escoreLin = matrizEscores[lin][col-1] - penalGap;
-            escoreCol = matrizEscores[lin-1][col] - penalGap;
+        if ((lin == linPMaior) && (colPMaior >= c0) && (colPMaior <= c1))
+            memcpy(contagemP, atu + (size_t)(colPMaior - c0 + 1) * n, p * sizeof(uint64_t));
+        if ((lin == linUMaior) && (colUMaior >= c0) && (colUMaior <= c1))
+            memcpy(contagemU, atu + (size_t)(colUMaior - c0 + 1) * n, p * sizeof(uint64_t));
+        memcpy(bordaColunaContagem + (size_t)lin * n, atu + (size_t)w * n, n * sizeof(uint64_t));
+        t = ant;
+        ant = atu;
+        atu = t;
+    }
 
-            if ((escoreDiag > escoreLin) && (escoreDiag > escoreCol)) {
-                matrizEscores[lin][col] = escoreDiag;
-            } else if (escoreLin > escoreCol) {
-                matrizEscores[lin][col] = escoreLin;
-            } else {
-                matrizEscores[lin][col] = escoreCol;
-            }
+    memcpy(cantoContagem + (size_t)bLin * n, bordaLinhaContagem + (size_t)c1 * n, n * sizeof(uint64_t));
+    memcpy(bordaLinhaContagem + (size_t)c0 * n, ant + n, (size_t)w * n * sizeof(uint64_t));
+}
+
+/* escreve em texto o contador v em decimal ou, saturado, o limite */
+void textoContagem(const uint64_t *v, char *texto) {
+    uint64_t q[palavrasContagem], resto;
+    char digitos[20 * palavrasContagem + 1];
+    int i, n = 0, saturado = 1, zero;
+
+    for (i = 0; i < palavrasContagem; i++)
+        saturado = saturado && (v[i] == UINT64_MAX);
+    if (saturado) {
+        sprintf(texto, "pelo menos 2^%d - 1 (contador saturado)", bitsContagem);
+        return;
+    }
+    // Divisoes sucessivas por 10, da palavra mais significativa para a menos
+    memcpy(q, v, sizeof(q));
+    do {
+        resto = 0;
+        zero = 1;
+        for (i = palavrasContagem - 1; i >= 0; i--) {
+            unsigned __int128 x = ((unsigned __int128)resto << 64) | q[i];
+            q[i] = (uint64_t)(x / 10);
+            resto = (uint64_t)(x % 10);
+            zero = zero && (q[i] == 0);
         }
+        digitos[n++] = '0' + (char)resto;
+    } while (!zero);
+    for (i = 0; i < n; i++)
+        texto[i] = digitos[n - 1 - i];
+    texto[n] = '\0';
+}
+
+/* conta, com K threads, os alinhamentos otimos a partir das celulas do
+   primeiro e do ultimo maior escore, na matriz de escores, na de direcoes ou
+   na compacta */
+void contaAlinhamentosOtimos(int K) {
+    ThreadData thread_data[K];
+    FrenteOnda frente;
+    char *texto;
+    size_t n;
+    double inicio = tempoAtual();
+
+    if ((matrizEscores == NULL) && (matrizDirecoes == NULL) && (compacta.ancoras == NULL)) {
+        printf("\nContagem dos alinhamentos otimos indisponivel sem a matriz de escores, de direcoes ou compacta (modos -c e -e).\n");
+        return;
+    }
+    palavrasContagem = bitsContagem / 64;
+    celulaContagem = (penalAbre > 0) ? 3 * palavrasContagem : palavrasContagem;
+    linFimContagem = (linPMaior > linUMaior) ? linPMaior : linUMaior;
+    colFimContagem = (colPMaior > colUMaior) ? colPMaior : colUMaior;
+    n = (size_t)celulaContagem * sizeof(uint64_t);
+
+    bordaLinhaContagem = malloc(((size_t)colFimContagem + 1) * n);
+    bordaColunaContagem = malloc(((size_t)linFimContagem + 1) * n);
+    cantoContagem = malloc(((size_t)linFimContagem / tamBlocoLin + 1) * n);
+    umContagem = calloc(celulaContagem, sizeof(uint64_t));
+    contagemP = calloc(palavrasContagem, sizeof(uint64_t));
+    contagemU = calloc(palavrasContagem, sizeof(uint64_t));
+    texto = malloc(20 * (size_t)palavrasContagem + 64);
+    if ((bordaLinhaContagem != NULL) && (bordaColunaContagem != NULL) && (cantoContagem != NULL) &&
+        (umContagem != NULL) && (contagemP != NULL) && (contagemU != NULL) && (texto != NULL)) {
+        // A linha 0 eh a borda de cima da primeira linha de blocos
+        for (int e = 0; e < celulaContagem; e += palavrasContagem)
+            umContagem[e] = 1;
+        for (int col = 0; col <= colFimContagem; col++)
+            memcpy(bordaLinhaContagem + (size_t)col * celulaContagem, umContagem, n);
+
+        iniciaFrente(&frente, (linFimContagem + tamBlocoLin - 1) / tamBlocoLin,
+                     (colFimContagem + tamBlocoCol - 1) / tamBlocoCol, contaBloco);
+        executaFrente(&frente, thread_data, K);
+
+        textoContagem(contagemP, texto);
+        printf("\nAlinhamentos otimos a partir do primeiro maior escore [%d,%d] = %s", linPMaior, colPMaior, texto);
+        textoContagem(contagemU, texto);
+        printf("\nAlinhamentos otimos a partir do ultimo maior escore [%d,%d] = %s", linUMaior, colUMaior, texto);
+        printf("\nTempo da contagem = %.3f s\n", tempoAtual() - inicio);
+    } else
+        printf("\nMemoria insuficiente para a contagem dos alinhamentos otimos\n");
+
+    free(bordaLinhaContagem);
+    free(bordaColunaContagem);
+    free(cantoContagem);
+    free(umContagem);
+    free(contagemP);
+    free(contagemU);
+    free(texto);
+    bordaLinhaContagem = bordaColunaContagem = cantoContagem = umContagem = contagemP = contagemU = NULL;
+}
+
+/* alinhamento global de Hirschberg, em memoria linear. Em vez de guardar toda a
+   matriz de escores para o traceback, o problema eh dividido ao meio pela linha
+   central da seqMenor, na coluna em que o caminho do traceback na matriz a
+   cruzaria. Essa coluna sai de um preenchimento em memoria linear do
+   subproblema, em que cada celula abaixo da linha central herda a coluna de
+   cruzamento da celula de onde vem o seu passo, com os empates na ordem de
+   traceBack() (opcao -x). O caminho por essa coluna separa o problema em dois
+   subproblemas independentes, resolvidos recursivamente; subproblemas
+   pequenos sao resolvidos diretamente, com uma matriz local e traceback. Como
+   cada subproblema comeca e termina no caminho do traceback na matriz, e os
+   empates dentro dele seguem a mesma ordem, o alinhamento eh o mesmo do
+   traceback na matriz (-a matriz) a partir da mesma celula inicial (opcao
+   -m), e nao apenas um alinhamento de mesmo escore.
+
+   Cada subproblema [i0,i1) x [j0,j1) escreve seu trecho de alinhamento em
+   trechoMaior/trechoMenor a partir da posicao i0+j0, com no maximo
+   (i1-i0)+(j1-j0) posicoes, de forma que subproblemas irmaos escrevem em areas
+   disjuntas e podem ser executados por threads diferentes. Esses vetores de
+   trabalho guardam uma posicao por byte, ja que threads diferentes nao podem
+   escrever na mesma sequencia compactada; ao final, o alinhamento eh
+   empacotado em alinhaGMaior/alinhaGMenor. */
+
+#define LIMITE_DIRETO 16384 // celulas abaixo das quais o subproblema eh resolvido diretamente
+
+int modoAlinhamento=0; /* 0 = perguntar no menu, 1 = traceback na matriz de
+                          escores, 2 = Hirschberg em memoria linear, 3 = banda
+                          diagonal */
+
+unsigned char *trechoMaior=NULL, /* alinhamento em construcao, um byte por posicao */
+              *trechoMenor=NULL;
+
+int threadsLivres=0;            /* threads extras ainda disponiveis para Hirschberg */
+pthread_mutex_t mutexThreads;   /* protege threadsLivres */
+
+/* reserva uma thread extra, se houver alguma livre */
+int reservaThread(void)
+{ int ok=0;
+
+  pthread_mutex_lock(&mutexThreads);
+  if (threadsLivres>0)
+  {
+    threadsLivres--;
+    ok=1;
+  }
+  pthread_mutex_unlock(&mutexThreads);
+  return ok;
+}
+
+/* devolve uma thread extra ao conjunto de threads livres */
+void devolveThread(void)
+{
+  pthread_mutex_lock(&mutexThreads);
+  threadsLivres++;
+  pthread_mutex_unlock(&mutexThreads);
+}
+
+/* coluna, relativa a j0, em que o traceback de [i1,j1] cruza a linha iMeio na
+   matriz de escores entre seqMenor[i0..i1) e seqMaior[j0..j1), seguindo os
+   empates na ordem de traceBack(). O preenchimento guarda so duas linhas e,
+   para cada celula abaixo de iMeio, a coluna em que o caminho que sai dela
+   chega a linha iMeio, herdada da celula de onde o passo dela vem. */
+int colunaCorte(int i0, int i1, int j0, int j1, int iMeio)
+{ int nCol=j1-j0, lin, col, peso, h, baseMenor, corte;
+  int escoreDiag, escoreLin, escoreCol, vizinho[DIR_CIMA+1];
+  int *ant=malloc((size_t)(nCol+1)*sizeof(int)), *atu=malloc((size_t)(nCol+1)*sizeof(int));
+  int *corteAnt=malloc((size_t)(nCol+1)*sizeof(int)), *corteAtu=malloc((size_t)(nCol+1)*sizeof(int));
+  int *t;
+  unsigned char *bases=malloc((size_t)nCol+1);
+
+  desempacotaBases(&seqMaior, j0, nCol, bases);
+  for (col=0; col<=nCol; col++)
+    ant[col]=-col*penalGap;
+
+  for (lin=1; lin<=i1-i0; lin++)
+  {
+    atu[0]=-lin*penalGap;
+    corteAtu[0]=0; /* da coluna 0 o caminho so sobe */
+    baseMenor=baseEm(&seqMenor,i0+lin-1);
+    for (col=1; col<=nCol; col++)
+    {
+      peso=matrizPesos[baseMenor][bases[col-1]];
+      escoreDiag=ant[col-1]+peso;
+      escoreLin=atu[col-1]-penalGap;
+      escoreCol=ant[col]-penalGap;
+      h=escoreDiag;
+      if (escoreLin>h) h=escoreLin;
+      if (escoreCol>h) h=escoreCol;
+      atu[col]=h;
+      if (i0+lin>iMeio)
+      {
+        /* selecao sem desvios, que em sequencias divergentes erram muito */
+        vizinho[DIR_DIAG]=corteAnt[col-1];
+        vizinho[DIR_ESQ]=corteAtu[col-1];
+        vizinho[DIR_CIMA]=corteAnt[col];
+        corteAtu[col]=vizinho[primeiraDirecao[codigoDirecao(h, escoreDiag, escoreLin, escoreCol)]];
+      }
+    }
+    if (i0+lin==iMeio)
+      for (col=1; col<=nCol; col++)
+        corteAtu[col]=col;
+    t=ant; ant=atu; atu=t;
+    t=corteAnt; corteAnt=corteAtu; corteAtu=t;
+  }
+  corte=corteAnt[nCol];
+  free(ant);
+  free(atu);
+  free(corteAnt);
+  free(corteAtu);
+  free(bases);
+  return corte;
+}
+
+/* resolve diretamente um subproblema pequeno: preenche uma matriz local e faz o
+   traceback com as mesmas regras de traceBack(), inclusive a ordem dos
+   empates, escrevendo o trecho na ordem
+   correta a partir de trechoMaior[i0+j0]. Retorna o tamanho do trecho. */
+int alinhaDireto(int i0, int i1, int j0, int j1)
+{ int nLin=i1-i0, nCol=j1-j0, lin, col, peso, pos, tam, ini, passo;
+  int escoreDiag, escoreLin, escoreCol;
+  int *m=malloc((size_t)(nLin+1)*(nCol+1)*sizeof(int));
+  unsigned char *maior=trechoMaior+i0+j0, *menor=trechoMenor+i0+j0;
+  unsigned char *basesMenor=malloc((size_t)nLin+1), *basesMaior=malloc((size_t)nCol+1);
+
+  desempacotaBases(&seqMenor, i0, nLin, basesMenor);
+  desempacotaBases(&seqMaior, j0, nCol, basesMaior);
+
+#define M(l,c) m[(size_t)(l)*(nCol+1)+(c)]
+  for (col=0; col<=nCol; col++)
+    M(0,col)=-col*penalGap;
+  for (lin=1; lin<=nLin; lin++)
+  {
+    M(lin,0)=-lin*penalGap;
+    for (col=1; col<=nCol; col++)
+    {
+      peso=matrizPesos[basesMenor[lin-1]][basesMaior[col-1]];
+      escoreDiag=M(lin-1,col-1)+peso;
+      escoreLin=M(lin,col-1)-penalGap;
+      escoreCol=M(lin-1,col)-penalGap;
+      if ((escoreDiag>escoreLin)&&(escoreDiag>escoreCol))
+        M(lin,col)=escoreDiag;
+      else if (escoreLin>escoreCol)
+        M(lin,col)=escoreLin;
+      else
+        M(lin,col)=escoreCol;
+    }
+  }
+
+  /* traceback escrito de tras para frente no final da area do subproblema */
+  tam=nLin+nCol;
+  pos=tam;
+  lin=nLin;
+  col=nCol;
+  while ((lin>0)&&(col>0))
+  {
+    peso=matrizPesos[basesMenor[lin-1]][basesMaior[col-1]];
+    escoreDiag=M(lin-1,col-1)+peso;
+    escoreLin=M(lin,col-1)-penalGap;
+    escoreCol=M(lin-1,col)-penalGap;
+    passo=primeiraDirecao[codigoDirecao(M(lin,col), escoreDiag, escoreLin, escoreCol)];
+    pos--;
+    if (passo==DIR_DIAG)
+    {
+      menor[pos]=basesMenor[lin-1];
+      maior[pos]=basesMaior[col-1];
+      lin--;
+      col--;
     }
+    else if (passo==DIR_ESQ)
+    {
+      menor[pos]=X;
+      maior[pos]=basesMaior[col-1];
+      col--;
+    }
+    else
+    {
+      menor[pos]=basesMenor[lin-1];
+      maior[pos]=X;
+      lin--;
+    }
+  }
+  while (lin>0)
+  {
+    pos--;
+    menor[pos]=basesMenor[lin-1];
+    maior[pos]=X;
+    lin--;
+  }
+  while (col>0)
+  {
+    pos--;
+    menor[pos]=X;
+    maior[pos]=basesMaior[col-1];
+    col--;
+  }
+#undef M
+
+  /* desloca o trecho para o inicio da area */
+  ini=pos;
+  memmove(maior, maior+ini, (size_t)(tam-ini));
+  memmove(menor, menor+ini, (size_t)(tam-ini));
+  free(m);
+  free(basesMenor);
+  free(basesMaior);
+  return tam-ini;
+}
+
+/* subproblema de Hirschberg executado por outra thread */
+typedef struct {
+    int i0, i1, j0, j1;
+    int tam; // tamanho do trecho de alinhamento produzido
+} SubHirschberg;
+
+int hirschberg(int i0, int i1, int j0, int j1);
+
+void* hirschbergThread(void* arg) {
+    SubHirschberg *s = (SubHirschberg*)arg;
+    s->tam = hirschberg(s->i0, s->i1, s->j0, s->j1);
     pthread_exit(NULL);
 }
-void geraMatrizEscores(int K) {
-    pthread_t threads[K];
-    ThreadData thread_data[K];
-    pthread_mutex_t mutex;
-    int i;
 
-    printf("\nGeracao da Matriz de escores:\n");
+/* alinha seqMenor[i0..i1) com seqMaior[j0..j1) em memoria linear, escrevendo o
+   trecho a partir de trechoMaior[i0+j0]. Retorna o tamanho do trecho. */
+int hirschberg(int i0, int i1, int j0, int j1)
+{ int nCol=j1-j0, iMeio, jMeio, c, tam1, tam2, ok;
+  pthread_t thread;
+  SubHirschberg sub;
 
-    // Inicializando a linha de penalidades/gaps
-    for (int col = 0; col <= tamSeqMaior; col++) {
-        matrizEscores[0][col] = -1 * (col * penalGap);
+  if (i1==i0) /* so restam bases da seqMaior: gaps na seqMenor */
+  {
+    for (c=0; c<nCol; c++)
+    {
+      trechoMenor[i0+j0+c]=X;
+      trechoMaior[i0+j0+c]=baseEm(&seqMaior,j0+c);
     }
+    return nCol;
+  }
+  if ((i1-i0==1)||(nCol<=1)||((size_t)(i1-i0+1)*(nCol+1)<=LIMITE_DIRETO))
+    return alinhaDireto(i0, i1, j0, j1);
+
+  /* coluna de corte: a do caminho que o traceback na matriz seguiria, para
+     que o alinhamento seja o mesmo, inclusive nos empates */
+  iMeio=(i0+i1)/2;
+  jMeio=colunaCorte(i0, i1, j0, j1, iMeio);
+
+  /* os dois subproblemas sao independentes: a metade de baixo vai para outra
+     thread, se houver alguma livre */
+  sub.i0=iMeio; sub.i1=i1; sub.j0=j0+jMeio; sub.j1=j1;
+  ok=reservaThread();
+  if (ok)
+    pthread_create(&thread, NULL, hirschbergThread, &sub);
+  tam1=hirschberg(i0, iMeio, j0, j0+jMeio);
+  if (ok)
+  {
+    pthread_join(thread, NULL);
+    devolveThread();
+    tam2=sub.tam;
+  }
+  else
+    tam2=hirschberg(iMeio, i1, j0+jMeio, j1);
 
-    // Inicializando a coluna de penalidades/gaps
-    for (int lin = 0; lin <= tamSeqMenor; lin++) {
-        matrizEscores[lin][0] = -1 * (lin * penalGap);
+  /* junta o trecho de baixo logo apos o de cima */
+  memmove(trechoMaior+i0+j0+tam1, trechoMaior+iMeio+j0+jMeio, (size_t)tam2);
+  memmove(trechoMenor+i0+j0+tam1, trechoMenor+iMeio+j0+jMeio, (size_t)tam2);
+  return tam1+tam2;
+}
+
+/* localiza o primeiro e o ultimo maior escore percorrendo a matriz de escores
+   linha a linha, sem armazena-la: apenas a linha corrente eh mantida */
+void localizaMaioresLinear(void)
+{ int lin, col, peso, diag, baseMenor, *linha;
+  int escoreDiag, escoreLin, escoreCol;
+  unsigned char *bases;
+
+  linha=malloc((size_t)(tamSeqMaior+1)*sizeof(int));
+  bases=malloc((size_t)tamSeqMaior+1);
+  desempacotaBases(&seqMaior, 0, tamSeqMaior, bases);
+  for (col=0; col<=tamSeqMaior; col++)
+    linha[col]=-col*penalGap;
+
+  linPMaior=linUMaior=0;
+  for (lin=1; lin<=tamSeqMenor; lin++)
+  {
+    diag=linha[0];
+    linha[0]=-lin*penalGap;
+    baseMenor=baseEm(&seqMenor,lin-1);
+    for (col=1; col<=tamSeqMaior; col++)
+    {
+      peso=matrizPesos[baseMenor][bases[col-1]];
+      escoreDiag=diag+peso;
+      escoreLin=linha[col-1]-penalGap;
+      escoreCol=linha[col]-penalGap;
+      diag=linha[col];
+      if ((escoreDiag>escoreLin)&&(escoreDiag>escoreCol))
+        linha[col]=escoreDiag;
+      else if (escoreLin>escoreCol)
+        linha[col]=escoreLin;
+      else
+        linha[col]=escoreCol;
+
+      if ((linPMaior==0)||(PMaior<linha[col]))
+      {
+        linPMaior=lin;
+        colPMaior=col;
+        PMaior=linha[col];
+      }
+      if ((linUMaior==0)||(UMaior<=linha[col]))
+      {
+        linUMaior=lin;
+        colUMaior=col;
+        UMaior=linha[col];
+      }
     }
+  }
+  free(linha);
+  free(bases);
+}
 
-    // Inicializando o mutex
-    pthread_mutex_init(&mutex, NULL);
+/* gera o alinhamento global por Hirschberg, a partir do primeiro (tipo 1) ou do
+   ultimo (tipo 2) maior escore, usando ate K threads */
+void alinhamentoHirschberg(int tipo, int K)
+{ int lin, col;
 
-    // Configurando dados para threads
-    for (i = 0; i < K; i++) {
-        thread_data[i].num_threads = K;
-        thread_data[i].mutex = &mutex;
-        pthread_create(&threads[i], NULL, preenchematriz, &thread_data[i]);
+  printf("\nGeracao do Alinhamento Global por Hirschberg (memoria linear):\n");
+  if (penalAbre>0)
+  {
+    printf("\nO metodo de Hirschberg usa apenas gaps lineares (sem a opcao -g).\n");
+    return;
+  }
+
+  localizaMaioresLinear();
+  printf("\nPrimeiro Maior escore = %d na celula [%d,%d]", PMaior, linPMaior, colPMaior);
+  printf("\nUltimo Maior escore = %d na celula [%d,%d]\n", UMaior, linUMaior, colUMaior);
+  if (tipo==1)
+  {
+    lin=linPMaior;
+    col=colPMaior;
+  }
+  else
+  {
+    lin=linUMaior;
+    col=colUMaior;
+  }
+
+  alocaAlinhamento();
+  preparaOrdemEmpate();
+  trechoMaior=malloc((size_t)tamSeqMaior+tamSeqMenor);
+  trechoMenor=malloc((size_t)tamSeqMaior+tamSeqMenor);
+  pthread_mutex_init(&mutexThreads, NULL);
+  threadsLivres=K-1;
+  tamAlinha=hirschberg(0, lin, 0, col);
+  pthread_mutex_destroy(&mutexThreads);
+  empacotaBases(&alinhaGMaior, 0, trechoMaior, tamAlinha);
+  empacotaBases(&alinhaGMenor, 0, trechoMenor, tamAlinha);
+  free(trechoMaior);
+  free(trechoMenor);
+  trechoMaior=trechoMenor=NULL;
+
+  printf("\nAlinhamento Global Gerado.");
+  if (mostraDetalhes)
+    mostraAlinhamentoGlobal();
+}
+
+/* Alinhamento em banda diagonal. Quando as sequencias sao muito parecidas, como
+   a seqMenor gerada por geraSequencias (copia da seqMaior a partir de indRef,
+   so com trocas de bases), o caminho otimo fica perto de uma diagonal da matriz.
+   Este modo calcula apenas as celulas [lin,col] com col-lin entre dIni e dFim,
+   guardando os bits de direcao (DIR_DIAG, DIR_ESQ e DIR_CIMA) so dessas celulas
+   e duas linhas de escores, em tempo e memoria O(tamSeqMenor x largura). A
+   linha 0 e a coluna 0 continuam valendo -k*penalGap, e as celulas fora da
+   banda contam como inalcancaveis. Os maiores escores sao procurados dentro da
+   banda.
+
+   Como a linha 0 e a coluna 0 sao calculadas direto pela formula, a banda nao
+   precisa conter a diagonal 0. Para sequencias geradas, que so tem trocas de
+   bases, ela fica centrada na diagonal indRef, com meia largura 16 mais o dobro
+   de grauMuta; nos outros casos, vai da diagonal 0 ate a diagonal
+   tamSeqMaior-tamSeqMenor, mais 16 e 1% de tamSeqMenor de cada lado. A opcao
+   -b substitui a meia largura estimada.
+
+   Um caminho que sai da banda passa, antes da primeira celula de fora, por uma
+   celula da borda da banda (ou da linha 0 ou da coluna 0), cujo escore a banda
+   ja conhece. Dali em diante ele paga ao menos um gap e soma no maximo o maior
+   peso da matriz a cada passo na diagonal. Enquanto esse limite superior nao
+   ficar abaixo do maior escore da banda, a meia largura eh dobrada e o
+   alinhamento refeito; assim o resultado eh sempre o mesmo do traceback na
+   matriz, e a banda so economiza quando o limite fecha antes de ela cobrir a
+   matriz inteira (sequencias parecidas e penalGap maior que 0). */
+
+#define NEG_BANDA (INT_MIN/4) // escore das celulas fora da banda
+
+int larguraBanda=0; /* meia largura da banda (opcao -b), 0 = automatica */
+
+typedef struct {
+  int dIni, dFim;          /* diagonais (col-lin) extremas da banda */
+  int larg;                /* celulas por linha da banda, dFim-dIni+1 */
+  size_t passo;            /* bytes de direcoes por linha, 4 bits por celula */
+  unsigned char *direcoes; /* tamSeqMenor linhas de passo bytes */
+  int PMaior, linPMaior, colPMaior,  /* primeiro maior escore da banda */
+      UMaior, linUMaior, colUMaior;  /* ultimo maior escore da banda */
+  int limiteFora;          /* limite superior dos caminhos que saem da banda */
+} Banda;
+
+/* limite superior do escore de um caminho que esta na celula [lin,col] com
+   escore h e ainda pode dar passos ate a celula [lin+faltaLin,col+faltaCol]:
+   cada passo na diagonal soma no maximo pesoMax */
+static inline int limiteBanda(int h, int faltaLin, int faltaCol, int pesoMax)
+{
+  return h+((faltaLin<faltaCol) ? faltaLin : faltaCol)*pesoMax;
+}
+
+/* preenche a banda linha a linha, gravando os bits de direcao de cada celula,
+   localizando o primeiro e o ultimo maior escore da banda e calculando o
+   limite superior dos caminhos que saem dela. A celula [lin,col] fica na
+   posicao k=col-lin-dIni da sua linha: a celula da diagonal tem o mesmo k na
+   linha anterior, a de cima k+1 e a da esquerda k-1. Retorna 0 se nao houver
+   memoria suficiente. */
+int preencheBanda(Banda *b)
+{ int *ant, *atu, *aux;
+  int lin, col, c0, k, kIni, kFim, h, diag, esq, cima, *pesos, pesoMax=0, i, j;
+  unsigned char *bases, *dir;
+
+  b->larg=b->dFim-b->dIni+1;
+  b->passo=((size_t)b->larg+1)/2;
+  b->direcoes=calloc((size_t)tamSeqMenor*b->passo+1, 1);
+  ant=malloc((size_t)b->larg*sizeof(int));
+  atu=malloc((size_t)b->larg*sizeof(int));
+  bases=malloc((size_t)b->larg);
+  if ((b->direcoes==NULL)||(ant==NULL)||(atu==NULL)||(bases==NULL))
+  {
+    free(b->direcoes);
+    free(ant);
+    free(atu);
+    free(bases);
+    b->direcoes=NULL;
+    return 0;
+  }
+
+  for (i=0; i<4; i++)
+    for (j=0; j<4; j++)
+      if (matrizPesos[i][j]>pesoMax)
+        pesoMax=matrizPesos[i][j];
+
+  /* caminhos que saem da banda direto da linha 0 (pela primeira coluna c cuja
+     vizinha da diagonal ou de baixo fica fora) ou da coluna 0 */
+  b->limiteFora=NEG_BANDA;
+  c0=(b->dIni>0) ? 0 : b->dFim+1;
+  if ((c0>=0)&&(c0<tamSeqMaior))
+    b->limiteFora=limiteBanda(-c0*penalGap, tamSeqMenor, tamSeqMaior-c0, pesoMax);
+  lin=(b->dFim<0) ? 0 : 1-b->dIni;
+  if ((lin>=0)&&(lin<tamSeqMenor))
+  {
+    h=limiteBanda(-lin*penalGap, tamSeqMenor-lin, tamSeqMaior, pesoMax);
+    if (h>b->limiteFora) b->limiteFora=h;
+  }
+
+  b->PMaior=b->UMaior=INT_MIN;
+  b->linPMaior=b->colPMaior=b->linUMaior=b->colUMaior=0;
+  for (lin=1; lin<=tamSeqMenor; lin++)
+  {
+    /* posicoes da linha que caem dentro da matriz (colunas 1..tamSeqMaior) */
+    c0=lin+b->dIni;
+    kIni=(c0<1) ? 1-c0 : 0;
+    kFim=(tamSeqMaior-c0<b->larg-1) ? tamSeqMaior-c0 : b->larg-1;
+    if (kIni<=kFim)
+      desempacotaBases(&seqMaior, c0+kIni-1, kFim-kIni+1, bases+kIni);
+
+    pesos=matrizPesos[baseEm(&seqMenor,lin-1)];
+    dir=b->direcoes+(size_t)(lin-1)*b->passo;
+    for (k=0; (k<kIni)&&(k<b->larg); k++)
+      atu[k]=NEG_BANDA;
+    for (k=kIni; k<=kFim; k++)
+    {
+      col=c0+k;
+      diag=((lin==1)||(col==1)) ? -(lin+col-2)*penalGap : ant[k];
+      diag+=pesos[bases[k]];
+      cima=(lin==1) ? -col*penalGap : ((k+1<b->larg) ? ant[k+1] : NEG_BANDA);
+      cima-=penalGap;
+      esq=(col==1) ? -lin*penalGap : ((k>0) ? atu[k-1] : NEG_BANDA);
+      esq-=penalGap;
+
+      h=diag;
+      if (esq>h) h=esq;
+      if (cima>h) h=cima;
+      atu[k]=h;
+      dir[k>>1]|=codigoDirecao(h, diag, esq, cima)<<(4*(k&1));
+
+      if (h>b->PMaior)
+      {
+        b->PMaior=h;
+        b->linPMaior=lin;
+        b->colPMaior=col;
+      }
+      if (h>=b->UMaior)
+      {
+        b->UMaior=h;
+        b->linUMaior=lin;
+        b->colUMaior=col;
+      }
     }
+    for (k=(kFim+1>kIni) ? kFim+1 : kIni; k<b->larg; k++)
+      atu[k]=NEG_BANDA;
 
-    // Aguarda a conclusão de todas as threads
-    for (i = 0; i < K; i++) {
-        pthread_join(threads[i], NULL);
+    /* saidas pela borda: para a esquerda da diagonal dFim e para baixo da
+       diagonal dIni, se a celula de fora ainda estiver na matriz */
+    if ((kFim==b->larg-1)&&(c0+kFim<tamSeqMaior))
+    {
+      h=limiteBanda(atu[kFim]-penalGap, tamSeqMenor-lin, tamSeqMaior-c0-kFim-1, pesoMax);
+      if (h>b->limiteFora) b->limiteFora=h;
+    }
+    if ((kIni==0)&&(kFim>=0)&&(lin<tamSeqMenor))
+    {
+      h=limiteBanda(atu[0]-penalGap, tamSeqMenor-lin-1, tamSeqMaior-c0, pesoMax);
+      if (h>b->limiteFora) b->limiteFora=h;
     }
 
-    // Destruir o mutex
-    pthread_mutex_destroy(&mutex);
+    aux=ant;
+    ant=atu;
+    atu=aux;
+  }
 
-    // Localiza o primeiro e o último maior escore e suas posições
-    linPMaior = 1;
-    colPMaior = 1;
-    PMaior = matrizEscores[1][1];
+  free(ant);
+  free(atu);
+  free(bases);
+  return 1;
+}
 
-    linUMaior = 1;
-    colUMaior = 1;
-    UMaior = matrizEscores[1][1];
+/* refaz o alinhamento a partir da celula [lin,col], seguindo os bits da banda
+   com os empates na ordem de traceBack() (opcao -x), e o grava em alinhaGMaior
+   e alinhaGMenor */
+void tracebackBanda(Banda *b, int lin, int col)
+{ int pos, fim, k, passo;
 
-    for (int lin = 1; lin <= tamSeqMenor; lin++) {
-        for (int col = 1; col <= tamSeqMaior; col++) {
-            if (PMaior < matrizEscores[lin][col]) {
-                linPMaior = lin;
-                colPMaior = col;
-                PMaior = matrizEscores[lin][col];
-            }
-            if (UMaior <= matrizEscores[lin][col]) {
-                linUMaior = lin;
-                colUMaior = col;
-                UMaior = matrizEscores[lin][col];
-            }
-        }
+  /* o alinhamento eh escrito de tras para frente em trechoMaior/trechoMenor */
+  fim=pos=lin+col;
+  while ((lin>0)&&(col>0))
+  {
+    k=col-lin-b->dIni;
+    passo=primeiraDirecao[(b->direcoes[(size_t)(lin-1)*b->passo+(k>>1)]>>(4*(k&1)))&0x7];
+    pos--;
+    if (passo==DIR_DIAG)
+    {
+      trechoMenor[pos]=baseEm(&seqMenor,lin-1);
+      trechoMaior[pos]=baseEm(&seqMaior,col-1);
+      lin--;
+      col--;
+    }
+    else if (passo==DIR_ESQ)
+    {
+      trechoMenor[pos]=X;
+      trechoMaior[pos]=baseEm(&seqMaior,col-1);
+      col--;
     }
+    else
+    {
+      trechoMenor[pos]=baseEm(&seqMenor,lin-1);
+      trechoMaior[pos]=X;
+      lin--;
+    }
+  }
+  for (; lin>0; lin--)
+  {
+    pos--;
+    trechoMenor[pos]=baseEm(&seqMenor,lin-1);
+    trechoMaior[pos]=X;
+  }
+  for (; col>0; col--)
+  {
+    pos--;
+    trechoMenor[pos]=X;
+    trechoMaior[pos]=baseEm(&seqMaior,col-1);
+  }
 
-    printf("\nMatriz de escores Gerada.");
-    printf("\nPrimeiro Maior escore = %d na celula [%d,%d]", PMaior, linPMaior, colPMaior);
-    printf("\nUltimo Maior escore = %d na celula [%d,%d]", UMaior, linUMaior, colUMaior);
+  tamAlinha=fim-pos;
+  empacotaBases(&alinhaGMaior, 0, trechoMaior+pos, tamAlinha);
+  empacotaBases(&alinhaGMenor, 0, trechoMenor+pos, tamAlinha);
 }
 
-void salvaMatrizEmArquivo(const char* nomeArquivo) {
-    FILE* arquivo = fopen(nomeArquivo, "w");
-    if (arquivo == NULL) {
-        perror("Erro ao abrir o arquivo");
-        exit(EXIT_FAILURE);
+/* gera o alinhamento global na banda diagonal, a partir do primeiro (tipo 1) ou
+   do ultimo (tipo 2) maior escore da banda, alargando a banda ate que nenhum
+   caminho de fora possa alcanca-lo. O escore e a celula inicial vao para
+   *escore, *linIni e *colIni; PMaior e UMaior nao sao alterados. */
+void alinhamentoBanda(int tipo, int *escore, int *linIni, int *colIni)
+{ Banda b;
+  int w, otimo;
+  double inicio;
+
+  printf("\nGeracao do Alinhamento Global em Banda Diagonal:\n");
+  if (penalAbre>0)
+  {
+    printf("\nO alinhamento em banda usa apenas gaps lineares (sem a opcao -g).\n");
+    return;
+  }
+
+  if (larguraBanda>0)
+    w=larguraBanda;
+  else if (indRef>=0)
+    w=16+2*grauMuta;
+  else
+    w=16+tamSeqMenor/100;
+
+  alocaAlinhamento();
+  trechoMaior=malloc((size_t)tamSeqMaior+tamSeqMenor);
+  trechoMenor=malloc((size_t)tamSeqMaior+tamSeqMenor);
+  if ((trechoMaior==NULL)||(trechoMenor==NULL))
+  {
+    printf("\nMemoria insuficiente para o alinhamento\n");
+    exit(1);
+  }
+  preparaOrdemEmpate();
+
+  do
+  {
+    if (indRef>=0)
+    {
+      b.dIni=indRef-w;
+      b.dFim=indRef+w;
+    }
+    else
+    {
+      b.dIni=((tamSeqMaior<tamSeqMenor) ? tamSeqMaior-tamSeqMenor : 0)-w;
+      b.dFim=((tamSeqMaior>tamSeqMenor) ? tamSeqMaior-tamSeqMenor : 0)+w;
+    }
+    if (b.dIni<1-tamSeqMenor) b.dIni=1-tamSeqMenor;
+    if (b.dFim>tamSeqMaior-1) b.dFim=tamSeqMaior-1;
+
+    inicio=tempoAtual();
+    if (!preencheBanda(&b))
+    {
+      printf("\nMemoria insuficiente para a banda de %d diagonais\n", b.dFim-b.dIni+1);
+      free(trechoMaior);
+      free(trechoMenor);
+      trechoMaior=trechoMenor=NULL;
+      return;
+    }
+    printf("\nBanda: diagonais %d a %d (%d celulas por linha, %.1f MB de direcoes), %.2f s",
+           b.dIni, b.dFim, b.larg,
+           (double)tamSeqMenor*b.passo/(1024.0*1024.0),
+           tempoAtual()-inicio);
+
+    otimo=(b.limiteFora<b.PMaior);
+    if (!otimo)
+    {
+      printf("\nCaminhos fora da banda podem chegar a %d, acima do escore %d da banda; alargando.",
+             b.limiteFora, b.PMaior);
+      free(b.direcoes);
+      w*=2;
+    }
+  } while (!otimo);
+
+  *escore=(tipo==1) ? b.PMaior : b.UMaior;
+  *linIni=(tipo==1) ? b.linPMaior : b.linUMaior;
+  *colIni=(tipo==1) ? b.colPMaior : b.colUMaior;
+  tracebackBanda(&b, *linIni, *colIni);
+  free(b.direcoes);
+  free(trechoMaior);
+  free(trechoMenor);
+  trechoMaior=trechoMenor=NULL;
+
+  printf("\nPrimeiro Maior escore = %d na celula [%d,%d]", b.PMaior, b.linPMaior, b.colPMaior);
+  printf("\nUltimo Maior escore = %d na celula [%d,%d]\n", b.UMaior, b.linUMaior, b.colUMaior);
+  printf("\nAlinhamento Global Gerado.");
+  if (mostraDetalhes)
+    mostraAlinhamentoGlobal();
+}
+
+/* Alinhamento em lote de muitos pares curtos (por exemplo, leituras de 100 a
+   500 bases contra amplicons). Para pares desse tamanho, criar threads e
+   preencher uma matriz por par custa mais que o proprio calculo. Por isso os
+   pares sao agrupados em lotes de nLanes pares (8, 16 ou 32, conforme o
+   conjunto de instrucoes), um par por lane de 16 bits, e as matrizes de todos
+   os pares do lote sao preenchidas juntas, linha a linha, guardando apenas a
+   linha corrente. Cada lane acompanha o primeiro e o ultimo maior escore do seu
+   par, com os mesmos criterios de PMaior e UMaior em geraMatrizEscores.
+
+   Os pares sao ordenados por tamanho, para que um lote reuna pares parecidos;
+   as celulas alem do tamanho de um par sao calculadas, mas ignoradas. Os pesos
+   sao obtidos por uma tabela de 16 bytes indexada por 4*baseMenor+baseMaior.
+   Pares cujos escores nao cabem em 16 bits (ou todos, sem kernel vetorial) sao
+   calculados pelo laco escalar. */
+
+typedef struct {
+  size_t inicioMaior, inicioMenor;  /* posicao das sequencias do par em basesLote */
+  int tamMaior, tamMenor;
+  int PMaior, linPMaior, colPMaior,   /* primeiro maior escore do par */
+      UMaior, linUMaior, colUMaior;   /* ultimo maior escore do par */
+} ParLote;
+
+ParLote *paresLote=NULL;                 /* pares lidos, na ordem do arquivo */
+int numPares=0;
+SeqCompacta basesLote={NULL,NULL,0};     /* bases de todos os pares, em sequencia */
+
+typedef void (*KernelLote)(ParLote **pares, int maxMaior, int maxMenor, void *area);
+
+/* le o arquivo de pares, em qualquer formato de leSequenciasDeArquivo: cada
+   dois registros formam um par, com o mais longo como sequencia maior, e as
+   bases de todos vao para basesLote, na ordem do arquivo. Retorna 0 em caso
+   de erro. */
+int leParesDeArquivo(char *fileName)
+{ LeitorSeq leitor;
+  RegistroSeq maior, menor;
+  size_t numBases=0;
+  int capPares=1024, lido;
+  ParLote *par;
+
+  if (!abreLeitor(&leitor, fileName))
+    return 0;
+
+  free(paresLote);
+  numPares=0;
+  paresLote=malloc(capPares*sizeof(ParLote));
+  if (!redimensionaCompacta(&basesLote, 1<<20))
+    paresLote=NULL;
+
+  while ((lido=proximoPar(&leitor, &maior, &menor))>0)
+  {
+    if (numPares==capPares)
+    {
+      capPares*=2;
+      paresLote=realloc(paresLote, capPares*sizeof(ParLote));
+    }
+    if ((numBases+maior.numBases+menor.numBases>basesLote.cap)&&
+        !redimensionaCompacta(&basesLote, 2*(numBases+maior.numBases+menor.numBases)))
+      paresLote=NULL;
+    if (paresLote==NULL)
+    {
+      printf("\nMemoria insuficiente para os pares do arquivo %s\n", fileName);
+      exit(1);
+    }
+    if (maior.numBases>(size_t)INT_MAX/2)
+    {
+      printf("Sequencia %zu do arquivo de pares longa demais: %zu bases.\n", maior.indice, maior.numBases);
+      lido=-1;
+      break;
+    }
+
+    par=&paresLote[numPares];
+    par->inicioMaior=numBases;
+    par->tamMaior=(int)maior.numBases;
+    par->inicioMenor=numBases+maior.numBases;
+    par->tamMenor=(int)menor.numBases;
+    if (!codificaRegistro(&maior, &basesLote, par->inicioMaior)||
+        !codificaRegistro(&menor, &basesLote, par->inicioMenor))
+    {
+      lido=-1;
+      break;
+    }
+    numBases+=maior.numBases+menor.numBases;
+    numPares++;
+  }
+  fechaLeitor(&leitor);
+
+  if (lido<0)
+  {
+    numPares=0;
+    return 0;
+  }
+  return 1;
+}
+
+/* preenche a matriz de um par com o laco escalar, guardando apenas a linha
+   corrente (que deve ter espaco para tamMaior+1 escores); bases recebe a
+   sequencia maior desempacotada */
+void calculaParEscalar(ParLote *par, int *linha, unsigned char *bases)
+{ int lin, col, peso, diag, baseMenor;
+  int escoreDiag, escoreLin, escoreCol;
+
+  desempacotaBases(&basesLote, par->inicioMaior, par->tamMaior, bases);
+  for (col=0; col<=par->tamMaior; col++)
+    linha[col]=-col*penalGap;
+
+  par->linPMaior=par->linUMaior=0;
+  for (lin=1; lin<=par->tamMenor; lin++)
+  {
+    diag=linha[0];
+    linha[0]=-lin*penalGap;
+    baseMenor=baseEm(&basesLote, par->inicioMenor+lin-1);
+    for (col=1; col<=par->tamMaior; col++)
+    {
+      peso=matrizPesos[baseMenor][bases[col-1]];
+      escoreDiag=diag+peso;
+      escoreLin=linha[col-1]-penalGap;
+      escoreCol=linha[col]-penalGap;
+      diag=linha[col];
+      linha[col]=escoreDiag;
+      if (escoreLin>linha[col])
+        linha[col]=escoreLin;
+      if (escoreCol>linha[col])
+        linha[col]=escoreCol;
+
+      if ((par->linPMaior==0)||(par->PMaior<linha[col]))
+      {
+        par->linPMaior=lin;
+        par->colPMaior=col;
+        par->PMaior=linha[col];
+      }
+      if ((par->linUMaior==0)||(par->UMaior<=linha[col]))
+      {
+        par->linUMaior=lin;
+        par->colUMaior=col;
+        par->UMaior=linha[col];
+      }
+    }
+  }
+}
+
+#ifdef USA_SIMD
+
+/* peso de cada lane: o byte alto do indice traz 4*baseMenor+baseMaior e o byte
+   baixo 0x80, que zera o byte baixo do resultado; o deslocamento aritmetico
+   estende o sinal do peso para 16 bits */
+#define SSE_PESO(tab,idx)    _mm_srai_epi16(_mm_shuffle_epi8((tab),(idx)), 8)
+#define AVX2_PESO(tab,idx)   _mm256_srai_epi16(_mm256_shuffle_epi8((tab),(idx)), 8)
+#define AVX512_PESO(tab,idx) _mm512_srai_epi16(_mm512_shuffle_epi8((tab),(idx)), 8)
+
+#define SSE_CARREGA(p)    _mm_load_si128((const __m128i*)(p))
+#define AVX2_CARREGA(p)   _mm256_load_si256((const __m256i*)(p))
+#define AVX512_CARREGA(p) _mm512_load_si512((const void*)(p))
+
+#define SSE_TAB(p)    _mm_loadu_si128((const __m128i*)(p))
+#define AVX2_TAB(p)   _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(p)))
+#define AVX512_TAB(p) _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)(p)))
+
+/* comparacao lane a lane e escolha: ESCOLHE(m,a,b) fica com b onde m vale */
+#define SSE_GT(a,b)          _mm_cmpgt_epi16((a),(b))
+#define SSE_E(m1,m2)         _mm_and_si128((m1),(m2))
+#define SSE_ESCOLHE(m,a,b)   _mm_blendv_epi8((a),(b),(m))
+#define AVX2_GT(a,b)         _mm256_cmpgt_epi16((a),(b))
+#define AVX2_E(m1,m2)        _mm256_and_si256((m1),(m2))
+#define AVX2_ESCOLHE(m,a,b)  _mm256_blendv_epi8((a),(b),(m))
+#define AVX512_GT(a,b)       _mm512_cmpgt_epi16_mask((a),(b))
+#define AVX512_E(m1,m2)      ((m1)&(m2))
+#define AVX512_ESCOLHE(m,a,b) _mm512_mask_blend_epi16((m),(a),(b))
+
+/* preenche juntas as matrizes dos nLanes pares do lote (pares[l] eh o par da
+   lane l, ou NULL para uma lane vazia), com maxMaior colunas e maxMenor linhas.
+   area tem espaco para 2*(maxMaior+1) vetores. */
+#define DEFINE_KERNEL_LOTE(NOME, ALVO, VT, MT, LOAD, SET1, ADD, ADDS, SUBS, MAX, GT, E, ESCOLHE, PESO, TAB) \
+__attribute__((target(ALVO))) \
+static void NOME(ParLote **pares, int maxMaior, int maxMenor, void *area) \
+{ \
+  enum { nLanes=sizeof(VT)/sizeof(int16_t) }; \
+  VT *linha=(VT*)area, *codCol=linha+maxMaior+1; \
+  VT vGap=SET1(penalGap), vNeg=SET1(INT16_MIN), vTab, vCodLin, vTamMaior, vTamMenor; \
+  VT vDiag, vEsq, vCima, vH, vLin, vCol; \
+  VT bestP=SET1(INT16_MIN), linP=SET1(0), colP=SET1(0); \
+  VT bestU=SET1(INT16_MIN+1), linU=SET1(0), colU=SET1(0); \
+  MT valida, validaLin, maior; \
+  int8_t tab[16]; \
+  int16_t t[nLanes] __attribute__((aligned(64))); \
+  int16_t tP[nLanes] __attribute__((aligned(64))), tLP[nLanes] __attribute__((aligned(64))), tCP[nLanes] __attribute__((aligned(64))); \
+  int16_t tU[nLanes] __attribute__((aligned(64))), tLU[nLanes] __attribute__((aligned(64))), tCU[nLanes] __attribute__((aligned(64))); \
+  int lin, col, l, i; \
+\
+  for (i=0; i<16; i++) \
+    tab[i]=(int8_t)matrizPesos[i/4][i%4]; \
+  vTab=TAB(tab); \
+  for (l=0; l<nLanes; l++) \
+    t[l]=(int16_t)(pares[l] ? pares[l]->tamMaior+1 : 0); \
+  vTamMaior=LOAD(t); \
+  for (l=0; l<nLanes; l++) \
+    t[l]=(int16_t)(pares[l] ? pares[l]->tamMenor+1 : 0); \
+  vTamMenor=LOAD(t); \
+\
+  for (col=1; col<=maxMaior; col++) \
+  { \
+    for (l=0; l<nLanes; l++) \
+      t[l]=(int16_t)(((pares[l]&&(col<=pares[l]->tamMaior)) ? baseEm(&basesLote, pares[l]->inicioMaior+col-1) : 0)<<8); \
+    codCol[col]=LOAD(t); \
+  } \
+  for (col=0; col<=maxMaior; col++) \
+    linha[col]=SET1(-col*penalGap); \
+\
+  for (lin=1; lin<=maxMenor; lin++) \
+  { \
+    for (l=0; l<nLanes; l++) \
+      t[l]=(int16_t)((((pares[l]&&(lin<=pares[l]->tamMenor)) ? 4*baseEm(&basesLote, pares[l]->inicioMenor+lin-1) : 0)<<8)|0x80); \
+    vCodLin=LOAD(t); \
+    vLin=SET1(lin); \
+    validaLin=GT(vTamMenor, vLin); \
+    vDiag=linha[0]; \
+    vEsq=linha[0]=SET1(-lin*penalGap); \
+    for (col=1; col<=maxMaior; col++) \
+    { \
+      vCima=linha[col]; \
+      vH=ADDS(vDiag, PESO(vTab, ADD(vCodLin, codCol[col]))); \
+      vH=MAX(vH, SUBS(vCima, vGap)); \
+      vH=MAX(vH, SUBS(vEsq, vGap)); \
+      linha[col]=vH; \
+      vDiag=vCima; \
+      vEsq=vH; \
+\
+      /* celulas fora do par da lane nao contam para os maiores escores */ \
+      vCol=SET1(col); \
+      valida=E(GT(vTamMaior, vCol), validaLin); \
+      vH=ESCOLHE(valida, vNeg, vH); \
+      maior=GT(vH, bestP); \
+      bestP=MAX(bestP, vH); \
+      linP=ESCOLHE(maior, linP, vLin); \
+      colP=ESCOLHE(maior, colP, vCol); \
+      maior=GT(bestU, vH); \
+      bestU=ESCOLHE(maior, vH, bestU); \
+      linU=ESCOLHE(maior, vLin, linU); \
+      colU=ESCOLHE(maior, vCol, colU); \
+    } \
+  } \
+\
+  *(VT*)tP=bestP; *(VT*)tLP=linP; *(VT*)tCP=colP; \
+  *(VT*)tU=bestU; *(VT*)tLU=linU; *(VT*)tCU=colU; \
+  for (l=0; l<nLanes; l++) \
+    if (pares[l]) \
+    { \
+      pares[l]->PMaior=tP[l]; \
+      pares[l]->linPMaior=tLP[l]; \
+      pares[l]->colPMaior=tCP[l]; \
+      pares[l]->UMaior=tU[l]; \
+      pares[l]->linUMaior=tLU[l]; \
+      pares[l]->colUMaior=tCU[l]; \
+    } \
+}
+
+DEFINE_KERNEL_LOTE(loteSse, "sse4.1", __m128i, __m128i, SSE_CARREGA, _mm_set1_epi16, _mm_add_epi16, _mm_adds_epi16, _mm_subs_epi16, _mm_max_epi16, SSE_GT, SSE_E, SSE_ESCOLHE, SSE_PESO, SSE_TAB)
+DEFINE_KERNEL_LOTE(loteAvx2, "avx2", __m256i, __m256i, AVX2_CARREGA, _mm256_set1_epi16, _mm256_add_epi16, _mm256_adds_epi16, _mm256_subs_epi16, _mm256_max_epi16, AVX2_GT, AVX2_E, AVX2_ESCOLHE, AVX2_PESO, AVX2_TAB)
+DEFINE_KERNEL_LOTE(loteAvx512, "avx512f,avx512bw", __m512i, __mmask32, AVX512_CARREGA, _mm512_set1_epi16, _mm512_add_epi16, _mm512_adds_epi16, _mm512_subs_epi16, _mm512_max_epi16, AVX512_GT, AVX512_E, AVX512_ESCOLHE, AVX512_PESO, AVX512_TAB)
+
+KernelLote kernelsLote[NUM_KERNELS]={NULL, loteSse, loteAvx2, loteAvx512};
+
+#else
+
+KernelLote kernelsLote[NUM_KERNELS]={NULL};
+
+#endif
+
+/* ordena os pares por tamanho da sequencia maior e, depois, da menor */
+int comparaPares(const void *a, const void *b)
+{ const ParLote *p=*(ParLote* const*)a, *q=*(ParLote* const*)b;
+
+  if (p->tamMaior!=q->tamMaior)
+    return (p->tamMaior<q->tamMaior) ? -1 : 1;
+  if (p->tamMenor!=q->tamMenor)
+    return (p->tamMenor<q->tamMenor) ? -1 : 1;
+  return 0;
+}
+
+/* verdadeiro se os escores e as posicoes do par cabem em lanes de 16 bits:
+   celulas vizinhas diferem de no maximo delta, entao nenhum escore se afasta de
+   zero mais que (tamMaior+tamMenor+2)*delta */
+int parCabeEm16Bits(ParLote *par, int delta)
+{
+  return (par->tamMaior<INT16_MAX-1)&&
+         ((long long)(par->tamMaior+par->tamMenor+2)*delta<INT16_MAX/2);
+}
+
+/* Fila de trabalho do lote. As tarefas sao os pares do laco escalar (os mais
+   longos), um por tarefa, seguidos dos vetores de nLanes pares, do mais longo
+   para o mais curto, para que as tarefas caras saiam primeiro e as curtas
+   equilibrem o fim. A fila eh so um contador: cada trabalhador pega a proxima
+   tarefa com um incremento atomico, sem trava, e escreve os escores apenas nos
+   pares dessa tarefa. */
+
+#define MAXTRABALHADORES 256
+
+typedef struct {
+  ParLote **ordem;        /* nVetor pares ordenados por tamanho e, depois, os escalares */
+  KernelLote kernel;
+  int nVetor, nEscalar, nLanes, numTarefas;
+  int proximaTarefa;      /* proxima tarefa livre, pega com __atomic_fetch_add */
+} FilaLote;
+
+typedef struct {
+  FilaLote *fila;
+  pthread_t thread;
+  char *area;             /* areas do trabalhador, reaproveitadas de um par para o outro */
+  int *linha;
+  unsigned char *bases;
+  int tarefas, pares;     /* totais do trabalhador, somados no fim do lote */
+  double celulas, tempo;
+} TrabalhadorLote;
+
+/* retira tarefas da fila ate esvazia-la, usando so as areas do trabalhador */
+void *trabalhadorLote(void *arg)
+{ TrabalhadorLote *w=(TrabalhadorLote*)arg;
+  FilaLote *f=w->fila;
+  ParLote *lote[64], *par;
+  int t, i, l, maxMaior, maxMenor, tarefas=0, pares=0;
+  double celulas=0, inicio=tempoAtual();
+
+  while ((t=__atomic_fetch_add(&f->proximaTarefa, 1, __ATOMIC_RELAXED))<f->numTarefas)
+  {
+    tarefas++;
+    if (t<f->nEscalar)
+    {
+      par=f->ordem[f->nVetor+t];
+      calculaParEscalar(par, w->linha, w->bases);
+      pares++;
+      celulas+=(double)par->tamMaior*par->tamMenor;
+      continue;
+    }
+
+    i=(f->numTarefas-1-t)*f->nLanes;
+    maxMaior=0;
+    maxMenor=0;
+    for (l=0; l<f->nLanes; l++)
+    {
+      lote[l]=(i+l<f->nVetor) ? f->ordem[i+l] : NULL;
+      if (lote[l]==NULL)
+        continue;
+      if (lote[l]->tamMaior>maxMaior)
+        maxMaior=lote[l]->tamMaior;
+      if (lote[l]->tamMenor>maxMenor)
+        maxMenor=lote[l]->tamMenor;
+      pares++;
+      celulas+=(double)lote[l]->tamMaior*lote[l]->tamMenor;
+    }
+    f->kernel(lote, maxMaior, maxMenor, alinhaPonteiro(w->area));
+  }
+
+  w->tarefas=tarefas;
+  w->pares=pares;
+  w->celulas=celulas;
+  w->tempo=tempoAtual()-inicio;
+  return NULL;
+}
+
+/* alinha todos os pares carregados, em lotes de nLanes pares por vetor, com
+   nTrabalhadores threads retirando tarefas da fila, e registra em cada par o
+   primeiro e o ultimo maior escore. Retorna 0 se o lote nao puder ser
+   alinhado. */
+int alinhaLote(int nTrabalhadores)
+{ FilaLote fila;
+  TrabalhadorLote *trab;
+  ParLote **ordem;
+  int isa, pesoMax=0, delta, maxVetor=0, maxEscalar=0, criados, falhou=0, maxPares=0, minPares=INT_MAX;
+  int i, j;
+  double inicio, tempo, celulas=0;
+
+  if (numPares==0)
+  {
+    printf("\nNenhum par de sequencias carregado.\n");
+    return 0;
+  }
+  if (penalAbre>0)
+  {
+    printf("\nO alinhamento em lote usa apenas gaps lineares (sem a opcao -g).\n");
+    return 0;
+  }
+
+  /* o kernel vetorial precisa de pesos que caibam na tabela de bytes */
+  isa=(kernelForcado>=0) ? kernelForcado : melhorKernelCpu();
+  if (isa>melhorKernelCpu())
+    isa=melhorKernelCpu();
+  for (i=0; i<4; i++)
+    for (j=0; j<4; j++)
+    {
+      if (abs(matrizPesos[i][j])>pesoMax)
+        pesoMax=abs(matrizPesos[i][j]);
+      if ((matrizPesos[i][j]<INT8_MIN)||(matrizPesos[i][j]>INT8_MAX))
+        isa=KERNEL_ESCALAR;
+    }
+  fila.kernel=kernelsLote[isa];
+  fila.nLanes=(isa==KERNEL_AVX512) ? 32 : (isa==KERNEL_AVX2) ? 16 : 8;
+  delta=penalGap+pesoMax;
+
+  /* pares que cabem em 16 bits no inicio, ordenados por tamanho, e os demais
+     no fim */
+  ordem=malloc(numPares*sizeof(ParLote*));
+  if (ordem==NULL)
+  {
+    printf("\nMemoria insuficiente para o lote de pares\n");
+    return 0;
+  }
+  fila.nVetor=0;
+  fila.nEscalar=0;
+  for (i=0; i<numPares; i++)
+    if ((fila.kernel!=NULL)&&parCabeEm16Bits(&paresLote[i], delta))
+    {
+      ordem[fila.nVetor++]=&paresLote[i];
+      if (paresLote[i].tamMaior>maxVetor)
+        maxVetor=paresLote[i].tamMaior;
     }
-
-    fprintf(arquivo, "Matriz de escores Atual:\n");
-
-    fprintf(arquivo, "%4c%4c", ' ', ' ');
-    for (int i = 0; i <= tamSeqMaior; i++) {
-        fprintf(arquivo, "%4d", i);
+    else
+    {
+      ordem[numPares-1-fila.nEscalar++]=&paresLote[i];
+      if (paresLote[i].tamMaior>maxEscalar)
+        maxEscalar=paresLote[i].tamMaior;
     }
-    fprintf(arquivo, "\n");
-
-    fprintf(arquivo, "%4c%4c%4c", ' ', ' ', '-');
-    for (int i = 0; i < tamSeqMaior; i++) {
-        fprintf(arquivo, "%4c", mapaBases[(seqMaior[i])]);
+  qsort(ordem, fila.nVetor, sizeof(ParLote*), comparaPares);
+  fila.ordem=ordem;
+  fila.numTarefas=fila.nEscalar+(fila.nVetor+fila.nLanes-1)/fila.nLanes;
+  fila.proximaTarefa=0;
+
+  /* nao adianta ter mais trabalhadores que tarefas */
+  if (nTrabalhadores>fila.numTarefas)
+    nTrabalhadores=fila.numTarefas;
+  if (nTrabalhadores>MAXTRABALHADORES)
+    nTrabalhadores=MAXTRABALHADORES;
+  if (nTrabalhadores<1)
+    nTrabalhadores=1;
+
+  trab=calloc(nTrabalhadores, sizeof(TrabalhadorLote));
+  for (i=0; (trab!=NULL)&&(i<nTrabalhadores); i++)
+  {
+    trab[i].fila=&fila;
+    trab[i].area=malloc((size_t)2*(maxVetor+1)*64+64);
+    trab[i].linha=malloc((size_t)(maxEscalar+1)*sizeof(int));
+    trab[i].bases=malloc((size_t)maxEscalar+1);
+    if ((trab[i].area==NULL)||(trab[i].linha==NULL)||(trab[i].bases==NULL))
+      falhou=1;
+  }
+  if ((trab==NULL)||falhou)
+  {
+    printf("\nMemoria insuficiente para o lote de pares\n");
+    for (i=0; (trab!=NULL)&&(i<nTrabalhadores); i++)
+    {
+      free(trab[i].area);
+      free(trab[i].linha);
+      free(trab[i].bases);
     }
-    fprintf(arquivo, "\n");
+    free(trab);
+    free(ordem);
+    return 0;
+  }
 
-    fprintf(arquivo, "%4c%4c", '0', '-');
-    for (int col = 0; col <= tamSeqMaior; col++) {
-        fprintf(arquivo, "%4d", matrizEscores[0][col]);
-    }
-    fprintf(arquivo, "\n");
+  /* o trabalhador 0 eh a propria thread chamadora; se alguma thread nao puder
+     ser criada, os trabalhadores ja criados esvaziam a fila sozinhos */
+  inicio=tempoAtual();
+  for (criados=1; criados<nTrabalhadores; criados++)
+    if (pthread_create(&trab[criados].thread, NULL, trabalhadorLote, &trab[criados])!=0)
+      break;
+  trabalhadorLote(&trab[0]);
+  for (i=1; i<criados; i++)
+    pthread_join(trab[i].thread, NULL);
+  tempo=tempoAtual()-inicio;
+
+  for (i=0; i<criados; i++)
+  {
+    celulas+=trab[i].celulas;
+    if (trab[i].pares>maxPares)
+      maxPares=trab[i].pares;
+    if (trab[i].pares<minPares)
+      minPares=trab[i].pares;
+  }
+  printf("\nLote de %d pares alinhado: %d em lanes de 16 bits (%s, %d pares por vetor), %d pelo laco escalar",
+         numPares, fila.nVetor, nomeKernel[isa], fila.nLanes, fila.nEscalar);
+  printf("\nTrabalhadores = %d (de %d a %d pares cada)", criados, minPares, maxPares);
+  printf("\nTempo do lote = %.3f s (%.0f pares/s, %.1f milhoes de celulas/s)\n", tempo,
+         tempo > 0 ? numPares / tempo : 0.0, tempo > 0 ? celulas / tempo / 1e6 : 0.0);
 
-    for (int lin = 1; lin <= tamSeqMenor; lin++) {
-        fprintf(arquivo, "%4d%4c", lin, mapaBases[(seqMenor[lin - 1])]);
-        for (int col = 0; col <= tamSeqMaior; col++) {
-            fprintf(arquivo, "%4d", matrizEscores[lin][col]);
-        }
-        fprintf(arquivo, "\n");
-    }
+  for (i=0; i<nTrabalhadores; i++)
+  {
+    free(trab[i].area);
+    free(trab[i].linha);
+    free(trab[i].bases);
+  }
+  free(trab);
+  free(ordem);
+  return 1;
+}
 
-    fclose(arquivo);
-    printf("Matriz de scores salva no arquivo '%s'\n", nomeArquivo);
+/* numero de trabalhadores do lote: o da opcao -n ou, sem ela, um por nucleo */
+int trabalhadoresLote(void)
+{ long nucleos;
+
+  if (numthreads>0)
+    return numthreads;
+  nucleos=sysconf(_SC_NPROCESSORS_ONLN);
+  return (nucleos<1) ? 1 : (nucleos>MAXTRABALHADORES) ? MAXTRABALHADORES : (int)nucleos;
 }
 
-/* imprime a matriz de escores de acordo */
-void mostraMatrizEscores()
-{ int i, lin, col;
+/* grava o primeiro e o ultimo maior escore de cada par, na ordem do arquivo */
+void salvaResultadosLote(const char *nomeArquivo)
+{ FILE *arq;
+  ParLote *par;
+  int i;
 
-  printf("\nMatriz de escores Atual:\n");
+  arq=fopen(nomeArquivo, "w");
+  if (arq==NULL)
+  {
+    perror("Erro ao abrir o arquivo");
+    return;
+  }
+  for (i=0; i<numPares; i++)
+  {
+    par=&paresLote[i];
+    fprintf(arq, "Par %d (%d x %d): Primeiro Maior escore = %d na celula [%d,%d], Ultimo Maior escore = %d na celula [%d,%d]\n",
+            i+1, par->tamMenor, par->tamMaior, par->PMaior, par->linPMaior, par->colPMaior,
+            par->UMaior, par->linUMaior, par->colUMaior);
+  }
+  fclose(arq);
+  printf("Resultados do lote salvos no arquivo '%s'\n", nomeArquivo);
+}
 
-  printf("%4c%4c",' ',' ');
-  for (i=0; i<=tamSeqMaior; i++)
-    printf("%4d",i);
-  printf("\n");
+/* Modo nao interativo (opcoes -i e -j). Em vez do menu, o programa le os pares
+   de um arquivo (linhas, FASTA ou FASTQ, como na opcao 5), alinha cada par com
+   o metodo, o numero de threads, o numero de alinhamentos e a celula inicial
+   dados na linha de comando e escreve os resultados na saida padrao ou no
+   arquivo da opcao -o. As mensagens de andamento e de erro vao para a saida de
+   erros, de modo que a saida padrao so tem resultados. Com -i, so o primeiro
+   par eh alinhado, como se fosse pelo menu; com -j (modo de tarefas), todos os
+   pares do arquivo sao alinhados no mesmo processo, sem gravar a matriz de
+   escores de cada um e mantendo a area da matriz de um par para o outro. */
+
+#define SAIDA_TEXTO  0 /* blocos de texto, como na opcao 10 */
+#define SAIDA_TABELA 1 /* uma linha por alinhamento, campos separados por tab */
+#define SAIDA_SAM    2 /* registros SAM, com CIGAR e MD, a seqMaior como referencia */
+#define SAIDA_PAF    3 /* registros PAF, com CIGAR (cg) e diferencas (cs) */
+
+/* SAM e PAF escrevem as operacoes do traceback, sem as colunas do alinhamento:
+   o tamanho da saida acompanha o numero de edicoes, nao o de colunas */
+#define SAIDA_OPERACOES(f) ((f)>=SAIDA_SAM)
+
+int formatoSaida=SAIDA_TEXTO;   /* opcao -f */
+int tipoMaior=1;                /* opcao -m: 1 = primeiro, 2 = ultimo maior */
+
+/* le os pesos da opcao -w: "igual,diferente" ou os 16 pesos da matriz, linha
+   a linha, separados por virgulas. Retorna 0 se o texto for invalido. */
+int lePesosTexto(const char *texto)
+{ int v[16], n=0, i, j;
+  const char *p=texto;
+  char *fim;
+
+  while (n<16)
+  {
+    v[n++]=(int)strtol(p, &fim, 10);
+    if (fim==p)
+      return 0;
+    p=fim;
+    if (*p!=',')
+      break;
+    p++;
+  }
+  if ((*p!='\0')||((n!=2)&&(n!=16)))
+    return 0;
+  for (i=0; i<4; i++)
+    for (j=0; j<4; j++)
+      matrizPesos[i][j]=(n==2) ? ((i==j) ? v[0] : v[1]) : v[4*i+j];
+  return 1;
+}
 
-  printf("%4c%4c%4c",' ',' ','-');
-  for (i=0; i<tamSeqMaior; i++)
-    printf("%4c",mapaBases[(seqMaior[i])]);
-  printf("\n");
+/* escreve o nome de um registro ou, sem nome, "seq" e a sua posicao */
+void escreveNome(FILE *saida, const RegistroSeq *r)
+{
+  if (r->tamNome>0)
+    fprintf(saida, "%.*s", r->tamNome, r->nome);
+  else
+    fprintf(saida, "seq%zu", r->indice);
+}
 
-  printf("%4c%4c",'0','-');
-  for (col=0; col<=tamSeqMaior; col++)
-    printf("%4d",matrizEscores[0][col]);
-  printf("\n");
+/* escreve as tam posicoes de uma sequencia alinhada */
+void escreveBases(FILE *saida, const SeqCompacta *s, int tam)
+{ char buf[4096];
+  int i, n=0;
 
-  for (lin=1;lin<=tamSeqMenor;lin++)
+  for (i=0; i<tam; i++)
   {
-    printf("%4d%4c",lin,mapaBases[(seqMenor[lin-1])]);
-    for (col=0;col<=tamSeqMaior;col++)
+    buf[n++]=mapaBases[baseEm(s, i)];
+    if (n==(int)sizeof(buf))
     {
-      printf("%4d",matrizEscores[lin][col]);
+      fwrite(buf, 1, n, saida);
+      n=0;
     }
-    printf("\n");
   }
+  fwrite(buf, 1, n, saida);
 }
 
+/* contagens de um alinhamento em operacoes: bases consumidas de cada sequencia,
+   colunas, bases iguais e edicoes (trocas, bases inseridas e removidas) */
+typedef struct {
+  int lin, col, colunas, iguais, edicoes;
+} ResumoCigar;
 
-/* mostra os alinhamentos */
-void mostraAlinhamentoGlobal(void)
-{   int i;
-
-  printf("\nAlinhamento Obtido - Tamanho = %d:\n", tamAlinha);
-
-  printf("%c",mapaBases[alinhaGMaior[0]]);
-  for (i=1; i<tamAlinha; i++)
-    printf("%c",mapaBases[alinhaGMaior[i]]);
-  printf("\n");
+void resumeCigar(const Cigar *c, ResumoCigar *r)
+{ int i, op, n;
 
-  printf("%c",mapaBases[alinhaGMenor[0]]);
-  for (i=1; i<tamAlinha; i++)
-    printf("%c",mapaBases[alinhaGMenor[i]]);
-  printf("\n");
+  memset(r, 0, sizeof(*r));
+  for (i=c->ini; i<c->cap; i++)
+  {
+    op=c->ops[i]&0xF;
+    n=c->ops[i]>>4;
+    r->colunas+=n;
+    if (op!=OP_REMOVE)
+      r->lin+=n;
+    if (op!=OP_INSERE)
+      r->col+=n;
+    if (op==OP_IGUAL)
+      r->iguais+=n;
+    else
+      r->edicoes+=n;
+  }
 }
 
-/* gera o alinhamento global por meio do percurso de retorno na Matriz de escores,
-   em duas formas possiveis, conforme o parametro tipo: 1) a partir da celula do
-   primeiro maior escore [linPMaior,colPMaior] ou 2) a partir da celula de ultimo
-   maior escore [linUMaior,colUMaior], ambos em direcao a celula inicial [0,0],
-   uma celula por vez. O caminho de retorno deve ser feito seguindo o mesmo caminho
-   inverso que gerou a celular final a partir da celula inicial. O alinhamento
-   global eh composto por duas sequencias alinhaGMenor e alinhaGMaior.
-
-   Note que outros alinhamentos globais podem ser encontrados se o percurso do
-   traceback for ramificado em celulas que foram "escoreadas/pontuadas" por meio
-   de uma estrategia de desempate, pelo fato de ter havido empate na pontuacao
-   dos nohs vizinhos. Alem disso, alinhamentos parciais tambem podem ser obtidos
-   com traceback iniciado a partir de qualquer c�lula */
+/* escreve o CIGAR com M para = e X juntos (codigo 0 do BAM), como no SAM; com
+   recorte, o resto da seqMenor depois do alinhamento sai como S */
+void escreveCigar(FILE *saida, const Cigar *c, int recorte)
+{ int i, op, n, opAnt=-1, nAnt=0, lin=0;
 
-int k = 1;  // Número de alinhamentos que o usuário deseja gerar
-typedef struct {
-    int alinhaGMaior[maxSeq];
-    int alinhaGMenor[maxSeq];
-    int tamAlinha;
-} Alinhamento;
+  for (i=c->ini; i<c->cap; i++)
+  {
+    op=c->ops[i]&0xF;
+    n=c->ops[i]>>4;
+    if (op!=OP_REMOVE)
+      lin+=n;
+    if ((op==OP_IGUAL)||(op==OP_TROCA))
+      op=0;
+    if (op==opAnt)
+    {
+      nAnt+=n;
+      continue;
+    }
+    if (nAnt>0)
+      fprintf(saida, "%d%c", nAnt, "MID"[opAnt]);
+    opAnt=op;
+    nAnt=n;
+  }
+  if (nAnt>0)
+    fprintf(saida, "%d%c", nAnt, "MID"[opAnt]);
+  if (recorte&&(lin<tamSeqMenor))
+    fprintf(saida, "%dS", tamSeqMenor-lin);
+}
 
-Alinhamento resultados[MAXTHREADS];
-int thread_count = 0;
-pthread_mutex_t mutex;
+/* escreve a cadeia MD do SAM: bases iguais contadas, a base da seqMaior em
+   cada troca e ^ seguido das bases removidas da seqMaior, que comeca na base
+   col da seqMaior */
+void escreveMD(FILE *saida, const Cigar *c, int col)
+{ int i, op, n, iguais=0;
 
-typedef struct {
-    int index;
-    int preferencia; // 0 para diagonal, 1 para cima, 2 para esquerda
-} ThreadArgs;
+  for (i=c->ini; i<c->cap; i++)
+  {
+    op=c->ops[i]&0xF;
+    n=c->ops[i]>>4;
+    if (op==OP_IGUAL)
+    {
+      iguais+=n;
+      col+=n;
+    }
+    else if (op==OP_TROCA)
+      for (; n>0; n--, col++)
+      {
+        fprintf(saida, "%d%c", iguais, mapaBases[baseEm(&seqMaior, col)]);
+        iguais=0;
+      }
+    else if (op==OP_REMOVE)
+    {
+      fprintf(saida, "%d^", iguais);
+      for (iguais=0; n>0; n--, col++)
+        fputc(mapaBases[baseEm(&seqMaior, col)], saida);
+    }
+  }
+  fprintf(saida, "%d", iguais);
+}
 
-void* traceBack(void* arg) {
-    ThreadArgs* tArgs = (ThreadArgs*)arg;
-    int index = tArgs->index;
-    int preferencia = tArgs->preferencia;
-    int tbLin = linPMaior;
-    int tbCol = colPMaior;
-    int pos = 0;
-    int peso, escoreDiag, escoreLin, escoreCol;
+/* copia em trecho o alinhamento c sem as bases removidas da seqMaior no
+   inicio e no fim, que o SAM e o PAF nao aceitam: as do inicio deslocam a
+   posicao do alinhamento na seqMaior, e as do fim ficam fora dele. Retorna quantas
+   bases foram tiradas do inicio. As operacoes continuam as de c. */
+int recortaDelecoes(const Cigar *c, Cigar *trecho)
+{ int removidas=0;
+
+  *trecho=*c;
+  while ((trecho->ini<trecho->cap)&&((int)(trecho->ops[trecho->ini]&0xF)==OP_REMOVE))
+    removidas+=(int)(trecho->ops[trecho->ini++]>>4);
+  while ((trecho->cap>trecho->ini)&&((int)(trecho->ops[trecho->cap-1]&0xF)==OP_REMOVE))
+    trecho->cap--;
+  return removidas;
+}
 
-    Alinhamento* resultado = &resultados[index];
+/* escreve a cadeia cs curta do PAF: :n para n bases iguais, *xy para a troca
+   da base x da seqMaior pela y da seqMenor, +bases inseridas e -bases
+   removidas, em minusculas. A primeira operacao comeca na base col da
+   seqMaior. */
+void escreveCs(FILE *saida, const Cigar *c, int col)
+{ int i, j, op, n, lin=0;
 
-    do {
-        peso = matrizPesos[(seqMenor[tbLin-1])][(seqMaior[tbCol-1])];
-        escoreDiag = matrizEscores[tbLin-1][tbCol-1] + peso;
-        escoreLin = matrizEscores[tbLin][tbCol-1] - penalGap;
-        escoreCol = matrizEscores[tbLin-1][tbCol] - penalGap;
-
-        // Escolha com base na preferência
-        if ((escoreDiag <= escoreLin) || (escoreDiag <= escoreCol)) {
-            if (preferencia == 0) {
-                resultado->alinhaGMenor[pos] = seqMenor[tbLin-1];
-                resultado->alinhaGMaior[pos] = seqMaior[tbCol-1];
-                tbLin--;
-                tbCol--;
-                preferencia = (preferencia + index) % 3;
-                printf("Thread %d: Empate, escolha preferencial para diagonal\n", index);
-            } else if (preferencia == 1) {
-                resultado->alinhaGMenor[pos] = X;
-                resultado->alinhaGMaior[pos] = seqMaior[tbCol-1];
-                tbCol--;
-                preferencia = (preferencia + index) % 3;
-                printf("Thread %d: Empate, escolha preferencial para cima\n", index);
-            } else {
-                resultado->alinhaGMenor[pos] = seqMenor[tbLin-1];
-                resultado->alinhaGMaior[pos] = X;
-                tbLin--;
-                
-                printf("Thread %d: Empate, escolha preferencial para esquerda\n", index);
-            }
-        } else {
-            if (escoreDiag >= escoreLin && escoreDiag >= escoreCol) {
-                resultado->alinhaGMenor[pos] = seqMenor[tbLin-1];
-                resultado->alinhaGMaior[pos] = seqMaior[tbCol-1];
-                tbLin--;
-                tbCol--;
-                printf("Thread %d: Escolha para diagonal\n", index);
-            } else if (escoreLin >= escoreCol) {
-                resultado->alinhaGMenor[pos] = X;
-                resultado->alinhaGMaior[pos] = seqMaior[tbCol-1];
-                tbCol--;
-                printf("Thread %d: Escolha para cima\n", index);
-            } else {
-                resultado->alinhaGMenor[pos] = seqMenor[tbLin-1];
-                resultado->alinhaGMaior[pos] = X;
-                tbLin--;
-                printf("Thread %d: Escolha para esquerda\n", index);
-            }
+  for (i=c->ini; i<c->cap; i++)
+  {
+    op=c->ops[i]&0xF;
+    n=c->ops[i]>>4;
+    if (op==OP_IGUAL)
+      fprintf(saida, ":%d", n);
+    else
+    {
+      fputc((op==OP_TROCA) ? '*' : (op==OP_INSERE) ? '+' : '-', saida);
+      for (j=0; j<n; j++)
+        if (op==OP_TROCA)
+        {
+          fputc(tolower(mapaBases[baseEm(&seqMaior, col+j)]), saida);
+          fputc(tolower(mapaBases[baseEm(&seqMenor, lin+j)]), saida);
+          if (j+1<n)
+            fputc('*', saida);
         }
-        
-        pos++;
-    } while (tbLin > 0 && tbCol > 0);
+        else
+          fputc(tolower(mapaBases[(op==OP_INSERE) ? baseEm(&seqMenor, lin+j) : baseEm(&seqMaior, col+j)]), saida);
+    }
+    if (op!=OP_REMOVE)
+      lin+=n;
+    if (op!=OP_INSERE)
+      col+=n;
+  }
+}
 
-    // Adicionar gaps restantes
-    while (tbLin > 0) {
-        resultado->alinhaGMenor[pos] = seqMenor[tbLin-1];
-        resultado->alinhaGMaior[pos] = X;
-        tbLin--;
-        pos++;
+/* escreve um resultado no formato da opcao -f: em colunas (gMaior, gMenor e
+   tam), no texto e na tabela, ou em operacoes (cig), no SAM e no PAF. Sem
+   alinhamento (gMaior e cig nulos, no modo so escore), escreve apenas o escore
+   e a celula. Os alinhamentos alem do primeiro saem como secundarios. */
+void escreveResultado(FILE *saida, int numPar, int numAlinha, const RegistroSeq *maior, const RegistroSeq *menor,
+                      int escore, int lin, int col, const SeqCompacta *gMaior, const SeqCompacta *gMenor, int tam,
+                      const Cigar *cig)
+{ ResumoCigar r={0, 0, 0, 0, 0};
+  Cigar trecho;
+  int removidas=0;
+
+  if (cig!=NULL)
+  {
+    resumeCigar(cig, &r);
+    lin=r.lin;
+    col=r.col;
+  }
+  if (formatoSaida==SAIDA_SAM)
+  {
+    // as delecoes das pontas saem do CIGAR, do MD e do NM; as do inicio vao
+    // para a posicao
+    if (cig!=NULL)
+    {
+      removidas=recortaDelecoes(cig, &trecho);
+      resumeCigar(&trecho, &r);
     }
-    while (tbCol > 0) {
-        resultado->alinhaGMenor[pos] = X;
-        resultado->alinhaGMaior[pos] = seqMaior[tbCol-1];
-        tbCol--;
-        pos++;
+    escreveNome(saida, menor);
+    fprintf(saida, "\t%d\t", (numAlinha>1) ? 256 : 0);
+    escreveNome(saida, maior);
+    fprintf(saida, "\t%d\t255\t", removidas+1);
+    if (cig!=NULL)
+      escreveCigar(saida, &trecho, 1);
+    else
+      fputc('*', saida);
+    fprintf(saida, "\t*\t0\t0\t*\t*\tAS:i:%d", escore);
+    if (cig!=NULL)
+    {
+      fprintf(saida, "\tNM:i:%d\tMD:Z:", r.edicoes);
+      escreveMD(saida, &trecho, removidas);
     }
-    resultado->tamAlinha = pos;
-
-    // Inverter o alinhamento para a ordem correta
-    for (int i = 0; i < pos / 2; i++) {
-        int aux = resultado->alinhaGMenor[i];
-        resultado->alinhaGMenor[i] = resultado->alinhaGMenor[pos-i-1];
-        resultado->alinhaGMenor[pos-i-1] = aux;
-
-        aux = resultado->alinhaGMaior[i];
-        resultado->alinhaGMaior[i] = resultado->alinhaGMaior[pos-i-1];
-        resultado->alinhaGMaior[pos-i-1] = aux;
+    fputc('\n', saida);
+    return;
+  }
+  if (formatoSaida==SAIDA_PAF)
+  {
+    // como no SAM, as delecoes das pontas ficam fora do alinhamento: as do
+    // inicio vao para o inicio na seqMaior
+    if (cig!=NULL)
+    {
+      removidas=recortaDelecoes(cig, &trecho);
+      resumeCigar(&trecho, &r);
+      col=removidas+r.col;
     }
+    escreveNome(saida, menor);
+    fprintf(saida, "\t%d\t0\t%d\t+\t", tamSeqMenor, lin);
+    escreveNome(saida, maior);
+    fprintf(saida, "\t%d\t%d\t%d\t%d\t%d\t255\ttp:A:%c\tAS:i:%d", tamSeqMaior, removidas, col, r.iguais,
+            r.colunas, (numAlinha>1) ? 'S' : 'P', escore);
+    if (cig!=NULL)
+    {
+      fprintf(saida, "\tNM:i:%d\tcg:Z:", r.edicoes);
+      escreveCigar(saida, &trecho, 0);
+      fprintf(saida, "\tcs:Z:");
+      escreveCs(saida, &trecho, removidas);
+    }
+    fputc('\n', saida);
+    return;
+  }
 
-    pthread_mutex_lock(&mutex);
-    thread_count++;
-    pthread_mutex_unlock(&mutex);
-    
-    pthread_exit(NULL);
-}
-
-void iniciarTraceBack(int tipo) {
-    pthread_t threads[k];
-    ThreadArgs* thread_args = malloc(k * sizeof(ThreadArgs));
-    int* preferencia = malloc(k * sizeof(int));
-    
-    // Inicializar preferências de forma aleatória
-    srand(time(NULL));
-    for (int i = 0; i < k; i++) {
-        preferencia[i] = rand() % 3; // 0 para diagonal, 1 para cima, 2 para esquerda
+  if (formatoSaida==SAIDA_TABELA)
+  {
+    fprintf(saida, "%d\t", numPar);
+    escreveNome(saida, maior);
+    fprintf(saida, "\t");
+    escreveNome(saida, menor);
+    fprintf(saida, "\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t", tamSeqMaior, tamSeqMenor, numAlinha, escore, lin, col,
+            (gMaior!=NULL) ? tam : 0);
+    if (gMaior==NULL)
+      fprintf(saida, "*\t*\n");
+    else
+    {
+      escreveBases(saida, gMaior, tam);
+      fprintf(saida, "\t");
+      escreveBases(saida, gMenor, tam);
+      fprintf(saida, "\n");
     }
+    return;
+  }
 
-    thread_count = 0; // Resetar a contagem de threads a cada nova execução
-    pthread_mutex_init(&mutex, NULL);
+  if (numAlinha==1)
+  {
+    fprintf(saida, "Par %d: ", numPar);
+    escreveNome(saida, maior);
+    fprintf(saida, " (%d bases) x ", tamSeqMaior);
+    escreveNome(saida, menor);
+    fprintf(saida, " (%d bases)\nEscore = %d na celula [%d,%d]\n", tamSeqMenor, escore, lin, col);
+  }
+  if (gMaior!=NULL)
+  {
+    fprintf(saida, "Alinhamento %d - Tamanho = %d:\n", numAlinha, tam);
+    escreveBases(saida, gMaior, tam);
+    fprintf(saida, "\n");
+    escreveBases(saida, gMenor, tam);
+    fprintf(saida, "\n");
+  }
+}
 
-    for (int i = 0; i < k; i++) {
-        thread_args[i].index = i;
-        thread_args[i].preferencia = preferencia[i];
-        pthread_create(&threads[i], NULL, traceBack, &thread_args[i]);
-    }
+Cigar cigarColunas={NULL, 0, 0}; /* operacoes dos alinhamentos de Hirschberg e da banda */
 
-    for (int i = 0; i < k; i++) {
-        pthread_join(threads[i], NULL);
-    }
+/* alinha o par atual pelo metodo da opcao -a e escreve o resultado. Retorna 0
+   se o alinhamento nao puder ser feito. */
+int alinhaParAtual(FILE *saida, int numPar, const RegistroSeq *maior, const RegistroSeq *menor)
+{ int i, escore, lin, col;
 
-    // Copiar o primeiro alinhamento gerado para as variáveis globais
-    if (thread_count > 0) {
-        tamAlinha = resultados[0].tamAlinha;
-        for (int j = 0; j < tamAlinha; j++) {
-            alinhaGMaior[j] = resultados[0].alinhaGMaior[j];
-            alinhaGMenor[j] = resultados[0].alinhaGMenor[j];
-        }
+  if ((modoAlinhamento!=1)&&(penalAbre>0))
+  {
+    printf("\nOs metodos de Hirschberg e da banda usam apenas gaps lineares (sem a opcao -g).\n");
+    return 0;
+  }
+  tamAlinha=-1;
+  if (modoAlinhamento==2)
+    alinhamentoHirschberg(tipoMaior, numthreads);
+  else if (modoAlinhamento==3)
+    alinhamentoBanda(tipoMaior, &escore, &lin, &col);
+  else
+  {
+    geraMatrizEscores(numthreads);
+    if (modoPreenchimento==MODO_ESCORE)
+    {
+      // sem matriz, a contagem so avisa que nao pode ser feita
+      if (bitsContagem>0)
+        contaAlinhamentosOtimos(numthreads);
+      escreveResultado(saida, numPar, 1, maior, menor, (tipoMaior==1) ? PMaior : UMaior,
+                       (tipoMaior==1) ? linPMaior : linUMaior, (tipoMaior==1) ? colPMaior : colUMaior, NULL, NULL, 0, NULL);
+      return 1;
     }
+    if ((matrizEscores==NULL)&&(matrizDirecoes==NULL)&&(linhasControle==NULL)&&(compacta.ancoras==NULL))
+      return 0;
+    if (bitsContagem>0)
+      contaAlinhamentosOtimos(numthreads);
+
+    iniciarTraceBack(tipoMaior);
+    for (i=0; i<thread_count; i++)
+      escreveResultado(saida, numPar, i+1, maior, menor, (tipoMaior==1) ? PMaior : UMaior,
+                       (tipoMaior==1) ? linPMaior : linUMaior, (tipoMaior==1) ? colPMaior : colUMaior,
+                       &resultados[i].alinhaGMaior, &resultados[i].alinhaGMenor, resultados[i].tamAlinha,
+                       SAIDA_OPERACOES(formatoSaida) ? &resultados[i].cigar : NULL);
+    return 1;
+  }
+  if (tamAlinha<0)
+    return 0;
+  if (SAIDA_OPERACOES(formatoSaida)&&!cigarDeColunas(&cigarColunas, &alinhaGMaior, &alinhaGMenor, tamAlinha))
+  {
+    printf("\nMemoria insuficiente para o alinhamento\n");
+    return 0;
+  }
+  if (modoAlinhamento==2)
+  {
+    escore=(tipoMaior==1) ? PMaior : UMaior;
+    lin=(tipoMaior==1) ? linPMaior : linUMaior;
+    col=(tipoMaior==1) ? colPMaior : colUMaior;
+  }
+  escreveResultado(saida, numPar, 1, maior, menor, escore, lin, col,
+                   &alinhaGMaior, &alinhaGMenor, tamAlinha, SAIDA_OPERACOES(formatoSaida) ? &cigarColunas : NULL);
+  return 1;
+}
 
-    pthread_mutex_destroy(&mutex);
-
-    free(thread_args);
-    free(preferencia);
+/* executa o modo nao interativo sobre o arquivo de pares: so o primeiro par
+   (todos=0, opcao -i) ou todos (todos=1, opcao -j), com os resultados em
+   nomeSaida ou, se ele for nulo, na saida padrao. Retorna o numero de pares
+   que nao puderam ser alinhados. */
+int executaTarefas(const char *nomeArquivo, int todos, const char *nomeSaida)
+{ LeitorSeq leitor;
+  RegistroSeq maior, menor;
+  FILE *saida;
+  int lido, numPar=0, erros=0;
+  double inicio=tempoAtual();
+
+  // a saida padrao passa a ser a de erros; os resultados vao para a original
+  fflush(stdout);
+  saida=(nomeSaida!=NULL) ? fopen(nomeSaida, "w") : fdopen(dup(STDOUT_FILENO), "w");
+  if (saida==NULL)
+  {
+    perror("Erro ao abrir a saida");
+    return 1;
+  }
+  dup2(STDERR_FILENO, STDOUT_FILENO);
+  if (!abreLeitor(&leitor, nomeArquivo))
+  {
+    fclose(saida);
+    return 1;
+  }
 
-    // Mostrar apenas os k alinhamentos únicos, sem duplicações
-    for (int i = 0; i < k; i++) {
-        printf("Alinhamento %d:\n", i + 1);
-        for (int j = 0; j < resultados[i].tamAlinha; j++) {
-            printf("%c", mapaBases[resultados[i].alinhaGMaior[j]]);
-        }
-        printf("\n");
-        for (int j = 0; j < resultados[i].tamAlinha; j++) {
-            printf("%c", mapaBases[resultados[i].alinhaGMenor[j]]);
-        }
-        printf("\n");
+  mostraDetalhes=0;
+  if (todos)
+  {
+    gravaMatriz=0;
+    reaproveitaArea=1;
+  }
+  if (numthreads<=0)
+    numthreads=1;
+  if (modoAlinhamento==0)
+    modoAlinhamento=1;
+  // no SAM e no PAF, o traceback na matriz nao precisa das colunas
+  alinhaEmColunas=!SAIDA_OPERACOES(formatoSaida);
+  if (formatoSaida==SAIDA_SAM)
+    fprintf(saida, "@HD\tVN:1.6\tSO:unsorted\n");
+  if (formatoSaida==SAIDA_TABELA)
+    fprintf(saida, "#par\tmaior\tmenor\ttamMaior\ttamMenor\talinhamento\tescore\tlin\tcol\ttamanho\talinhaMaior\talinhaMenor\n");
+
+  while ((lido=proximoPar(&leitor, &maior, &menor))>0)
+  {
+    numPar++;
+    if (!defineParLido(&maior, &menor)||!alinhaParAtual(saida, numPar, &maior, &menor))
+    {
+      printf("Par %d nao alinhado.\n", numPar);
+      erros++;
     }
+    if (!todos)
+      break;
+  }
+  if (lido<0)
+    erros++;
+  else if (numPar==0)
+  {
+    printf("O arquivo %s nao tem nenhum par de sequencias.\n", nomeArquivo);
+    erros++;
+  }
+  else if (!todos&&(proximoRegistro(&leitor, &maior)>0))
+    printf("O arquivo %s tem mais sequencias; apenas o primeiro par foi alinhado (use -j para todos).\n", nomeArquivo);
+  fechaLeitor(&leitor);
+
+  if (!todos&&exportaTexto&&((matrizEscores!=NULL)||(compacta.ancoras!=NULL)))
+    salvaMatrizEmArquivo("matriz_escores.txt");
+  aguardaEscritor();
+  if (fclose(saida)!=0)
+  {
+    perror("Erro ao gravar os resultados");
+    erros++;
+  }
+  printf("\n%d par(es) alinhado(s) em %.3f s, %d com erro.\n", numPar-(erros>numPar ? numPar : erros),
+         tempoAtual()-inicio, erros);
+  return erros;
 }
+
 /* menu de opcoes fornecido para o usuario */
 int menuOpcao(void)
 { int op;
@@ -828,7 +6408,8 @@ int menuOpcao(void)
     printf("\n<08> Mostrar Matriz de Escores");
     printf("\n<09> Gerar Alinhamento Global");
     printf("\n<10> Mostrar Alinhamento Global");
-    printf("\n<11> Sair");
+    printf("\n<11> Alinhar Lote de Pares Curtos");
+    printf("\n<12> Sair");
     printf("\nDigite a opcao => ");
     scanf("%d",&op);
     scanf("%c",&enter);
@@ -839,7 +6420,7 @@ int menuOpcao(void)
 
 /* trata a opcao fornecida pelo usuario, executando o modulo pertinente */
 void trataOpcao(int op)
-{ int resp;
+{ int resp, metodo, escore, lin, col;
   char enter;
   char fileName[100];
 
@@ -852,6 +6433,8 @@ void trataOpcao(int op)
     case 3: penalGap=lePenalidade();
             break;
     case 4: printf("\nPenalidade = %d",penalGap);
+            if (penalAbre>0)
+              printf("\nPenalidade de abertura de gap = %d",penalAbre);
             break;
     case 5: printf("\nDeseja Definicao: <1>MANUAL, <2>ALEATORIA? ou <3>ARQUIVO= "); /* TODO - leitura do arquivo deve ser inserida aqui */
             scanf("%d",&resp);
@@ -882,15 +6465,50 @@ void trataOpcao(int op)
               printf("Digite um numero valido de threads ( 0 > numthreads > %i) => ", MAXTHREADS);
               scanf("%i", &numthreads);
             }
+            if ((arquivoReaproveitado!=NULL)&&(modoPreenchimento==MODO_MATRIZ)&&(penalAbre==0)&&
+                carregaMatrizBinaria(arquivoReaproveitado))
+              break;
             geraMatrizEscores(numthreads);
-            salvaMatrizEmArquivo("matriz_escores.txt");
+            if (bitsContagem>0)
+              contaAlinhamentosOtimos(numthreads);
+            if (((matrizEscores!=NULL)||(compacta.ancoras!=NULL))&&exportaTexto)
+              salvaMatrizEmArquivo("matriz_escores.txt");
             break;
     case 8: mostraMatrizEscores();
             break;
-    case 9:
-            printf("Digite o valor de k (máximo %d): ", MAXTHREADS);
+    case 9: metodo=modoAlinhamento;
+            if (metodo==0)
+            {
+              printf("\nMetodo: <1> TraceBack na Matriz de Escores ou <2> Hirschberg (memoria linear) ou <3> Banda diagonal? = ");
+              scanf("%d", &metodo);
+              scanf("%c", &enter);
+            }
+            if (metodo==2)
+            {
+              printf("Digite o numero de threads utilizadas no alinhamento => : ");
+              scanf("%i", &numthreads);
+              while((numthreads <= 0)||(numthreads>MAXTHREADS))
+              {
+                printf("Digite um numero valido de threads ( 0 > numthreads > %i) => ", MAXTHREADS);
+                scanf("%i", &numthreads);
+              }
+              printf("\nDeseja: <1> Primeiro Maior ou <2> Ultimo Maior? = ");
+              scanf("%d", &resp);
+              scanf("%c", &enter);
+              alinhamentoHirschberg(resp, numthreads);
+              break;
+            }
+            if (metodo==3)
+            {
+              printf("\nDeseja: <1> Primeiro Maior ou <2> Ultimo Maior? = ");
+              scanf("%d", &resp);
+              scanf("%c", &enter);
+              alinhamentoBanda(resp, &escore, &lin, &col);
+              break;
+            }
+            printf("Digite o valor de k: ");
             scanf("%d", &k);
-            if (k > MAXTHREADS) k = MAXTHREADS;
+            if (k < 1) k = 1;
             printf("\nDeseja: <1> Primeiro Maior ou <2> Ultimo Maior? = ");
             scanf("%d", &resp);
             scanf("%c", &enter);
@@ -898,15 +6516,297 @@ void trataOpcao(int op)
             break;
     case 10: mostraAlinhamentoGlobal();
             break;
+    case 11: printf("Digite o nome do arquivo de pares: ");
+            scanf("%s", fileName);
+            if (leParesDeArquivo(fileName)&&alinhaLote(trabalhadoresLote()))
+              salvaResultadosLote("resultados_lote.txt");
+            break;
   }
 }
 
-/* programa principal */
-void main(void)
-{ int opcao;
+/* programa principal. Opcoes de linha de comando:
+     -a matriz       alinhamento por traceback na matriz de escores
+     -a hirschberg   alinhamento de Hirschberg, em memoria linear (o mesmo do
+                     traceback na matriz)
+     -a banda        alinhamento restrito a uma banda diagonal
+     -b largura      meia largura inicial da banda, em diagonais (sem a opcao,
+                     estimada pela divergencia esperada entre as sequencias)
+     -k kernel       kernel do preenchimento: escalar, sse41, avx2 ou avx512
+                     (sem a opcao, o melhor suportado pela CPU)
+     -d              modo de direcoes: o preenchimento grava apenas os bits de
+                     direcao do traceback, sem guardar a matriz de escores
+     -e              modo so escore: o preenchimento calcula apenas o primeiro e
+                     o ultimo maior escore e suas celulas, em memoria linear,
+                     sem matriz e sem gravar a matriz em arquivo
+     -z              modo da matriz compacta: a matriz de escores eh guardada
+                     em blocos, com o escore do canto e as diferencas entre
+                     celulas vizinhas em 2, 4, 8 ou 16 bits
+     -c MB           modo de linhas de controle: o preenchimento guarda uma
+                     linha de escores a cada tantas, no orcamento de MB
+                     megabytes, e o traceback recalcula as faixas entre elas
+                     (so com gaps lineares; se a matriz inteira couber no
+                     orcamento, ela eh guardada)
+     -t              exporta tambem a matriz de escores em texto, em
+                     matriz_escores.txt (a binaria, matriz_escores.bin, eh
+                     sempre gravada no modo da matriz)
+     -r arquivo      na opcao 7, mapeia a matriz de um arquivo binario gravado
+                     antes para as mesmas sequencias e parametros, em vez de
+                     preenche-la (so com gaps lineares)
+     -g abertura     gaps afins: cada gap custa abertura mais a penalidade de
+                     gap por posicao (so no preenchimento e no traceback na
+                     matriz; Hirschberg, banda e lote seguem lineares)
+     -p penalidade   penalidade de gap (opcao 3 do menu)
+     -w pesos        pesos do pareamento: "igual,diferente" ou os 16 pesos da
+                     matriz, linha a linha (A, T, G, C), separados por virgulas
+     -n threads      threads do preenchimento e do alinhamento de Hirschberg
+                     (ate 20), ou trabalhadores do lote da opcao -l (ate 256)
+     -y lin,col      blocos do preenchimento de lin linhas por col colunas
+                     (col multiplo de 64), sem o ajuste automatico
+     -u              ajusta o formato dos blocos no primeiro preenchimento,
+                     mesmo com o perfil ja gravado ou num alinhamento pequeno
+                     (sem a opcao, o ajuste so eh feito sem perfil e em
+                     alinhamentos grandes)
+     -P arquivo      perfil do formato dos blocos, em vez de ~/.nw_perfil_blocos
+     -q k            numero de alinhamentos otimos distintos do traceback na
+                     matriz (todos, se houver menos de k)
+     -m maior        celula inicial: primeiro ou ultimo maior escore
+     -x desempate    direcao preferida nos empates do traceback: diagonal,
+                     cima ou esquerda (sem a opcao, diagonal); define a ordem
+                     em que os k alinhamentos otimos sao enumerados
+     -s bits         conta os alinhamentos otimos a partir do primeiro e do
+                     ultimo maior escore, logo apos o preenchimento, com
+                     contadores de bits bits (multiplo de 64; 64 basta ate
+                     cerca de 1,8 x 10^19 alinhamentos, e acima do limite o
+                     contador satura)
+     -v eventos      rastro do traceback na matriz: cada caminho guarda os seus
+                     ultimos passos (ao menos eventos, arredondado para uma
+                     potencia de 2), decodificados em rastro_traceback.txt
+     -i arquivo      modo nao interativo: alinha o primeiro par do arquivo,
+                     sem o menu, e termina
+     -j arquivo      modo de tarefas: alinha todos os pares do arquivo, um
+                     apos o outro, no mesmo processo, e termina
+     -o arquivo      resultados de -i ou -j nesse arquivo, em vez da saida
+                     padrao (as mensagens vao sempre para a saida de erros)
+     -f formato      formato dos resultados de -i ou -j: texto, tabela, sam
+                     ou paf (os dois ultimos com o alinhamento em operacoes,
+                     CIGAR e MD ou cs, e a seqMaior como referencia)
+     -l arquivo      alinhamento em lote (opcao 11) de todos os pares do
+                     arquivo, com os trabalhadores da opcao -n (sem ela, um
+                     por nucleo), e termina; os resultados vao para o arquivo
+                     da opcao -o ou para resultados_lote.txt
+   Sem a opcao -a, o metodo eh perguntado no menu a cada alinhamento e, com -i
+   ou -j, eh o traceback na matriz. */
+void main(int argc, char *argv[])
+{ int opcao, i, todosPares=0;
+  char *arquivoTarefas=NULL, *arquivoSaida=NULL, *arquivoLote=NULL;
 
   srand(time(NULL));
 
+  for (i=1; i<argc; i++)
+  {
+    if ((strcmp(argv[i],"-a")==0)&&(i+1<argc))
+    {
+      i++;
+      if (strcmp(argv[i],"matriz")==0)
+        modoAlinhamento=1;
+      else if (strcmp(argv[i],"hirschberg")==0)
+        modoAlinhamento=2;
+      else if (strcmp(argv[i],"banda")==0)
+        modoAlinhamento=3;
+      else
+        printf("Metodo de alinhamento desconhecido: %s\n", argv[i]);
+    }
+    else if ((strcmp(argv[i],"-k")==0)&&(i+1<argc))
+    {
+      i++;
+      if (strcmp(argv[i],"escalar")==0)
+        kernelForcado=KERNEL_ESCALAR;
+      else if (strcmp(argv[i],"sse41")==0)
+        kernelForcado=KERNEL_SSE41;
+      else if (strcmp(argv[i],"avx2")==0)
+        kernelForcado=KERNEL_AVX2;
+      else if (strcmp(argv[i],"avx512")==0)
+        kernelForcado=KERNEL_AVX512;
+      else
+        printf("Kernel desconhecido: %s\n", argv[i]);
+    }
+    else if ((strcmp(argv[i],"-b")==0)&&(i+1<argc))
+    {
+      i++;
+      larguraBanda=atoi(argv[i]);
+      if (larguraBanda<0)
+        larguraBanda=0;
+    }
+    else if ((strcmp(argv[i],"-g")==0)&&(i+1<argc))
+    {
+      i++;
+      penalAbre=atoi(argv[i]);
+      if (penalAbre<0)
+        penalAbre=0;
+    }
+    else if ((strcmp(argv[i],"-r")==0)&&(i+1<argc))
+      arquivoReaproveitado=argv[++i];
+    else if ((strcmp(argv[i],"-p")==0)&&(i+1<argc))
+    {
+      i++;
+      penalGap=atoi(argv[i]);
+      if (penalGap<0)
+        penalGap=0;
+    }
+    else if ((strcmp(argv[i],"-w")==0)&&(i+1<argc))
+    {
+      i++;
+      if (!lePesosTexto(argv[i]))
+        printf("Pesos invalidos: %s\n", argv[i]);
+    }
+    else if ((strcmp(argv[i],"-n")==0)&&(i+1<argc))
+    {
+      i++;
+      numthreads=atoi(argv[i]);
+      if ((numthreads<=0)||(numthreads>MAXTRABALHADORES))
+      {
+        printf("Numero de threads invalido: %s\n", argv[i]);
+        numthreads=0;
+      }
+    }
+    else if ((strcmp(argv[i],"-q")==0)&&(i+1<argc))
+    {
+      i++;
+      k=atoi(argv[i]);
+      if (k<1)
+        k=1;
+    }
+    else if ((strcmp(argv[i],"-m")==0)&&(i+1<argc))
+    {
+      i++;
+      if (strcmp(argv[i],"primeiro")==0)
+        tipoMaior=1;
+      else if (strcmp(argv[i],"ultimo")==0)
+        tipoMaior=2;
+      else
+      {
+        printf("Celula inicial desconhecida: %s\n", argv[i]);
+        exit(1);
+      }
+    }
+    else if ((strcmp(argv[i],"-x")==0)&&(i+1<argc))
+    {
+      i++;
+      if (strcmp(argv[i],"diagonal")==0)
+        desempateFixo=0;
+      else if (strcmp(argv[i],"cima")==0)
+        desempateFixo=1;
+      else if (strcmp(argv[i],"esquerda")==0)
+        desempateFixo=2;
+      else
+        printf("Desempate desconhecido: %s\n", argv[i]);
+    }
+    else if ((strcmp(argv[i],"-v")==0)&&(i+1<argc))
+    {
+      i++;
+      if (atoi(argv[i])<=0)
+        printf("Tamanho de rastro invalido: %s\n", argv[i]);
+      else
+        for (capRastro=1; (capRastro<atoi(argv[i]))&&(capRastro<(1<<26)); capRastro*=2)
+          ;
+    }
+    else if ((strcmp(argv[i],"-s")==0)&&(i+1<argc))
+    {
+      i++;
+      if (atoi(argv[i])<=0)
+        printf("Precisao de contagem invalida: %s\n", argv[i]);
+      else
+        bitsContagem=(atoi(argv[i])+63)/64*64;
+    }
+    else if ((strcmp(argv[i],"-i")==0)&&(i+1<argc))
+    {
+      arquivoTarefas=argv[++i];
+      todosPares=0;
+    }
+    else if ((strcmp(argv[i],"-j")==0)&&(i+1<argc))
+    {
+      arquivoTarefas=argv[++i];
+      todosPares=1;
+    }
+    else if ((strcmp(argv[i],"-o")==0)&&(i+1<argc))
+      arquivoSaida=argv[++i];
+    else if ((strcmp(argv[i],"-l")==0)&&(i+1<argc))
+      arquivoLote=argv[++i];
+    else if ((strcmp(argv[i],"-f")==0)&&(i+1<argc))
+    {
+      i++;
+      if (strcmp(argv[i],"texto")==0)
+        formatoSaida=SAIDA_TEXTO;
+      else if (strcmp(argv[i],"tabela")==0)
+        formatoSaida=SAIDA_TABELA;
+      else if (strcmp(argv[i],"sam")==0)
+        formatoSaida=SAIDA_SAM;
+      else if (strcmp(argv[i],"paf")==0)
+        formatoSaida=SAIDA_PAF;
+      else
+        printf("Formato desconhecido: %s\n", argv[i]);
+    }
+    else if ((strcmp(argv[i],"-y")==0)&&(i+1<argc))
+    {
+      i++;
+      if (!leFormatoBloco(argv[i]))
+        printf("Formato de bloco invalido: %s\n", argv[i]);
+    }
+    else if (strcmp(argv[i],"-u")==0)
+      reajustaBlocos=1;
+    else if ((strcmp(argv[i],"-P")==0)&&(i+1<argc))
+      arquivoPerfilBlocos=argv[++i];
+    else if (strcmp(argv[i],"-t")==0)
+      exportaTexto=1;
+    else if (strcmp(argv[i],"-d")==0)
+      modoPreenchimento=MODO_DIRECOES;
+    else if (strcmp(argv[i],"-e")==0)
+      modoPreenchimento=MODO_ESCORE;
+    else if (strcmp(argv[i],"-z")==0)
+      modoPreenchimento=MODO_COMPACTA;
+    else if ((strcmp(argv[i],"-c")==0)&&(i+1<argc))
+    {
+      i++;
+      if (atof(argv[i])<=0)
+        printf("Orcamento de memoria invalido: %s\n", argv[i]);
+      else
+      {
+        orcamentoControle=(size_t)(atof(argv[i])*1e6);
+        modoPreenchimento=MODO_CONTROLE;
+      }
+    }
+    else
+      printf("Opcao desconhecida: %s\n", argv[i]);
+  }
+
+  /* o lote (-l) aceita ate MAXTRABALHADORES trabalhadores; os demais modos, ate
+     MAXTHREADS threads. A opcao -l pode vir depois de -n, entao o limite so eh
+     conferido apos todas as opcoes */
+  if ((arquivoLote==NULL)&&(numthreads>MAXTHREADS))
+  {
+    printf("Numero de threads invalido: %d (maximo %d fora do lote)\n", numthreads, MAXTHREADS);
+    numthreads=0;
+  }
+
+  /* sequencias iniciais de exemplo */
+  alocaSequencia(&seqMaior,tamSeqMaior);
+  alocaSequencia(&seqMenor,tamSeqMenor);
+  for (i=0; i<6; i++)
+  {
+    defineBase(&seqMaior,i,seqMaiorInicial[i]);
+    defineBase(&seqMenor,i,seqMenorInicial[i]);
+  }
+
+  if (arquivoLote!=NULL)
+  {
+    if (!leParesDeArquivo(arquivoLote)||!alinhaLote(trabalhadoresLote()))
+      exit(EXIT_FAILURE);
+    salvaResultadosLote((arquivoSaida!=NULL) ? arquivoSaida : "resultados_lote.txt");
+    exit(EXIT_SUCCESS);
+  }
+  if (arquivoTarefas!=NULL)
+    exit((executaTarefas(arquivoTarefas, todosPares, arquivoSaida)==0) ? EXIT_SUCCESS : EXIT_FAILURE);
+
   do
   {
     printf("\n\nPrograma Needleman-Wunsch Sequencial\n");
@@ -914,5 +6814,6 @@ void main(void)
     trataOpcao(opcao);
 
   } while (opcao!=sair);
+  aguardaEscritor();
 
 }
\ No newline at end of file
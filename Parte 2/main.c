@@ -48,8 +48,16 @@ BREVE DESCRICAO:
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
 #include <mpi.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define USA_SIMD 1
+#include <immintrin.h>
+#endif
+
 #define A 0 // representa uma base Adenina
 #define T 1 // representa uma base Timina
 #define G 2 // representa uma base Guanina
@@ -65,20 +73,44 @@ char mapaBases[5] = {'A', 'T', 'G', 'C', '-'};
 
 /* seqMaior e seqMenor representam as duas sequencias de bases de entrada, a
    serem comparadas, inicializadas conforme segue. Elas conterao os indices aos
-   inves dos proprios caracteres. seqMenor deve ser menor ou igual a seqMaior. */
+   inves dos proprios caracteres. seqMenor deve ser menor ou igual a seqMaior.
+   As sequencias sao guardadas compactadas (SeqCompacta, abaixo), com o tamanho
+   real das sequencias. */
+
+int maxSeq = 10000000; // tamanho maximo de bases em uma sequencia genomica
+
+/* Sequencia compactada: cada base ocupa 2 bits (A=0, T=1, G=2, C=3), 32 bases
+   por palavra de 64 bits, e uma mascara separada, de 1 bit por posicao, marca as
+   posicoes sem base (os gaps de um alinhamento), que baseEm devolve como X. Sao
+   3 bits por posicao em vez dos 32 de um int, tanto na memoria quanto no
+   broadcast das sequencias. Os lacos de calculo leem as bases desempacotadas,
+   um byte por base. */
+
+typedef struct
+{
+  uint64_t *bases;   /* 2 bits por base, 32 bases por palavra */
+  uint64_t *mascara; /* 1 bit por posicao, 1 = sem base (gap) */
+  size_t cap;        /* posicoes alocadas */
+} SeqCompacta;
+
+#define PALAVRAS_BASES(n) (((size_t)(n) + 31) / 32)
+#define PALAVRAS_MASCARA(n) (((size_t)(n) + 63) / 64)
 
-int maxSeq = 1000; // tamanho maximo de bases em uma sequencia genomica
+int seqMaiorInicial[6] = {A, A, C, T, T, A},
+    seqMenorInicial[6] = {A, C, T, T, G, A};
 
-int seqMaior[1000] = {A, A, C, T, T, A},
-    seqMenor[1000] = {A, C, T, T, G, A};
+SeqCompacta seqMaior = {NULL, NULL, 0},
+            seqMenor = {NULL, NULL, 0};
 
 /* alinhaGMaior representa a sequencia maior ja alinhada, assim como alinhaGMenor,
    ambas obtidas no traceback. As duas juntas, pareadas, formam o alinhamento
    global. Tal alinhamento global pode ser obtido de duas formas: a partir do
-   primeiro maior escore ou a partir do ultimo maior escore */
+   primeiro maior escore ou a partir do ultimo maior escore. Ambos tem espaco
+   para tamSeqMaior+tamSeqMenor posicoes, o maior alinhamento possivel, e marcam
+   os gaps na mascara da sequencia compactada. */
 
-int alinhaGMaior[1000],
-    alinhaGMenor[1000];
+SeqCompacta alinhaGMaior = {NULL, NULL, 0},
+            alinhaGMenor = {NULL, NULL, 0};
 
 /* matrizEscores representa a matriz de escores que sera preenchida pelo metodo.
    A matriz, ao final de seu preenchimento, permitira obter o melhor alinhamento
@@ -86,9 +118,20 @@ int alinhaGMaior[1000],
    denominada TraceBack. Uma linha e uma coluna extras sao adicionadas na matriz
    para inicializar as pontuacoes/escores. Trata-se da linha 0 e coluna 0. A
    matriz de escores tera tamSeqMenor+1 linhas e tamSeqMaior+1 colunas.
-   Considera-se a primeira dimensao da matriz como linhas e a segunda como colunas.*/
+   Considera-se a primeira dimensao da matriz como linhas e a segunda como colunas.
 
-int matrizEscores[1000 + 1][1000 + 1];
+   A matriz eh alocada sob demanda, em todos os processos, em uma unica area
+   contigua alinhada em 64 bytes, em que cada linha ocupa passoLinha inteiros
+   (tamSeqMaior+1 arredondado para um multiplo de 16). matrizEscores aponta para
+   o inicio de cada linha, mantendo o acesso matrizEscores[lin][col]. */
+
+#define ALINHAMENTO_LINHA 16 // inteiros por linha de cache de 64 bytes
+
+int **matrizEscores = NULL, /* ponteiros para as linhas da matriz */
+    *blocoEscores = NULL;   /* area alocada, sem o ajuste de alinhamento */
+int passoLinha = 0,         /* distancia, em inteiros, entre duas linhas */
+    linMatriz = 0,          /* linhas da matriz alocada */
+    colMatriz = 0;          /* colunas da matriz alocada */
 
 int tamSeqMaior = 6, /* tamanho da sequencia maior, inicializado como 6 */
     tamSeqMenor = 6, /* tamanho da sequencia menor, inicializado como 6 */
@@ -123,6 +166,193 @@ int indRef = -1,                  // indice da sequencia maior a partir do qual
     linPMaior, colPMaior, PMaior, // suporte para deteccao do primeiro maior escore
     linUMaior, colUMaior, UMaior; // suporte para deteccao do ultimo maior escore
 
+/* libera a matriz de escores, por exemplo quando as sequencias sao redefinidas
+   e a matriz anterior deixa de corresponder a elas */
+void liberaMatrizEscores(void)
+{
+  free(matrizEscores);
+  free(blocoEscores);
+  matrizEscores = NULL;
+  blocoEscores = NULL;
+  linMatriz = 0;
+  colMatriz = 0;
+}
+
+/* aloca a matriz de escores com tamSeqMenor+1 linhas e tamSeqMaior+1 colunas.
+   Se a matriz atual ja tem essas dimensoes, ela eh reaproveitada. Sem memoria
+   suficiente, todos os processos sao abortados. */
+void alocaMatrizEscores(void)
+{
+  size_t total;
+  char *inicio;
+  int lin;
+
+  if ((matrizEscores != NULL) && (linMatriz == tamSeqMenor + 1) && (colMatriz == tamSeqMaior + 1))
+    return;
+
+  liberaMatrizEscores();
+  passoLinha = ((tamSeqMaior + 1 + ALINHAMENTO_LINHA - 1) / ALINHAMENTO_LINHA) * ALINHAMENTO_LINHA;
+  total = (size_t)(tamSeqMenor + 1) * passoLinha * sizeof(int);
+
+  blocoEscores = malloc(total + 64);
+  matrizEscores = malloc((size_t)(tamSeqMenor + 1) * sizeof(int *));
+  if ((blocoEscores == NULL) || (matrizEscores == NULL))
+  {
+    printf("\nMemoria insuficiente para a matriz de escores %d x %d\n", tamSeqMenor + 1, tamSeqMaior + 1);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
+  // Ajusta o inicio da area para o proximo endereco multiplo de 64
+  inicio = (char *)blocoEscores + (64 - ((size_t)blocoEscores % 64)) % 64;
+  for (lin = 0; lin <= tamSeqMenor; lin++)
+    matrizEscores[lin] = (int *)inicio + (size_t)lin * passoLinha;
+
+  linMatriz = tamSeqMenor + 1;
+  colMatriz = tamSeqMaior + 1;
+}
+
+/* base da posicao i de uma sequencia compactada, ou X se a posicao nao tem base */
+static inline int baseEm(const SeqCompacta *s, size_t i)
+{
+  if ((s->mascara[i >> 6] >> (i & 63)) & 1)
+    return X;
+  return (int)((s->bases[i >> 5] >> (2 * (i & 31))) & 3);
+}
+
+/* grava na posicao i a base b, ou X para uma posicao sem base */
+static inline void defineBase(SeqCompacta *s, size_t i, int b)
+{
+  uint64_t bit = (uint64_t)1 << (i & 63);
+  int desl = 2 * (int)(i & 31);
+
+  s->bases[i >> 5] &= ~((uint64_t)3 << desl);
+  if (b == X)
+    s->mascara[i >> 6] |= bit;
+  else
+  {
+    s->mascara[i >> 6] &= ~bit;
+    s->bases[i >> 5] |= (uint64_t)b << desl;
+  }
+}
+
+/* (re)dimensiona uma sequencia compactada para n posicoes, preservando as que
+   ja existiam; as novas ficam com a base A. Retorna 0 se nao houver memoria. */
+int redimensionaCompacta(SeqCompacta *s, size_t n)
+{
+  size_t antBases = PALAVRAS_BASES(s->cap), antMascara = PALAVRAS_MASCARA(s->cap);
+  size_t novBases = PALAVRAS_BASES(n > 0 ? n : 1), novMascara = PALAVRAS_MASCARA(n > 0 ? n : 1);
+  uint64_t *bases, *mascara;
+
+  if (s->bases == NULL)
+    antBases = antMascara = 0;
+  bases = realloc(s->bases, novBases * sizeof(uint64_t));
+  if (bases == NULL)
+    return 0;
+  s->bases = bases;
+  mascara = realloc(s->mascara, novMascara * sizeof(uint64_t));
+  if (mascara == NULL)
+    return 0;
+  s->mascara = mascara;
+  if (novBases > antBases)
+    memset(s->bases + antBases, 0, (novBases - antBases) * sizeof(uint64_t));
+  if (novMascara > antMascara)
+    memset(s->mascara + antMascara, 0, (novMascara - antMascara) * sizeof(uint64_t));
+  s->cap = n;
+  return 1;
+}
+
+/* desempacota n posicoes a partir de inicio, um byte por posicao (X nos gaps):
+   eh a forma usada pelos lacos de calculo, que percorrem as bases em sequencia */
+void desempacotaBases(const SeqCompacta *s, size_t inicio, int n, unsigned char *dest)
+{
+  size_t i = inicio, fim = inicio + n;
+  uint64_t bases, mascara;
+  int k, lim;
+
+  while (i < fim)
+  {
+    bases = s->bases[i >> 5] >> (2 * (i & 31));
+    mascara = s->mascara[i >> 6] >> (i & 63);
+    lim = 32 - (int)(i & 31); // O resto da palavra de bases cabe na de mascara
+    if ((size_t)lim > fim - i)
+      lim = (int)(fim - i);
+    for (k = 0; k < lim; k++)
+    {
+      *dest++ = (mascara & 1) ? X : (unsigned char)(bases & 3);
+      bases >>= 2;
+      mascara >>= 1;
+    }
+    i += lim;
+  }
+}
+
+/* (re)aloca uma sequencia para tam bases. Como a matriz de escores anterior
+   deixa de valer para as novas sequencias, ela eh liberada. */
+void alocaSequencia(SeqCompacta *seq, int tam)
+{
+  liberaMatrizEscores();
+  if (!redimensionaCompacta(seq, (size_t)tam))
+  {
+    printf("\nMemoria insuficiente para uma sequencia de %d bases\n", tam);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+}
+
+/* recebe por broadcast os tamanhos e as sequencias compactadas, alocando as
+   sequencias nos processos que ainda nao as tem com o tamanho correto */
+void recebeSequencias(void)
+{
+  MPI_Bcast(&tamSeqMaior, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&tamSeqMenor, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  alocaSequencia(&seqMaior, tamSeqMaior);
+  alocaSequencia(&seqMenor, tamSeqMenor);
+  MPI_Bcast(seqMaior.bases, (int)PALAVRAS_BASES(tamSeqMaior), MPI_UINT64_T, 0, MPI_COMM_WORLD);
+  MPI_Bcast(seqMaior.mascara, (int)PALAVRAS_MASCARA(tamSeqMaior), MPI_UINT64_T, 0, MPI_COMM_WORLD);
+  MPI_Bcast(seqMenor.bases, (int)PALAVRAS_BASES(tamSeqMenor), MPI_UINT64_T, 0, MPI_COMM_WORLD);
+  MPI_Bcast(seqMenor.mascara, (int)PALAVRAS_MASCARA(tamSeqMenor), MPI_UINT64_T, 0, MPI_COMM_WORLD);
+}
+
+/* aloca as sequencias do alinhamento global com espaco para o pior caso,
+   tamSeqMaior+tamSeqMenor posicoes */
+void alocaAlinhamento(void)
+{
+  if (!redimensionaCompacta(&alinhaGMaior, (size_t)tamSeqMaior + tamSeqMenor) ||
+      !redimensionaCompacta(&alinhaGMenor, (size_t)tamSeqMaior + tamSeqMenor))
+  {
+    printf("\nMemoria insuficiente para o alinhamento\n");
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+}
+
+/* le uma linha de tamanho arbitrario, aumentando o buffer conforme necessario.
+   Retorna o tamanho lido, sem o '\n' (e sem '\r'), ou -1 no fim do arquivo */
+int leLinha(FILE *arq, char **buffer, size_t *cap)
+{
+  size_t tam = 0;
+
+  if (*buffer == NULL)
+  {
+    *cap = 1024;
+    *buffer = malloc(*cap);
+  }
+  while (fgets(*buffer + tam, (int)(*cap - tam), arq) != NULL)
+  {
+    tam += strlen(*buffer + tam);
+    if ((tam > 0) && ((*buffer)[tam - 1] == '\n'))
+      break;
+    if (tam + 1 < *cap)
+      break; // Fim do arquivo sem '\n'
+    *cap *= 2;
+    *buffer = realloc(*buffer, *cap);
+  }
+  if (tam == 0)
+    return -1;
+  while ((tam > 0) && (((*buffer)[tam - 1] == '\n') || ((*buffer)[tam - 1] == '\r')))
+    tam--;
+  (*buffer)[tam] = '\0';
+  return (int)tam;
+}
+
 /* leitura do tamanho da sequencia maior */
 
 void leTamMaior(int rank)
@@ -225,7 +455,9 @@ void mostraMatrizPesos(void)
 void leSequenciasDeArquivo(char *fileName, int rank)
 {
   FILE *file;
-  char buffer[maxSeq + 2]; // Buffer para leitura incluindo o newline e null terminator
+  char *buffer = NULL; // Buffer de leitura, cresce conforme o tamanho da linha
+  size_t cap;
+  int tam;
 
   if (rank == 0)
   {
@@ -237,29 +469,25 @@ void leSequenciasDeArquivo(char *fileName, int rank)
     }
 
     // Leitura da sequência maior
-    if (fgets(buffer, sizeof(buffer), file) != NULL)
+    if ((tam = leLinha(file, &buffer, &cap)) > 0)
     {
-      tamSeqMaior = strlen(buffer);
-      if (buffer[tamSeqMaior - 1] == '\n')
-      {
-        buffer[tamSeqMaior - 1] = '\0';
-        tamSeqMaior--;
-      }
+      tamSeqMaior = tam;
+      alocaSequencia(&seqMaior, tamSeqMaior);
       for (int i = 0; i < tamSeqMaior; i++)
       {
         switch (buffer[i])
         {
         case 'A':
-          seqMaior[i] = A;
+          defineBase(&seqMaior, i, A);
           break;
         case 'T':
-          seqMaior[i] = T;
+          defineBase(&seqMaior, i, T);
           break;
         case 'G':
-          seqMaior[i] = G;
+          defineBase(&seqMaior, i, G);
           break;
         case 'C':
-          seqMaior[i] = C;
+          defineBase(&seqMaior, i, C);
           break;
         default:
           printf("Caractere inválido na sequência maior: %c\n", buffer[i]);
@@ -276,29 +504,25 @@ void leSequenciasDeArquivo(char *fileName, int rank)
     }
 
     // Leitura da sequência menor
-    if (fgets(buffer, sizeof(buffer), file) != NULL)
+    if ((tam = leLinha(file, &buffer, &cap)) > 0)
     {
-      tamSeqMenor = strlen(buffer);
-      if (buffer[tamSeqMenor - 1] == '\n')
-      {
-        buffer[tamSeqMenor - 1] = '\0';
-        tamSeqMenor--;
-      }
+      tamSeqMenor = tam;
+      alocaSequencia(&seqMenor, tamSeqMenor);
       for (int i = 0; i < tamSeqMenor; i++)
       {
         switch (buffer[i])
         {
         case 'A':
-          seqMenor[i] = A;
+          defineBase(&seqMenor, i, A);
           break;
         case 'T':
-          seqMenor[i] = T;
+          defineBase(&seqMenor, i, T);
           break;
         case 'G':
-          seqMenor[i] = G;
+          defineBase(&seqMenor, i, G);
           break;
         case 'C':
-          seqMenor[i] = C;
+          defineBase(&seqMenor, i, C);
           break;
         default:
           printf("Caractere inválido na sequência menor: %c\n", buffer[i]);
@@ -314,17 +538,14 @@ void leSequenciasDeArquivo(char *fileName, int rank)
       MPI_Abort(MPI_COMM_WORLD, 1);
     }
 
+    free(buffer);
     fclose(file);
   }
 
   // Broadcast dos tamanhos das sequências para todos os processos
-  MPI_Bcast(&tamSeqMaior, 1, MPI_INT, 0, MPI_COMM_WORLD);
-  MPI_Bcast(&tamSeqMenor, 1, MPI_INT, 0, MPI_COMM_WORLD);
-
-  // Após o tamanho ser conhecido, os processos podem ajustar o buffer para as sequências
-  // Fazendo o broadcast das sequências agora com os tamanhos corretos
-  MPI_Bcast(seqMaior, tamSeqMaior, MPI_INT, 0, MPI_COMM_WORLD);
-  MPI_Bcast(seqMenor, tamSeqMenor, MPI_INT, 0, MPI_COMM_WORLD);
+  // Após o tamanho ser conhecido, os processos ajustam o buffer para as sequências
+  // e recebem o broadcast das sequências com os tamanhos corretos
+  recebeSequencias();
 }
 
 int leGrauMutacao(int rank)
@@ -350,7 +571,8 @@ int leGrauMutacao(int rank)
 void leSequencias(int rank)
 {
   int i, erro;
-  char seqMaiorAux[maxSeq], seqMenorAux[maxSeq];
+  char *seqMaiorAux = NULL, *seqMenorAux = NULL;
+  size_t capMaior, capMenor;
 
   if (rank == 0)
   {
@@ -363,11 +585,10 @@ void leSequencias(int rank)
       do
       {
         printf("\n> ");
-        fgets(seqMaiorAux, maxSeq, stdin);
-        tamSeqMaior = strlen(seqMaiorAux) - 1; // Remove o newline
-        seqMaiorAux[tamSeqMaior] = '\0';       // Remove o newline do final da string
+        tamSeqMaior = leLinha(stdin, &seqMaiorAux, &capMaior); // Sem o newline
       } while (tamSeqMaior < 1);
       printf("\ntamSeqMaior = %d\n", tamSeqMaior);
+      alocaSequencia(&seqMaior, tamSeqMaior);
       i = 0;
       erro = 0;
       do
@@ -375,16 +596,16 @@ void leSequencias(int rank)
         switch (seqMaiorAux[i])
         {
         case 'A':
-          seqMaior[i] = A;
+          defineBase(&seqMaior, i, A);
           break;
         case 'T':
-          seqMaior[i] = T;
+          defineBase(&seqMaior, i, T);
           break;
         case 'G':
-          seqMaior[i] = G;
+          defineBase(&seqMaior, i, G);
           break;
         case 'C':
-          seqMaior[i] = C;
+          defineBase(&seqMaior, i, C);
           break;
         default:
           erro = 1; // Caractere inválido
@@ -401,11 +622,10 @@ void leSequencias(int rank)
       do
       {
         printf("\n> ");
-        fgets(seqMenorAux, maxSeq, stdin);
-        tamSeqMenor = strlen(seqMenorAux) - 1; // Remove o newline
-        seqMenorAux[tamSeqMenor] = '\0';       // Remove o newline do final da string
+        tamSeqMenor = leLinha(stdin, &seqMenorAux, &capMenor); // Sem o newline
       } while ((tamSeqMenor < 1) || (tamSeqMenor > tamSeqMaior));
       printf("\ntamSeqMenor = %d\n", tamSeqMenor);
+      alocaSequencia(&seqMenor, tamSeqMenor);
 
       i = 0;
       erro = 0;
@@ -414,16 +634,16 @@ void leSequencias(int rank)
         switch (seqMenorAux[i])
         {
         case 'A':
-          seqMenor[i] = A;
+          defineBase(&seqMenor, i, A);
           break;
         case 'T':
-          seqMenor[i] = T;
+          defineBase(&seqMenor, i, T);
           break;
         case 'G':
-          seqMenor[i] = G;
+          defineBase(&seqMenor, i, G);
           break;
         case 'C':
-          seqMenor[i] = C;
+          defineBase(&seqMenor, i, C);
           break;
         default:
           erro = 1; // Caractere inválido
@@ -431,15 +651,13 @@ void leSequencias(int rank)
         i++;
       } while ((erro == 0) && (i < tamSeqMenor));
     } while (erro == 1);
-  }
 
-  // Broadcast dos tamanhos das sequências
-  MPI_Bcast(&tamSeqMaior, 1, MPI_INT, 0, MPI_COMM_WORLD);
-  MPI_Bcast(&tamSeqMenor, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    free(seqMaiorAux);
+    free(seqMenorAux);
+  }
 
-  // Broadcast das sequências
-  MPI_Bcast(seqMaior, tamSeqMaior, MPI_INT, 0, MPI_COMM_WORLD);
-  MPI_Bcast(seqMenor, tamSeqMenor, MPI_INT, 0, MPI_COMM_WORLD);
+  // Broadcast dos tamanhos e das sequências
+  recebeSequencias();
 }
 
 /* geracao das sequencias aleatorias, conforme tamanho. Gera-se numeros aleatorios
@@ -461,11 +679,14 @@ void geraSequencias(int rank)
   {
     printf("\nGeracao Aleatoria das Sequencias:\n");
 
+    alocaSequencia(&seqMaior, tamSeqMaior);
+    alocaSequencia(&seqMenor, tamSeqMenor);
+
     // Gerando a sequência maior
     for (i = 0; i < tamSeqMaior; i++)
     {
       base = rand() % 4; // Produz valores de 0 a 3
-      seqMaior[i] = base;
+      defineBase(&seqMaior, i, base);
     }
 
     dif = tamSeqMaior - tamSeqMenor; // Diferença entre os tamanhos das sequências
@@ -476,7 +697,7 @@ void geraSequencias(int rank)
 
     // Gerando a sequência menor a partir da maior
     for (i = 0; i < tamSeqMenor; i++)
-      seqMenor[i] = seqMaior[indRef + i];
+      defineBase(&seqMenor, i, baseEm(&seqMaior, indRef + i));
 
     // Causa mutações aleatórias na sequência menor
     i = 0;
@@ -487,7 +708,7 @@ void geraSequencias(int rank)
 
       if (probAux <= grauMuta)
       {
-        seqMenor[i] = (seqMenor[i] + (rand() % 3) + 1) % 4;
+        defineBase(&seqMenor, i, (baseEm(&seqMenor, i) + (rand() % 3) + 1) % 4);
         nTrocas++;
       }
       i++;
@@ -497,10 +718,7 @@ void geraSequencias(int rank)
   }
 
   // Broadcast dos tamanhos e sequências para todos os processos
-  MPI_Bcast(&tamSeqMaior, 1, MPI_INT, 0, MPI_COMM_WORLD);
-  MPI_Bcast(&tamSeqMenor, 1, MPI_INT, 0, MPI_COMM_WORLD);
-  MPI_Bcast(seqMaior, tamSeqMaior, MPI_INT, 0, MPI_COMM_WORLD);
-  MPI_Bcast(seqMenor, tamSeqMenor, MPI_INT, 0, MPI_COMM_WORLD);
+  recebeSequencias();
 }
 
 /* mostra das sequencias seqMaior e seqMenor */
@@ -511,7 +729,7 @@ void mostraSequencias(void)
   printf("\nSequencias Atuais:\n");
   printf("\nSequencia Maior, Tam = %d\n", tamSeqMaior);
   for (i = 0; i < tamSeqMaior; i++)
-    printf("%c", mapaBases[seqMaior[i]]);
+    printf("%c", mapaBases[baseEm(&seqMaior, i)]);
   printf("\n");
 
   for (i = 0; i < tamSeqMaior; i++)
@@ -523,95 +741,499 @@ void mostraSequencias(void)
 
   printf("\nSequencia Menor, Tam = %d\n", tamSeqMenor);
   for (i = 0; i < tamSeqMenor; i++)
-    printf("%c", mapaBases[seqMenor[i]]);
+    printf("%c", mapaBases[baseEm(&seqMenor, i)]);
   printf("\n");
 
   for (i = 0; i < tamSeqMenor; i++)
-    if (seqMenor[i] != seqMaior[indRef + i])
+    if ((indRef >= 0) && (baseEm(&seqMenor, i) != baseEm(&seqMaior, indRef + i)))
       printf("^");
     else
       printf(" ");
   printf("\nQuantidade de trocas = %d\n", nTrocas);
 }
 
-/* geraMatrizEscores gera a matriz de escores. A matriz de escores tera
-   tamSeqMenor+1 linhas e tamSeqMaior+1 colunas. A linha 0 e a coluna
-   0 s�o adicionadas para representar gaps e conter penalidades. As
-   demais linhas e colunas sao associadas as bases da seqMenor e da
-   SeqMaior, respectivamente. */
+/* Kernel vetorial (SIMD) do calculo das linhas, no estilo "striped" de Farrar
+   (2007), o mesmo usado nos blocos da Parte 1. Cada linha eh calculada em
+   trechos de TAM_TRECHO colunas; dentro de um trecho, a coluna p fica na lane
+   p/seg do vetor p%seg (seg = ceil(largura/nLanes)), de modo que os vetores
+   dependem apenas da linha anterior, e o gap horizontal que atravessa lanes eh
+   corrigido por um laco "preguicoso" (lazy-F).
 
-void geraMatrizEscores(int rank, int size)
+   Os escores sao guardados relativos a celula [lin-1,c0-1] do trecho, e a
+   largura das lanes (8, 16 ou 32 bits) eh a menor que comporta o maior desvio
+   possivel dentro do trecho, com aritmetica saturada em 8 e 16 bits. O conjunto
+   de instrucoes (SSE4.1, AVX2 ou AVX-512) eh escolhido em tempo de execucao. */
+
+#define TAM_TRECHO 256 // colunas por trecho do kernel vetorial
+
+enum
 {
-  int lin, col, peso;
-  int escoreDiag, escoreLin, escoreCol;
-  int lin_inicial, lin_final;
+  KERNEL_ESCALAR,
+  KERNEL_SSE41,
+  KERNEL_AVX2,
+  KERNEL_AVX512,
+  NUM_KERNELS
+};
+
+const char *nomeKernel[NUM_KERNELS] = {"escalar", "SSE4.1", "AVX2", "AVX-512"};
+
+typedef void (*KernelTrecho)(int r0, int r1, int c0, int c1, const void *perfil, void *area);
+
+int kernelForcado = -1;          /* kernel escolhido na linha de comando, -1 = automatico */
+KernelTrecho kernelAtual = NULL; /* kernel do preenchimento atual, NULL = escalar */
+int larguraLane = 32,            /* bits por lane do kernel atual */
+    bytesVetor = 16;             /* bytes por vetor do kernel atual */
+char *perfilSimd = NULL;         /* perfis de todos os trechos, alinhados em 64 bytes */
+size_t passoPerfil = 0;          /* bytes entre os perfis de dois trechos */
+char areaSimd[3 * (TAM_TRECHO * 4 + 64) + 64]; /* rascunho do kernel */
+int maiorTrecho;                 /* maior escore do ultimo trecho calculado pelo kernel */
+
+/* alinha um ponteiro no proximo endereco multiplo de 64 */
+char *alinhaPonteiro(void *p)
+{
+  return (char *)p + (64 - ((size_t)p % 64)) % 64;
+}
 
-  // Cada processo calcula uma linha de cada vez
-  lin_inicial = rank;
-  lin_final = tamSeqMenor + 1;
+#ifdef USA_SIMD
+
+/* deslocamento de uma lane para cima, inserindo x na lane 0 */
+#define SSE_DESLOCA(v, x, SET1, E) _mm_alignr_epi8((v), SET1(x), 16 - (E))
+#define AVX2_DESLOCA(v, x, SET1, E) _mm256_alignr_epi8((v), _mm256_permute2x128_si256((v), SET1(x), 0x02), 16 - (E))
+#define AVX512_DESLOCA(v, x, SET1, E) _mm512_alignr_epi8((v), _mm512_alignr_epi64((v), SET1(x), 6), 16 - (E))
+
+#define SSE_DESLOCA8(v, x) SSE_DESLOCA(v, x, _mm_set1_epi8, 1)
+#define SSE_DESLOCA16(v, x) SSE_DESLOCA(v, x, _mm_set1_epi16, 2)
+#define SSE_DESLOCA32(v, x) SSE_DESLOCA(v, x, _mm_set1_epi32, 4)
+#define AVX2_DESLOCA8(v, x) AVX2_DESLOCA(v, x, _mm256_set1_epi8, 1)
+#define AVX2_DESLOCA16(v, x) AVX2_DESLOCA(v, x, _mm256_set1_epi16, 2)
+#define AVX2_DESLOCA32(v, x) AVX2_DESLOCA(v, x, _mm256_set1_epi32, 4)
+#define AVX512_DESLOCA8(v, x) AVX512_DESLOCA(v, x, _mm512_set1_epi8, 1)
+#define AVX512_DESLOCA16(v, x) AVX512_DESLOCA(v, x, _mm512_set1_epi16, 2)
+#define AVX512_DESLOCA32(v, x) AVX512_DESLOCA(v, x, _mm512_set1_epi32, 4)
+
+/* verdadeiro se alguma lane de a for maior que a de b */
+#define SSE_MAIOR8(a, b) _mm_movemask_epi8(_mm_cmpgt_epi8((a), (b)))
+#define SSE_MAIOR16(a, b) _mm_movemask_epi8(_mm_cmpgt_epi16((a), (b)))
+#define SSE_MAIOR32(a, b) _mm_movemask_epi8(_mm_cmpgt_epi32((a), (b)))
+#define AVX2_MAIOR8(a, b) _mm256_movemask_epi8(_mm256_cmpgt_epi8((a), (b)))
+#define AVX2_MAIOR16(a, b) _mm256_movemask_epi8(_mm256_cmpgt_epi16((a), (b)))
+#define AVX2_MAIOR32(a, b) _mm256_movemask_epi8(_mm256_cmpgt_epi32((a), (b)))
+#define AVX512_MAIOR8(a, b) _mm512_cmpgt_epi8_mask((a), (b))
+#define AVX512_MAIOR16(a, b) _mm512_cmpgt_epi16_mask((a), (b))
+#define AVX512_MAIOR32(a, b) _mm512_cmpgt_epi32_mask((a), (b))
+
+/* preenche as linhas r0..r1, colunas c0..c1, de matrizEscores. A linha r0-1 e a
+   coluna c0-1 ja estao calculadas. perfil aponta para os 4 x seg vetores de
+   pesos do trecho e area para o rascunho. O maior escore do trecho, para
+   maiorTrecho, eh acumulado em um vetor antes da correcao entre lanes, que so
+   sobe celulas para o gap vindo de outra celula maior do trecho. */
+#define DEFINE_KERNEL_TRECHO(NOME, ALVO, VT, TIPO, NEG, SET1, ADDS, SUBS, MAX, ALGUM_MAIOR, DESLOCA) \
+  __attribute__((target(ALVO))) static void NOME(int r0, int r1, int c0, int c1, const void *perfil, void *area) \
+  {                                                                                                  \
+    const int nLanes = (int)(sizeof(VT) / sizeof(TIPO));                                             \
+    int w = c1 - c0 + 1, seg = (w + nLanes - 1) / nLanes;                                            \
+    int lin, k, l, p, vies = matrizEscores[r0 - 1][c0 - 1];                                          \
+    VT *hAnt = (VT *)area, *hNovo = hAnt + seg, *aux;                                                \
+    VT vGap = SET1(penalGap), vDiag, vH, vF, vMaior = SET1(NEG);                                     \
+    const VT *vPerfil;                                                                               \
+    TIPO *t, reducao[64];                                                                            \
+    int *linha;                                                                                      \
+                                                                                                     \
+    t = (TIPO *)hAnt;                                                                                \
+    for (l = 0; l < nLanes; l++)                                                                     \
+      for (k = 0; k < seg; k++)                                                                      \
+      {                                                                                              \
+        p = l * seg + k;                                                                             \
+        t[k * nLanes + l] = (p < w) ? (TIPO)(matrizEscores[r0 - 1][c0 + p] - vies) : (TIPO)(NEG);    \
+      }                                                                                              \
+                                                                                                     \
+    for (lin = r0; lin <= r1; lin++)                                                                 \
+    {                                                                                                \
+      vPerfil = (const VT *)perfil + baseEm(&seqMenor, lin - 1) * seg;                               \
+      vDiag = DESLOCA(hAnt[seg - 1], matrizEscores[lin - 1][c0 - 1] - vies);                         \
+      vF = DESLOCA(SET1(NEG), matrizEscores[lin][c0 - 1] - vies - penalGap);                         \
+      for (k = 0; k < seg; k++)                                                                      \
+      {                                                                                              \
+        vH = ADDS(vDiag, vPerfil[k]);                                                                \
+        vH = MAX(vH, SUBS(hAnt[k], vGap));                                                           \
+        vH = MAX(vH, vF);                                                                            \
+        hNovo[k] = vH;                                                                               \
+        vMaior = MAX(vMaior, vH);                                                                    \
+        vF = SUBS(vH, vGap);                                                                         \
+        vDiag = hAnt[k];                                                                             \
+      }                                                                                              \
+                                                                                                     \
+      /* correcao do gap horizontal que atravessa de uma lane para a seguinte */                     \
+      vF = DESLOCA(vF, NEG);                                                                         \
+      k = 0;                                                                                         \
+      while (ALGUM_MAIOR(vF, hNovo[k]))                                                              \
+      {                                                                                              \
+        hNovo[k] = MAX(hNovo[k], vF);                                                                \
+        vF = SUBS(hNovo[k], vGap);                                                                   \
+        if (++k == seg)                                                                              \
+        {                                                                                            \
+          k = 0;                                                                                     \
+          vF = DESLOCA(vF, NEG);                                                                     \
+        }                                                                                            \
+      }                                                                                              \
+                                                                                                     \
+      t = (TIPO *)hNovo;                                                                             \
+      linha = matrizEscores[lin] + c0;                                                               \
+      for (l = 0; l < nLanes; l++)                                                                   \
+        for (k = 0, p = l * seg; (k < seg) && (p < w); k++, p++)                                     \
+          linha[p] = t[k * nLanes + l] + vies;                                                       \
+                                                                                                     \
+      aux = hAnt;                                                                                    \
+      hAnt = hNovo;                                                                                  \
+      hNovo = aux;                                                                                   \
+    }                                                                                                \
+                                                                                                     \
+    memcpy(reducao, &vMaior, sizeof(VT));                                                            \
+    p = reducao[0];                                                                                  \
+    for (l = 1; l < nLanes; l++)                                                                     \
+      if (reducao[l] > p)                                                                            \
+        p = reducao[l];                                                                              \
+    maiorTrecho = p + vies;                                                                          \
+  }
 
-  // Inicializa a matriz de penalidades no processo 0
-  if (rank == 0)
+DEFINE_KERNEL_TRECHO(trechoSse8, "sse4.1", __m128i, int8_t, INT8_MIN, _mm_set1_epi8, _mm_adds_epi8, _mm_subs_epi8, _mm_max_epi8, SSE_MAIOR8, SSE_DESLOCA8)
+DEFINE_KERNEL_TRECHO(trechoSse16, "sse4.1", __m128i, int16_t, INT16_MIN, _mm_set1_epi16, _mm_adds_epi16, _mm_subs_epi16, _mm_max_epi16, SSE_MAIOR16, SSE_DESLOCA16)
+DEFINE_KERNEL_TRECHO(trechoSse32, "sse4.1", __m128i, int32_t, INT32_MIN / 4, _mm_set1_epi32, _mm_add_epi32, _mm_sub_epi32, _mm_max_epi32, SSE_MAIOR32, SSE_DESLOCA32)
+DEFINE_KERNEL_TRECHO(trechoAvx2_8, "avx2", __m256i, int8_t, INT8_MIN, _mm256_set1_epi8, _mm256_adds_epi8, _mm256_subs_epi8, _mm256_max_epi8, AVX2_MAIOR8, AVX2_DESLOCA8)
+DEFINE_KERNEL_TRECHO(trechoAvx2_16, "avx2", __m256i, int16_t, INT16_MIN, _mm256_set1_epi16, _mm256_adds_epi16, _mm256_subs_epi16, _mm256_max_epi16, AVX2_MAIOR16, AVX2_DESLOCA16)
+DEFINE_KERNEL_TRECHO(trechoAvx2_32, "avx2", __m256i, int32_t, INT32_MIN / 4, _mm256_set1_epi32, _mm256_add_epi32, _mm256_sub_epi32, _mm256_max_epi32, AVX2_MAIOR32, AVX2_DESLOCA32)
+DEFINE_KERNEL_TRECHO(trechoAvx512_8, "avx512f,avx512bw", __m512i, int8_t, INT8_MIN, _mm512_set1_epi8, _mm512_adds_epi8, _mm512_subs_epi8, _mm512_max_epi8, AVX512_MAIOR8, AVX512_DESLOCA8)
+DEFINE_KERNEL_TRECHO(trechoAvx512_16, "avx512f,avx512bw", __m512i, int16_t, INT16_MIN, _mm512_set1_epi16, _mm512_adds_epi16, _mm512_subs_epi16, _mm512_max_epi16, AVX512_MAIOR16, AVX512_DESLOCA16)
+DEFINE_KERNEL_TRECHO(trechoAvx512_32, "avx512f,avx512bw", __m512i, int32_t, INT32_MIN / 4, _mm512_set1_epi32, _mm512_add_epi32, _mm512_sub_epi32, _mm512_max_epi32, AVX512_MAIOR32, AVX512_DESLOCA32)
+
+/* kernels por conjunto de instrucoes e largura de lane (8, 16 e 32 bits) */
+KernelTrecho kernelsTrecho[NUM_KERNELS][3] = {
+    {NULL, NULL, NULL},
+    {trechoSse8, trechoSse16, trechoSse32},
+    {trechoAvx2_8, trechoAvx2_16, trechoAvx2_32},
+    {trechoAvx512_8, trechoAvx512_16, trechoAvx512_32}};
+
+/* melhor conjunto de instrucoes suportado pela CPU */
+int melhorKernelCpu(void)
+{
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+    return KERNEL_AVX512;
+  if (__builtin_cpu_supports("avx2"))
+    return KERNEL_AVX2;
+  if (__builtin_cpu_supports("sse4.1"))
+    return KERNEL_SSE41;
+  return KERNEL_ESCALAR;
+}
+
+#else
+
+KernelTrecho kernelsTrecho[NUM_KERNELS][3] = {{NULL}};
+
+int melhorKernelCpu(void)
+{
+  return KERNEL_ESCALAR;
+}
+
+#endif
+
+/* monta, para o trecho de colunas c0..c1, os 4 x seg vetores de perfil no layout
+   intercalado: lane l do vetor k da base b recebe o peso de b contra a coluna
+   c0+l*seg+k, ou um valor muito negativo nas posicoes alem do trecho */
+void montaPerfilTrecho(int c0, int c1, char *dest)
+{
+  int nLanes = bytesVetor * 8 / larguraLane, w = c1 - c0 + 1, seg = (w + nLanes - 1) / nLanes;
+  int b, k, l, p, peso, limite, i;
+  unsigned char bases[TAM_TRECHO];
+
+  desempacotaBases(&seqMaior, c0 - 1, w, bases);
+  limite = (larguraLane == 8) ? INT8_MAX : (larguraLane == 16) ? INT16_MAX : (1 << 28);
+  for (b = 0; b < 4; b++)
+    for (l = 0; l < nLanes; l++)
+      for (k = 0; k < seg; k++)
+      {
+        p = l * seg + k;
+        peso = (p < w) ? matrizPesos[b][bases[p]] : -limite - 1;
+        if (peso < -limite - 1)
+          peso = -limite - 1;
+        if (peso > limite)
+          peso = limite;
+        i = (b * seg + k) * nLanes + l;
+        if (larguraLane == 8)
+          ((int8_t *)dest)[i] = (int8_t)peso;
+        else if (larguraLane == 16)
+          ((int16_t *)dest)[i] = (int16_t)peso;
+        else
+          ((int32_t *)dest)[i] = peso;
+      }
+}
+
+/* escolhe o kernel do preenchimento (o conjunto de instrucoes mais largo que a
+   CPU suporta e a menor largura de lane que comporta os escores de um trecho) e
+   monta os perfis de todos os trechos da seqMaior */
+void preparaKernelSimd(int rank)
+{
+  int isa, pesoMax = 0, delta, limite, i, j, t, nTrechos, nLanes, seg, c1;
+
+  isa = (kernelForcado >= 0) ? kernelForcado : melhorKernelCpu();
+  if (isa > melhorKernelCpu())
+    isa = melhorKernelCpu();
+  kernelAtual = NULL;
+  if (isa == KERNEL_ESCALAR)
   {
-    for (col = 0; col <= tamSeqMaior; col++)
-      matrizEscores[0][col] = col * penalGap; // Penalidades de gaps na primeira linha
+    if (rank == 0)
+      printf("\nKernel de preenchimento: escalar");
+    return;
+  }
 
-    for (lin = 0; lin <= tamSeqMenor; lin++)
-      matrizEscores[lin][0] = lin * penalGap; // Penalidades de gaps na primeira coluna
+  // Celulas vizinhas diferem de no maximo delta, entao um trecho de uma linha
+  // se afasta da celula [lin-1,c0-1] no maximo (TAM_TRECHO+2)*delta
+  for (i = 0; i < 4; i++)
+    for (j = 0; j < 4; j++)
+      if (matrizPesos[i][j] > pesoMax)
+        pesoMax = matrizPesos[i][j];
+  delta = penalGap + pesoMax;
+  limite = (TAM_TRECHO + 3) * delta;
+  if (2 * limite < INT8_MAX)
+    larguraLane = 8;
+  else if (2 * limite < INT16_MAX)
+    larguraLane = 16;
+  else
+    larguraLane = 32;
+
+  bytesVetor = (isa == KERNEL_AVX512) ? 64 : (isa == KERNEL_AVX2) ? 32 : 16;
+  kernelAtual = kernelsTrecho[isa][larguraLane == 8 ? 0 : larguraLane == 16 ? 1 : 2];
+
+  nLanes = bytesVetor * 8 / larguraLane;
+  seg = (TAM_TRECHO + nLanes - 1) / nLanes;
+  passoPerfil = (size_t)4 * seg * bytesVetor;
+  nTrechos = (tamSeqMaior + TAM_TRECHO - 1) / TAM_TRECHO;
+  free(perfilSimd);
+  perfilSimd = malloc(nTrechos * passoPerfil + 64);
+  if (perfilSimd == NULL)
+  {
+    printf("\nMemoria insuficiente para os perfis do kernel vetorial\n");
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+  for (t = 0; t < nTrechos; t++)
+  {
+    c1 = (t + 1) * TAM_TRECHO;
+    if (c1 > tamSeqMaior)
+      c1 = tamSeqMaior;
+    montaPerfilTrecho(t * TAM_TRECHO + 1, c1, alinhaPonteiro(perfilSimd) + t * passoPerfil);
   }
 
-  // Envia as penalidades iniciais da matriz para os outros processos
   if (rank == 0)
+    printf("\nKernel de preenchimento: %s, lanes de %d bits", nomeKernel[isa], larguraLane);
+}
+
+/* primeiro e ultimo maior escore, na ordem das linhas, das celulas calculadas
+   por um processo. Cada processo os acompanha durante o proprio calculo e, no
+   fim, uma reducao os combina no processo 0, sem percorrer a matriz de novo */
+typedef struct
+{
+  int PMaior, linPMaior, colPMaior;
+  int UMaior, linUMaior, colUMaior;
+} Maiores;
+
+Maiores maioresLocais; /* maiores das celulas ja calculadas por este processo */
+
+/* esvazia os maiores locais antes de um preenchimento */
+void iniciaMaiores(void)
+{
+  maioresLocais.PMaior = maioresLocais.UMaior = INT_MIN;
+  maioresLocais.linPMaior = maioresLocais.colPMaior = 0;
+  maioresLocais.linUMaior = maioresLocais.colUMaior = 0;
+}
+
+/* acumula em dest os maiores de m: em caso de empate, o primeiro maior fica com
+   a celula que vem antes na ordem das linhas e o ultimo com a que vem depois */
+void combinaMaiores(Maiores *dest, const Maiores *m)
+{
+  if ((m->PMaior > dest->PMaior) ||
+      ((m->PMaior == dest->PMaior) && ((m->linPMaior < dest->linPMaior) ||
+                                       ((m->linPMaior == dest->linPMaior) && (m->colPMaior < dest->colPMaior)))))
   {
-    for (int dest = 1; dest < size; dest++)
-    {
-      for (col = 0; col <= tamSeqMaior; col++)
-      {
-        MPI_Send(matrizEscores[0], tamSeqMaior + 1, MPI_INT, dest, 0, MPI_COMM_WORLD);
-      }
-    }
+    dest->PMaior = m->PMaior;
+    dest->linPMaior = m->linPMaior;
+    dest->colPMaior = m->colPMaior;
   }
-  else
+  if ((m->UMaior > dest->UMaior) ||
+      ((m->UMaior == dest->UMaior) && ((m->linUMaior > dest->linUMaior) ||
+                                       ((m->linUMaior == dest->linUMaior) && (m->colUMaior > dest->colUMaior)))))
   {
-    MPI_Recv(matrizEscores[0], tamSeqMaior + 1, MPI_INT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    dest->UMaior = m->UMaior;
+    dest->linUMaior = m->linUMaior;
+    dest->colUMaior = m->colUMaior;
   }
+}
 
-  // Processos começam a calcular suas linhas a partir da segunda linha
-  for (lin = lin_inicial; lin <= lin_final; lin += size - 1)
+/* operacao da reducao MPI dos maiores, no estilo do MPI_MAXLOC; o tipo eh
+   sempre o de seis inteiros criado por reuneMaiores */
+void reduzMaiores(void *entrada, void *acumulado, int *n, MPI_Datatype *tipo)
+{
+  int i;
+
+  (void)tipo;
+  for (i = 0; i < *n; i++)
+    combinaMaiores((Maiores *)acumulado + i, (const Maiores *)entrada + i);
+}
+
+/* combina os maiores locais de todos os processos no processo 0, que fica com
+   o primeiro e o ultimo maior escore da matriz */
+void reuneMaiores(int rank)
+{
+  MPI_Datatype tipo;
+  MPI_Op op;
+  Maiores total;
+
+  MPI_Type_contiguous(6, MPI_INT, &tipo);
+  MPI_Type_commit(&tipo);
+  MPI_Op_create(reduzMaiores, 1, &op);
+  MPI_Reduce(&maioresLocais, &total, 1, tipo, op, 0, MPI_COMM_WORLD);
+  MPI_Op_free(&op);
+  MPI_Type_free(&tipo);
+
+  if (rank == 0)
   {
-    if (rank != 0)
+    PMaior = total.PMaior;
+    linPMaior = total.linPMaior;
+    colPMaior = total.colPMaior;
+    UMaior = total.UMaior;
+    linUMaior = total.linUMaior;
+    colUMaior = total.colUMaior;
+  }
+}
+
+/* calcula as colunas c0..c1 da linha lin. Os trechos de TAM_TRECHO colunas
+   inteiramente contidos no intervalo usam o kernel vetorial do preenchimento
+   atual; as pontas (e tudo, sem kernel vetorial) usam o laco escalar. Os
+   maiores locais sao atualizados durante o calculo: o laco escalar compara cada
+   celula e, depois do kernel, so um trecho cujo maior (maiorTrecho) supere os
+   atuais eh percorrido, para achar a coluna */
+void calculaTrechoLinha(int lin, int c0, int c1)
+{
+  int col, peso, t, tc0, tc1, ini, fim, h;
+  int escoreDiag, escoreLin, escoreCol;
+  int *linha = matrizEscores[lin];
+  int baseSeqMenor = baseEm(&seqMenor, lin - 1);
+  unsigned char bases[TAM_TRECHO];
+
+  col = c0;
+  while (col <= c1)
+  {
+    t = (col - 1) / TAM_TRECHO;
+    tc0 = t * TAM_TRECHO + 1;
+    tc1 = tc0 + TAM_TRECHO - 1;
+    if (tc1 > tamSeqMaior)
+      tc1 = tamSeqMaior;
+
+    if ((kernelAtual != NULL) && (col == tc0) && (tc1 <= c1))
     {
-      // Recebe a linha anterior do processo anterior
-      MPI_Recv(matrizEscores[lin - 1], tamSeqMaior + 1, MPI_INT, rank - 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+      kernelAtual(lin, lin, tc0, tc1, alinhaPonteiro(perfilSimd) + t * passoPerfil, alinhaPonteiro(areaSimd));
+      if (maiorTrecho > maioresLocais.PMaior)
+      {
+        for (col = tc0; linha[col] != maiorTrecho; col++)
+          ;
+        maioresLocais.PMaior = maiorTrecho;
+        maioresLocais.linPMaior = lin;
+        maioresLocais.colPMaior = col;
+      }
+      if (maiorTrecho >= maioresLocais.UMaior)
+      {
+        for (col = tc1; linha[col] != maiorTrecho; col--)
+          ;
+        maioresLocais.UMaior = maiorTrecho;
+        maioresLocais.linUMaior = lin;
+        maioresLocais.colUMaior = col;
+      }
+      col = tc1 + 1;
+      continue;
     }
 
-    // Calcula a linha atual
-    for (col = 1; col <= tamSeqMaior; col++)
+    // Bases da seqMaior do pedaco do trecho dentro do intervalo, desempacotadas
+    fim = (tc1 < c1) ? tc1 : c1;
+    ini = col;
+    desempacotaBases(&seqMaior, ini - 1, fim - ini + 1, bases);
+    for (; col <= fim; col++)
     {
-      // Acessa o índice correto das bases das sequências
-      int baseSeqMenor = seqMenor[lin - 1];
-      int baseSeqMaior = seqMaior[col - 1];
-
       // Obtenha o peso da matriz de pesos
-      peso = matrizPesos[baseSeqMenor][baseSeqMaior];
+      peso = matrizPesos[baseSeqMenor][bases[col - ini]];
 
-      // Calcula os escores possíveis (diagonal, em cima, à esquerda)
+      // Calcula os escores possiveis (diagonal, em cima, a esquerda)
       escoreDiag = matrizEscores[lin - 1][col - 1] + peso;
       escoreLin = matrizEscores[lin - 1][col] - penalGap;
       escoreCol = matrizEscores[lin][col - 1] - penalGap;
 
       // Escolhe o maior escore
-      matrizEscores[lin][col] = escoreDiag;
-      if (escoreLin > matrizEscores[lin][col])
-        matrizEscores[lin][col] = escoreLin;
-      if (escoreCol > matrizEscores[lin][col])
-        matrizEscores[lin][col] = escoreCol;
+      h = escoreDiag;
+      if (escoreLin > h)
+        h = escoreLin;
+      if (escoreCol > h)
+        h = escoreCol;
+      linha[col] = h;
+
+      // Acompanha o primeiro e o ultimo maior escore deste processo
+      if (h > maioresLocais.PMaior)
+      {
+        maioresLocais.PMaior = h;
+        maioresLocais.linPMaior = lin;
+        maioresLocais.colPMaior = col;
+      }
+      if (h >= maioresLocais.UMaior)
+      {
+        maioresLocais.UMaior = h;
+        maioresLocais.linUMaior = lin;
+        maioresLocais.colUMaior = col;
+      }
+    }
+  }
+}
+
+/* geraMatrizEscores gera a matriz de escores. A matriz de escores tera
+   tamSeqMenor+1 linhas e tamSeqMaior+1 colunas. A linha 0 e a coluna
+   0 s�o adicionadas para representar gaps e conter penalidades. As
+   demais linhas e colunas sao associadas as bases da seqMenor e da
+   SeqMaior, respectivamente. */
+
+void geraMatrizEscores(int rank, int size)
+{
+  int lin, col;
+
+  alocaMatrizEscores();
+  preparaKernelSimd(rank);
+  iniciaMaiores();
+
+  // Inicializa a linha de penalidades no processo 0 e a coluna de penalidades
+  // em todos os processos, ja que cada um precisa dela nas linhas que calcula
+  if (rank == 0)
+  {
+    for (col = 0; col <= tamSeqMaior; col++)
+      matrizEscores[0][col] = col * penalGap; // Penalidades de gaps na primeira linha
+  }
+  for (lin = 0; lin <= tamSeqMenor; lin++)
+    matrizEscores[lin][0] = lin * penalGap; // Penalidades de gaps na primeira coluna
+
+  // Envia as penalidades iniciais da matriz para os outros processos
+  MPI_Bcast(matrizEscores[0], tamSeqMaior + 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  // Cada processo calcula uma linha de cada vez: a linha lin fica com o processo
+  // (lin - 1) % size, que recebe a linha anterior do processo anterior (em anel)
+  for (lin = rank + 1; lin <= tamSeqMenor; lin += size)
+  {
+    if ((size > 1) && (lin > 1))
+    {
+      // Recebe a linha anterior do processo anterior
+      MPI_Recv(matrizEscores[lin - 1], tamSeqMaior + 1, MPI_INT, (rank + size - 1) % size, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
     }
 
+    // Calcula a linha atual
+    calculaTrechoLinha(lin, 1, tamSeqMaior);
+
     // Envia a linha para o próximo processo (se houver)
-    if (rank != size - 1)
+    if ((size > 1) && (lin < tamSeqMenor))
     {
-      MPI_Send(matrizEscores[lin], tamSeqMaior + 1, MPI_INT, rank + 1, 0, MPI_COMM_WORLD);
+      MPI_Send(matrizEscores[lin], tamSeqMaior + 1, MPI_INT, (rank + 1) % size, 0, MPI_COMM_WORLD);
     }
   }
 
@@ -620,52 +1242,25 @@ void geraMatrizEscores(int rank, int size)
   {
     for (int p = 1; p < size; p++)
     {
-      for (lin = p; lin <= tamSeqMenor; lin += size - 1)
+      for (lin = p + 1; lin <= tamSeqMenor; lin += size)
       {
-        MPI_Recv(matrizEscores[lin], tamSeqMaior + 1, MPI_INT, p, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        MPI_Recv(matrizEscores[lin], tamSeqMaior + 1, MPI_INT, p, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
       }
     }
   }
   else
   {
     // Envia as linhas calculadas para o processo 0
-    for (lin = rank; lin <= tamSeqMenor; lin += size - 1)
+    for (lin = rank + 1; lin <= tamSeqMenor; lin += size)
     {
-      MPI_Send(matrizEscores[lin], tamSeqMaior + 1, MPI_INT, 0, 0, MPI_COMM_WORLD);
+      MPI_Send(matrizEscores[lin], tamSeqMaior + 1, MPI_INT, 0, 1, MPI_COMM_WORLD);
     }
   }
 
+  // Os maiores escores de cada processo foram acompanhados durante o calculo
+  reuneMaiores(rank);
   if (rank == 0)
   {
-
-    // Definir o maior e o menor valor da matriz
-    linPMaior = 1;
-    colPMaior = 1;
-    PMaior = matrizEscores[1][1];
-
-    linUMaior = 1;
-    colUMaior = 1;
-    UMaior = matrizEscores[1][1];
-
-    for (int lin = 1; lin <= tamSeqMenor; lin++)
-    {
-      for (int col = 1; col <= tamSeqMaior; col++)
-      {
-        if (PMaior < matrizEscores[lin][col])
-        {
-          linPMaior = lin;
-          colPMaior = col;
-          PMaior = matrizEscores[lin][col];
-        }
-        if (UMaior <= matrizEscores[lin][col])
-        {
-          linUMaior = lin;
-          colUMaior = col;
-          UMaior = matrizEscores[lin][col];
-        }
-      }
-    }
-
     printf("\nMatriz de escores Gerada.");
     printf("\nPrimeiro Maior escore = %d na celula [%d,%d]", PMaior, linPMaior, colPMaior);
     printf("\nUltimo Maior escore = %d na celula [%d,%d]", UMaior, linUMaior, colUMaior);
@@ -685,10 +1280,13 @@ void leTamanhoBloco(int *blockSize)
 
 void geraMatrizEscoresComBlocos(int rank, int size, int blockSize)
 {
-  int lin, col, peso;
-  int escoreDiag, escoreLin, escoreCol;
+  int lin, col;
   int col_start, col_end;
 
+  alocaMatrizEscores();
+  preparaKernelSimd(rank);
+  iniciaMaiores();
+
   // Inicializa a matriz de penalidades no processo 0
   if (rank == 0)
   {
@@ -722,26 +1320,7 @@ void geraMatrizEscoresComBlocos(int rank, int size, int blockSize)
       }
 
       // Calcular o bloco atual
-      for (col = col_start; col <= col_end; col++)
-      {
-        int baseSeqMenor = seqMenor[lin - 1];
-        int baseSeqMaior = seqMaior[col - 1];
-
-        // Obtenha o peso da matriz de pesos
-        peso = matrizPesos[baseSeqMenor][baseSeqMaior];
-
-        // Calcula os escores possíveis (diagonal, em cima, à esquerda)
-        escoreDiag = matrizEscores[lin - 1][col - 1] + peso;
-        escoreLin = matrizEscores[lin - 1][col] - penalGap;
-        escoreCol = matrizEscores[lin][col - 1] - penalGap;
-
-        // Escolhe o maior escore
-        matrizEscores[lin][col] = escoreDiag;
-        if (escoreLin > matrizEscores[lin][col])
-          matrizEscores[lin][col] = escoreLin;
-        if (escoreCol > matrizEscores[lin][col])
-          matrizEscores[lin][col] = escoreCol;
-      }
+      calculaTrechoLinha(lin, col_start, col_end);
 
       // Enviar o último valor do bloco para o próximo processo
       if (rank != size - 1 && col_end < tamSeqMaior)
@@ -781,12 +1360,27 @@ void geraMatrizEscoresComBlocos(int rank, int size, int blockSize)
       }
     }
   }
+
+  // Como na versao por linhas, os maiores locais sao combinados no processo 0
+  reuneMaiores(rank);
+  if (rank == 0)
+  {
+    printf("\nMatriz de escores Gerada.");
+    printf("\nPrimeiro Maior escore = %d na celula [%d,%d]", PMaior, linPMaior, colPMaior);
+    printf("\nUltimo Maior escore = %d na celula [%d,%d]", UMaior, linUMaior, colUMaior);
+  }
 }
 /* imprime a matriz de escores de acordo */
 void mostraMatrizEscores()
 {
   int i, lin, col;
 
+  if (matrizEscores == NULL)
+  {
+    printf("\nMatriz de escores ainda nao gerada.\n");
+    return;
+  }
+
   printf("\nMatriz de escores Atual:\n");
 
   printf("%4c%4c", ' ', ' ');
@@ -796,7 +1390,7 @@ void mostraMatrizEscores()
 
   printf("%4c%4c%4c", ' ', ' ', '-');
   for (i = 0; i < tamSeqMaior; i++)
-    printf("%4c", mapaBases[(seqMaior[i])]);
+    printf("%4c", mapaBases[baseEm(&seqMaior, i)]);
   printf("\n");
 
   printf("%4c%4c", '0', '-');
@@ -806,7 +1400,7 @@ void mostraMatrizEscores()
 
   for (lin = 1; lin <= tamSeqMenor; lin++)
   {
-    printf("%4d%4c", lin, mapaBases[(seqMenor[lin - 1])]);
+    printf("%4d%4c", lin, mapaBases[baseEm(&seqMenor, lin - 1)]);
     for (col = 0; col <= tamSeqMaior; col++)
     {
       printf("%4d", matrizEscores[lin][col]);
@@ -820,21 +1414,30 @@ void mostraAlinhamentoGlobal(void)
 {
   int i;
 
+  if (alinhaGMaior.bases == NULL)
+  {
+    printf("\nAlinhamento Global ainda nao gerado.\n");
+    return;
+  }
+
   printf("\nAlinhamento Obtido - Tamanho = %d:\n", tamAlinha);
 
-  printf("%c", mapaBases[alinhaGMaior[0]]);
+  printf("%c", mapaBases[baseEm(&alinhaGMaior, 0)]);
   for (i = 1; i < tamAlinha; i++)
-    printf("%c", mapaBases[alinhaGMaior[i]]);
+    printf("%c", mapaBases[baseEm(&alinhaGMaior, i)]);
   printf("\n");
 
-  printf("%c", mapaBases[alinhaGMenor[0]]);
+  printf("%c", mapaBases[baseEm(&alinhaGMenor, 0)]);
   for (i = 1; i < tamAlinha; i++)
-    printf("%c", mapaBases[alinhaGMenor[i]]);
+    printf("%c", mapaBases[baseEm(&alinhaGMenor, i)]);
   printf("\n");
 }
 
 void salvaMatrizEmArquivo(const char *nomeArquivo)
 {
+  if (matrizEscores == NULL)
+    return;
+
   FILE *arquivo = fopen(nomeArquivo, "w");
   if (arquivo == NULL)
   {
@@ -854,7 +1457,7 @@ void salvaMatrizEmArquivo(const char *nomeArquivo)
   fprintf(arquivo, "%4c%4c%4c", ' ', ' ', '-');
   for (int i = 0; i < tamSeqMaior; i++)
   {
-    fprintf(arquivo, "%4c", mapaBases[(seqMaior[i])]);
+    fprintf(arquivo, "%4c", mapaBases[baseEm(&seqMaior, i)]);
   }
   fprintf(arquivo, "\n");
 
@@ -867,7 +1470,7 @@ void salvaMatrizEmArquivo(const char *nomeArquivo)
 
   for (int lin = 1; lin <= tamSeqMenor; lin++)
   {
-    fprintf(arquivo, "%4d%4c", lin, mapaBases[(seqMenor[lin - 1])]);
+    fprintf(arquivo, "%4d%4c", lin, mapaBases[baseEm(&seqMenor, lin - 1)]);
     for (int col = 0; col <= tamSeqMaior; col++)
     {
       fprintf(arquivo, "%4d", matrizEscores[lin][col]);
@@ -896,6 +1499,13 @@ void traceBack(int tipo)
 {
   int tbLin, tbCol, peso, pos, aux, i;
 
+  if (matrizEscores == NULL)
+  {
+    printf("\nMatriz de escores ainda nao gerada.\n");
+    return;
+  }
+  alocaAlinhamento();
+
   // O processo 0 deve ser o único a realizar o traceback
   if (tipo == 1)
   {
@@ -916,7 +1526,7 @@ void traceBack(int tipo)
     if (tbLin > 0 && tbCol > 0)
     {
       // Verifica o escore do elemento [tbLin, tbCol]
-      peso = matrizPesos[(seqMenor[tbLin - 1])][(seqMaior[tbCol - 1])];
+      peso = matrizPesos[baseEm(&seqMenor, tbLin - 1)][baseEm(&seqMaior, tbCol - 1)];
       escoreDiag = matrizEscores[tbLin - 1][tbCol - 1] + peso;
       escoreLin = matrizEscores[tbLin][tbCol - 1] - penalGap;
       escoreCol = matrizEscores[tbLin - 1][tbCol] - penalGap;
@@ -924,40 +1534,40 @@ void traceBack(int tipo)
       if ((escoreDiag > escoreLin) && (escoreDiag > escoreCol))
       {
         // Se houver um gap duplo
-        if (seqMenor[tbLin - 1] != seqMaior[tbCol - 1])
+        if (baseEm(&seqMenor, tbLin - 1) != baseEm(&seqMaior, tbCol - 1))
         {
           printf("\nALERTA no TraceBack: Pos = %d Lin = %d e Col = %d\n", pos, tbLin, tbCol);
 
-          alinhaGMenor[pos] = X;
-          alinhaGMaior[pos] = seqMaior[tbCol - 1];
+          defineBase(&alinhaGMenor, pos, X);
+          defineBase(&alinhaGMaior, pos, baseEm(&seqMaior, tbCol - 1));
           tbCol--;
           pos++;
 
-          alinhaGMenor[pos] = seqMenor[tbLin - 1];
-          alinhaGMaior[pos] = X;
+          defineBase(&alinhaGMenor, pos, baseEm(&seqMenor, tbLin - 1));
+          defineBase(&alinhaGMaior, pos, X);
           tbLin--;
           pos++;
         }
         else
         {
-          alinhaGMenor[pos] = seqMenor[tbLin - 1];
+          defineBase(&alinhaGMenor, pos, baseEm(&seqMenor, tbLin - 1));
           tbLin--;
-          alinhaGMaior[pos] = seqMaior[tbCol - 1];
+          defineBase(&alinhaGMaior, pos, baseEm(&seqMaior, tbCol - 1));
           tbCol--;
           pos++;
         }
       }
       else if (escoreLin >= escoreCol)
       {
-        alinhaGMenor[pos] = X;
-        alinhaGMaior[pos] = seqMaior[tbCol - 1];
+        defineBase(&alinhaGMenor, pos, X);
+        defineBase(&alinhaGMaior, pos, baseEm(&seqMaior, tbCol - 1));
         tbCol--;
         pos++;
       }
       else
       {
-        alinhaGMenor[pos] = seqMenor[tbLin - 1];
-        alinhaGMaior[pos] = X;
+        defineBase(&alinhaGMenor, pos, baseEm(&seqMenor, tbLin - 1));
+        defineBase(&alinhaGMaior, pos, X);
         tbLin--;
         pos++;
       }
@@ -972,8 +1582,8 @@ void traceBack(int tipo)
   /* descarrega o restante de gaps da linha 0, se for o caso */
   while (tbLin > 0)
   {
-    alinhaGMenor[pos] = seqMenor[tbLin - 1];
-    alinhaGMaior[pos] = X;
+    defineBase(&alinhaGMenor, pos, baseEm(&seqMenor, tbLin - 1));
+    defineBase(&alinhaGMaior, pos, X);
     tbLin--;
     pos++;
   }
@@ -981,8 +1591,8 @@ void traceBack(int tipo)
   /* descarrega o restante de gaps da coluna 0, se for o caso */
   while (tbCol > 0)
   {
-    alinhaGMenor[pos] = X;
-    alinhaGMaior[pos] = seqMaior[tbCol - 1];
+    defineBase(&alinhaGMenor, pos, X);
+    defineBase(&alinhaGMaior, pos, baseEm(&seqMaior, tbCol - 1));
     tbCol--;
     pos++;
   }
@@ -992,18 +1602,246 @@ void traceBack(int tipo)
   /* Inverte o alinhamento para corrigir a ordem */
   for (i = 0; i < (tamAlinha / 2); i++)
   {
-    aux = alinhaGMenor[i];
-    alinhaGMenor[i] = alinhaGMenor[tamAlinha - i - 1];
-    alinhaGMenor[tamAlinha - i - 1] = aux;
+    aux = baseEm(&alinhaGMenor, i);
+    defineBase(&alinhaGMenor, i, baseEm(&alinhaGMenor, tamAlinha - i - 1));
+    defineBase(&alinhaGMenor, tamAlinha - i - 1, aux);
 
-    aux = alinhaGMaior[i];
-    alinhaGMaior[i] = alinhaGMaior[tamAlinha - i - 1];
-    alinhaGMaior[tamAlinha - i - 1] = aux;
+    aux = baseEm(&alinhaGMaior, i);
+    defineBase(&alinhaGMaior, i, baseEm(&alinhaGMaior, tamAlinha - i - 1));
+    defineBase(&alinhaGMaior, tamAlinha - i - 1, aux);
   }
 
   printf("\nAlinhamento Global Gerado.");
 }
 
+/* Modo nao interativo (opcoes -i e -j). Em vez do menu, o processo 0 le os
+   pares de um arquivo de linhas (duas linhas por par, a mais longa vira a
+   seqMaior), envia cada par aos demais processos, todos preenchem a matriz por
+   linhas (como na opcao 7) e o processo 0 faz o traceback e escreve o resultado
+   na saida padrao ou no arquivo da opcao -o. As mensagens de andamento e de erro
+   do processo 0 vao para a saida de erros. Com -i, so o primeiro par eh
+   alinhado; com -j (modo de tarefas), todos os pares do arquivo, com os mesmos
+   processos e o mesmo comunicador do inicio ao fim. */
+
+#define SAIDA_TEXTO 0  /* blocos de texto, como na opcao 11 */
+#define SAIDA_TABELA 1 /* uma linha por alinhamento, campos separados por tab */
+
+int formatoSaida = SAIDA_TEXTO; /* opcao -f */
+int tipoMaior = 1;              /* opcao -m: 1 = primeiro, 2 = ultimo maior */
+
+/* le os pesos da opcao -w: "igual,diferente" ou os 16 pesos da matriz, linha
+   a linha, separados por virgulas. Retorna 0 se o texto for invalido. */
+int lePesosTexto(const char *texto)
+{
+  int v[16], n = 0, i, j;
+  const char *p = texto;
+  char *fim;
+
+  while (n < 16)
+  {
+    v[n++] = (int)strtol(p, &fim, 10);
+    if (fim == p)
+      return 0;
+    p = fim;
+    if (*p != ',')
+      break;
+    p++;
+  }
+  if ((*p != '\0') || ((n != 2) && (n != 16)))
+    return 0;
+  for (i = 0; i < 4; i++)
+    for (j = 0; j < 4; j++)
+      matrizPesos[i][j] = (n == 2) ? ((i == j) ? v[0] : v[1]) : v[4 * i + j];
+  return 1;
+}
+
+/* codifica uma linha de tam bases em seq. Retorna 0 se houver caractere
+   invalido. */
+int codificaLinha(const char *linha, int tam, SeqCompacta *seq)
+{
+  int i;
+
+  for (i = 0; i < tam; i++)
+  {
+    switch (linha[i])
+    {
+    case 'A':
+      defineBase(seq, i, A);
+      break;
+    case 'T':
+      defineBase(seq, i, T);
+      break;
+    case 'G':
+      defineBase(seq, i, G);
+      break;
+    case 'C':
+      defineBase(seq, i, C);
+      break;
+    default:
+      printf("Caractere invalido na sequencia: %c\n", linha[i]);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* le o proximo par de linhas nao vazias para seqMaior e seqMenor, guardando em
+   indMaior e indMenor a posicao de cada uma no arquivo. Retorna 1 se leu, 0 no
+   fim do arquivo e -1 se o par tem caractere invalido. */
+int leParDeLinhas(FILE *file, char **buffer, size_t *cap, int *numLinha, int *indMaior, int *indMenor)
+{
+  char *linhas[2] = {NULL, NULL};
+  int tam[2], ind[2], n = 0, ok;
+
+  while ((n < 2) && ((tam[n] = leLinha(file, buffer, cap)) >= 0))
+  {
+    (*numLinha)++;
+    if (tam[n] == 0)
+      continue;
+    linhas[n] = malloc(tam[n]);
+    memcpy(linhas[n], *buffer, tam[n]);
+    ind[n++] = *numLinha;
+  }
+  if (n < 2)
+  {
+    if (n == 1)
+      printf("A ultima sequencia do arquivo nao tem par e foi ignorada.\n");
+    free(linhas[0]);
+    return 0;
+  }
+
+  n = (tam[1] > tam[0]) ? 1 : 0; // a mais longa vira a seqMaior
+  tamSeqMaior = tam[n];
+  tamSeqMenor = tam[1 - n];
+  *indMaior = ind[n];
+  *indMenor = ind[1 - n];
+  alocaSequencia(&seqMaior, tamSeqMaior);
+  alocaSequencia(&seqMenor, tamSeqMenor);
+  ok = codificaLinha(linhas[n], tamSeqMaior, &seqMaior) && codificaLinha(linhas[1 - n], tamSeqMenor, &seqMenor);
+  free(linhas[0]);
+  free(linhas[1]);
+  return ok ? 1 : -1;
+}
+
+/* escreve as tam posicoes de uma sequencia alinhada */
+void escreveBases(FILE *saida, const SeqCompacta *s, int tam)
+{
+  char buf[4096];
+  int i, n = 0;
+
+  for (i = 0; i < tam; i++)
+  {
+    buf[n++] = mapaBases[baseEm(s, i)];
+    if (n == (int)sizeof(buf))
+    {
+      fwrite(buf, 1, n, saida);
+      n = 0;
+    }
+  }
+  fwrite(buf, 1, n, saida);
+}
+
+/* escreve o alinhamento global atual no formato da opcao -f */
+void escreveResultado(FILE *saida, int numPar, int indMaior, int indMenor)
+{
+  int escore = (tipoMaior == 1) ? PMaior : UMaior;
+  int lin = (tipoMaior == 1) ? linPMaior : linUMaior;
+  int col = (tipoMaior == 1) ? colPMaior : colUMaior;
+
+  if (formatoSaida == SAIDA_TABELA)
+  {
+    fprintf(saida, "%d\tseq%d\tseq%d\t%d\t%d\t1\t%d\t%d\t%d\t%d\t", numPar, indMaior, indMenor,
+            tamSeqMaior, tamSeqMenor, escore, lin, col, tamAlinha);
+    escreveBases(saida, &alinhaGMaior, tamAlinha);
+    fprintf(saida, "\t");
+    escreveBases(saida, &alinhaGMenor, tamAlinha);
+    fprintf(saida, "\n");
+    return;
+  }
+
+  fprintf(saida, "Par %d: seq%d (%d bases) x seq%d (%d bases)\n", numPar, indMaior, tamSeqMaior, indMenor, tamSeqMenor);
+  fprintf(saida, "Escore = %d na celula [%d,%d]\n", escore, lin, col);
+  fprintf(saida, "Alinhamento 1 - Tamanho = %d:\n", tamAlinha);
+  escreveBases(saida, &alinhaGMaior, tamAlinha);
+  fprintf(saida, "\n");
+  escreveBases(saida, &alinhaGMenor, tamAlinha);
+  fprintf(saida, "\n");
+}
+
+/* executa o modo nao interativo em todos os processos: so o primeiro par
+   (todos=0, opcao -i) ou todos (todos=1, opcao -j). Retorna, no processo 0, o
+   numero de pares que nao puderam ser alinhados. */
+int executaTarefas(const char *nomeArquivo, int todos, const char *nomeSaida, int rank, int size)
+{
+  FILE *file = NULL, *saida = NULL;
+  char *buffer = NULL;
+  size_t cap = 0;
+  int continua = 1, lido, numLinha = 0, numPar = 0, erros = 0, indMaior = 0, indMenor = 0;
+  double inicio = MPI_Wtime();
+
+  if (rank == 0)
+  {
+    // a saida padrao passa a ser a de erros; os resultados vao para a original
+    fflush(stdout);
+    file = fopen(nomeArquivo, "r");
+    saida = (nomeSaida != NULL) ? fopen(nomeSaida, "w") : fdopen(dup(STDOUT_FILENO), "w");
+    if ((file == NULL) || (saida == NULL))
+    {
+      printf("Erro ao abrir o arquivo %s.\n", (file == NULL) ? nomeArquivo : nomeSaida);
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    if (formatoSaida == SAIDA_TABELA)
+      fprintf(saida, "#par\tmaior\tmenor\ttamMaior\ttamMenor\talinhamento\tescore\tlin\tcol\ttamanho\talinhaMaior\talinhaMenor\n");
+  }
+
+  while (continua)
+  {
+    if (rank == 0)
+    {
+      // pares com caracteres invalidos sao contados como erro e pulados
+      while ((lido = leParDeLinhas(file, &buffer, &cap, &numLinha, &indMaior, &indMenor)) < 0)
+      {
+        numPar++;
+        erros++;
+        printf("Par %d nao alinhado.\n", numPar);
+      }
+      continua = (lido > 0) && (todos || (numPar == 0));
+    }
+    MPI_Bcast(&continua, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (!continua)
+      break;
+
+    recebeSequencias();
+    geraMatrizEscores(rank, size);
+    if (rank == 0)
+    {
+      numPar++;
+      traceBack(tipoMaior);
+      escreveResultado(saida, numPar, indMaior, indMenor);
+    }
+  }
+
+  if (rank == 0)
+  {
+    if (numPar == 0)
+    {
+      printf("O arquivo %s nao tem nenhum par de sequencias.\n", nomeArquivo);
+      erros++;
+    }
+    free(buffer);
+    fclose(file);
+    if (fclose(saida) != 0)
+    {
+      perror("Erro ao gravar os resultados");
+      erros++;
+    }
+    printf("\n%d par(es) alinhado(s) em %.3f s, %d com erro.\n", numPar - (erros > numPar ? numPar : erros),
+           MPI_Wtime() - inicio, erros);
+  }
+  return erros;
+}
+
 /* menu de opcoes fornecido para o usuario */
 int menuOpcao(void)
 {
@@ -1123,11 +1961,26 @@ void trataOpcao(int op, int rank, int size)
     break;
   }
 }
-/* programa principal */
+/* programa principal. Opcoes de linha de comando (iguais em todos os processos):
+     -k kernel       kernel do preenchimento: escalar, sse41, avx2 ou avx512
+                     (sem a opcao, o melhor suportado pela CPU)
+     -s bloco        tamanho do bloco da transmissao, sem pergunta-lo no inicio
+     -p penalidade   penalidade de gap (opcao 3 do menu)
+     -w pesos        pesos do pareamento: "igual,diferente" ou os 16 pesos da
+                     matriz, linha a linha (A, T, G, C), separados por virgulas
+     -m maior        celula inicial: primeiro ou ultimo maior escore
+     -i arquivo      modo nao interativo: alinha o primeiro par do arquivo,
+                     sem o menu, e termina
+     -j arquivo      modo de tarefas: alinha todos os pares do arquivo, um
+                     apos o outro, e termina
+     -o arquivo      resultados de -i ou -j nesse arquivo, em vez da saida
+                     padrao (as mensagens vao sempre para a saida de erros)
+     -f formato      formato dos resultados de -i ou -j: texto ou tabela */
 void main(int argc, char *argv[])
 {
-  int opcao;
+  int opcao, i, todosPares = 0, erros;
   int rank, size;
+  char *arquivoTarefas = NULL, *arquivoSaida = NULL;
 
   MPI_Init(&argc, &argv);
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
@@ -1135,10 +1988,102 @@ void main(int argc, char *argv[])
 
   srand(time(NULL));
 
+  for (i = 1; i < argc; i++)
+  {
+    if ((strcmp(argv[i], "-k") == 0) && (i + 1 < argc))
+    {
+      i++;
+      if (strcmp(argv[i], "escalar") == 0)
+        kernelForcado = KERNEL_ESCALAR;
+      else if (strcmp(argv[i], "sse41") == 0)
+        kernelForcado = KERNEL_SSE41;
+      else if (strcmp(argv[i], "avx2") == 0)
+        kernelForcado = KERNEL_AVX2;
+      else if (strcmp(argv[i], "avx512") == 0)
+        kernelForcado = KERNEL_AVX512;
+      else if (rank == 0)
+        printf("Kernel desconhecido: %s\n", argv[i]);
+    }
+    else if ((strcmp(argv[i], "-s") == 0) && (i + 1 < argc))
+    {
+      i++;
+      blockSize = atoi(argv[i]);
+      if (blockSize < 1)
+      {
+        if (rank == 0)
+          printf("Tamanho de bloco invalido: %s\n", argv[i]);
+        blockSize = 0;
+      }
+    }
+    else if ((strcmp(argv[i], "-p") == 0) && (i + 1 < argc))
+    {
+      i++;
+      penalGap = atoi(argv[i]);
+      if (penalGap < 0)
+        penalGap = 0;
+    }
+    else if ((strcmp(argv[i], "-w") == 0) && (i + 1 < argc))
+    {
+      i++;
+      if (!lePesosTexto(argv[i]) && (rank == 0))
+        printf("Pesos invalidos: %s\n", argv[i]);
+    }
+    else if ((strcmp(argv[i], "-m") == 0) && (i + 1 < argc))
+    {
+      i++;
+      if (strcmp(argv[i], "primeiro") == 0)
+        tipoMaior = 1;
+      else if (strcmp(argv[i], "ultimo") == 0)
+        tipoMaior = 2;
+      else if (rank == 0)
+        printf("Celula inicial desconhecida: %s\n", argv[i]);
+    }
+    else if ((strcmp(argv[i], "-i") == 0) && (i + 1 < argc))
+    {
+      arquivoTarefas = argv[++i];
+      todosPares = 0;
+    }
+    else if ((strcmp(argv[i], "-j") == 0) && (i + 1 < argc))
+    {
+      arquivoTarefas = argv[++i];
+      todosPares = 1;
+    }
+    else if ((strcmp(argv[i], "-o") == 0) && (i + 1 < argc))
+      arquivoSaida = argv[++i];
+    else if ((strcmp(argv[i], "-f") == 0) && (i + 1 < argc))
+    {
+      i++;
+      if (strcmp(argv[i], "texto") == 0)
+        formatoSaida = SAIDA_TEXTO;
+      else if (strcmp(argv[i], "tabela") == 0)
+        formatoSaida = SAIDA_TABELA;
+      else if (rank == 0)
+        printf("Formato desconhecido: %s\n", argv[i]);
+    }
+    else if (rank == 0)
+      printf("Opcao desconhecida: %s\n", argv[i]);
+  }
+
+  // Sequencias iniciais de exemplo
+  alocaSequencia(&seqMaior, tamSeqMaior);
+  alocaSequencia(&seqMenor, tamSeqMenor);
+  for (i = 0; i < tamSeqMaior; i++)
+    defineBase(&seqMaior, i, seqMaiorInicial[i]);
+  for (i = 0; i < tamSeqMenor; i++)
+    defineBase(&seqMenor, i, seqMenorInicial[i]);
+
+  if (arquivoTarefas != NULL)
+  {
+    erros = executaTarefas(arquivoTarefas, todosPares, arquivoSaida, rank, size);
+    MPI_Finalize();
+    exit((erros == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
   if (rank == 0)
   {
     printf("\n\nPrograma Needleman-Wunsch Paralelo\n");
-    leTamanhoBloco(&blockSize); // Solicita o tamanho do bloco ao usuário
+    if (blockSize < 1)
+      leTamanhoBloco(&blockSize); // Solicita o tamanho do bloco ao usuário
 
     do
     {
@@ -1155,7 +2100,8 @@ void main(int argc, char *argv[])
   }
   else
   {
-    MPI_Bcast(&blockSize, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (blockSize < 1)
+      MPI_Bcast(&blockSize, 1, MPI_INT, 0, MPI_COMM_WORLD);
 
     while (1)
     {
@@ -1168,10 +2114,7 @@ void main(int argc, char *argv[])
 
         if (resp_geracao == 1 || resp_geracao == 3)
         {
-          MPI_Bcast(&tamSeqMaior, 1, MPI_INT, 0, MPI_COMM_WORLD);
-          MPI_Bcast(&tamSeqMenor, 1, MPI_INT, 0, MPI_COMM_WORLD);
-          MPI_Bcast(seqMaior, tamSeqMaior, MPI_INT, 0, MPI_COMM_WORLD);
-          MPI_Bcast(seqMenor, tamSeqMenor, MPI_INT, 0, MPI_COMM_WORLD);
+          recebeSequencias();
 
           continue;
         }
@@ -1179,10 +2122,7 @@ void main(int argc, char *argv[])
         {
           MPI_Bcast(&prob, 1, MPI_INT, 0, MPI_COMM_WORLD);
 
-          MPI_Bcast(&tamSeqMaior, 1, MPI_INT, 0, MPI_COMM_WORLD);
-          MPI_Bcast(&tamSeqMenor, 1, MPI_INT, 0, MPI_COMM_WORLD);
-          MPI_Bcast(seqMaior, tamSeqMaior, MPI_INT, 0, MPI_COMM_WORLD);
-          MPI_Bcast(seqMenor, tamSeqMenor, MPI_INT, 0, MPI_COMM_WORLD);
+          recebeSequencias();
 
           continue;
         }
@@ -1194,4 +2134,4 @@ void main(int argc, char *argv[])
   }
 
   MPI_Finalize();
-}
\ No newline at end of file
+}
\ No newline at end of file